@@ -1,9 +1,95 @@
 """Plugin to automatically pack bundles"""
 
+import array
+import fnmatch
+import io
+import json
+import os
+import shutil
+import struct
+import sys
+import wave
+import zlib
+
 import bip
 
 g_src: bip.Path
 g_out: bip.Path
+g_stage: bip.Path
+g_pak: bip.Path
+g_audio: bip.Path
+g_gen: bip.Path
+
+# Must match source/sbs/blob.hpp
+BLOB_MAGIC = b"SBSB"
+BLOB_VERSION = 1
+BLOB_CONFIG = 1
+BLOB_REVIEWS = 2
+BLOB_WARNINGS = 3
+
+# JSON data files which are compiled into blobs, and the blobs' names
+COMPILED = {
+  "cfg.json": ("cfg.bin", BLOB_CONFIG),
+  "reviews.json": ("reviews.bin", BLOB_REVIEWS),
+  "warnings.json": ("warnings.bin", BLOB_WARNINGS),
+}
+
+# Must match source/sbs/compress.hpp
+PACK_MAGIC = b"SBSZ"
+PACK_LZ4 = 1
+PACK_DELTA16 = 2
+
+# Entries the game reads itself, or hands to the engine through
+# loadUnpacked(), and so can unpack. Textures and fonts are decoded by the
+# engine straight from the bundle and have to be stored as-is.
+PACKABLE = {".json", ".bin", ".wav"}
+# Entries of 16-bit PCM, which are filtered before compressing
+PACK_FILTERED = {".wav"}
+PACK_MIN_SIZE = 1024
+
+# fnmatch patterns, one per line, of source files to leave out of the bundle.
+# Files starting with `_` or `.` are always left out.
+IGNORE_FILE = ".bndlignore"
+
+# Must match source/sbs/Pak.hpp
+PAK_MAGIC = b"SBSP"
+PAK_VERSION = 2
+PAK_ALIGN = 16
+# Entries also written to the pak, which the game parses straight out of the
+# mapping
+PAK_SUFFIXES = {".json", ".bin"}
+
+# Audio is converted to plain 16-bit PCM, the format tag and width both the
+# engine's loader and Sfx read. It keeps its own rate, which the engine plays
+# any sound at.
+AUDIO_SUFFIX = ".wav"
+AUDIO_WIDTH = 2
+WAVE_FORMAT_PCM = 1
+
+# Header with the balance constants of the shipped cfg.json, which the game's
+# sim is specialized on. Written to the directory of generated headers, which
+# recipe.toml adds to the game's include path.
+SHIPPED_HEADER = "shipped.hpp"
+
+# Sections of cfg.json in the header, and their fields in the order of the
+# matching Config struct. Integer fields are marked.
+SHIPPED_SECTIONS = [
+  ("Lube", "lube", [("base", False), ("upgrade", False), ("maxTier", True)]),
+  ("Gravity", "gravity", [("base", False), ("upgrade", False),
+                          ("threshold", False), ("maxTier", True)]),
+  ("Oxy", "oxy", [("regenFast", False), ("regenSlow", False),
+                  ("drain", False), ("min", False), ("cooldown", False)]),
+  ("Brick", "brick", [("xPos", False), ("startY", False), ("endY", False),
+                      ("fallSpeed", False), ("size", False)]),
+]
+
+# Must match StoreItem::Kind
+STORE_KINDS = [
+  ("lubeTier", 1),
+  ("gravityTier", 2),
+  ("oxyTier", 3),
+  ("endGame", 4),
+]
 
 def configure(settings: dict) -> bool:
   if "src" not in settings:
@@ -18,10 +104,17 @@ def configure(settings: dict) -> bool:
 
   global g_src
   global g_out
-  global g_exe
+  global g_stage
+  global g_pak
+  global g_audio
+  global g_gen
 
   g_src = bip.Path(settings["src"]).resolve()
   g_out = bip.Path(settings["out"]).resolve()
+  g_stage = g_out.parent / f"{g_out.stem}.stage"
+  g_pak = g_out.with_suffix(".pak")
+  g_audio = g_out.parent / f"{g_out.stem}.audio"
+  g_gen = bip.Path(settings.get("gen", g_out.parent / "gen")).resolve()
 
   if not g_out.parent.exists():
     g_out.parent.mkdir(parents=True)
@@ -31,11 +124,28 @@ def configure(settings: dict) -> bool:
              "Make sure you haven't made a typo.")
     return False
 
+  # the game includes the header, so it has to exist before anything is
+  # compiled, not only once the bundle is built
+  try:
+    generate_shipped_header((g_src / "cfg.json").read_bytes())
+  except (OSError, ValueError, KeyError, TypeError) as err:
+    bip.err(f"Could not generate the shipped constants: {err}",
+             "The game's sim is specialized on them, so it cannot be built.")
+    return False
+
   return True
 
 def clean() -> bool:
   if g_out.exists():
     g_out.unlink()
+  if g_stage.exists():
+    shutil.rmtree(g_stage)
+  if g_pak.exists():
+    g_pak.unlink()
+  if g_audio.exists():
+    shutil.rmtree(g_audio)
+  if (g_gen / SHIPPED_HEADER).exists():
+    (g_gen / SHIPPED_HEADER).unlink()
   return True
 
 def want_run() -> bool:
@@ -43,14 +153,452 @@ def want_run() -> bool:
     return True
 
   bndlmt = g_out.stat().st_mtime
+  if bip.Path(__file__).stat().st_mtime > bndlmt:
+    return True
   for bndlfile in g_src.iterdir():
     filemt = bndlfile.stat().st_mtime
     if filemt > bndlmt:
       return True
   return False
 
+class StringTable:
+  """Accumulates string data, handing out (offset, size) pairs relative to the
+  start of the payload. The string data starts at `base`. Equal strings are
+  stored once."""
+
+  def __init__(self, base: int):
+    self.base = base
+    self.data = bytearray()
+    self.offsets: dict[bytes, int] = {}
+
+  def add(self, text: str) -> tuple[int, int]:
+    raw = text.encode("utf-8")
+    if raw not in self.offsets:
+      self.offsets[raw] = self.base + len(self.data)
+      self.data += raw
+    return (self.offsets[raw], len(raw))
+
+def format_number(value: float) -> str:
+  """Mirrors how the game formats a JSON number"""
+  text = repr(float(value))
+  if text.endswith(".0"):
+    text = text[:-2]
+  return text
+
+def compile_config(root: dict) -> tuple[bytes, int]:
+  store = root["store"]
+  table = StringTable(152 + 28 * len(store))
+
+  socials = root["socials"]
+  lube = root["lube"]
+  gravity = root["gravity"]
+  oxy = root["oxy"]
+  toilet = root["toilet"]
+  shitter = root["shitter"]
+  brick = root["brick"]
+  water = root["water"]
+
+  record = struct.pack("<IIIIffifffifffffffffffffffffffffffffff",
+    *table.add(socials["x.com"]),
+    *table.add(socials["discord"]),
+    lube["base"], lube["upgrade"], int(lube["maxTier"]),
+    gravity["base"], gravity["upgrade"], gravity["threshold"],
+    int(gravity["maxTier"]),
+    oxy["regenFast"], oxy["regenSlow"], oxy["drain"], oxy["min"],
+    oxy["cooldown"],
+    toilet["xPos"], toilet["yPos"], toilet["size"],
+    shitter["xPos"], shitter["yPos"], shitter["width"], shitter["height"],
+    brick["xPos"], brick["startY"], brick["endY"], brick["fallSpeed"],
+    brick["size"],
+    water["minX"], water["maxX"], water["minY"], water["maxY"],
+    water["width"], water["height"],
+    water["scissorX"], water["scissorY"], water["scissorW"], water["scissorH"])
+
+  items = bytearray()
+  for item in store:
+    kind, argument = 0, 0
+    for key, value in STORE_KINDS:
+      if key in item:
+        kind = value
+        argument = 0 if key == "endGame" else int(item[key])
+    if kind == 0:
+      raise ValueError(f"store item `{item['name']}` has no effect")
+    items += struct.pack("<hhhhiIIII",
+      kind, argument, int(item["price"]), int(item["icon"]),
+      int(item.get("prestige", 0)),
+      *table.add(item["name"]),
+      *table.add(item["desc"]))
+
+  return (record + items + table.data, len(store))
+
+def compile_strings(strings: list[str]) -> tuple[bytes, int]:
+  table = StringTable(8 * len(strings))
+  index = bytearray()
+  for text in strings:
+    index += struct.pack("<II", *table.add(text))
+  return (index + table.data, len(strings))
+
+def compile_reviews(root: list) -> tuple[bytes, int]:
+  return compile_strings([
+    f"\"{review['quote']} {format_number(review['rating'])}/10\"\n"
+    f"   ~ {review['person']}"
+    for review in root])
+
+def compile_blob(raw: bytes, stored_size: int, kind: int) -> bytes:
+  """Compiles a JSON data file. `stored_size` is the size of the JSON file's
+  entry in the bundle. The game checks it and the CRC of `raw` to detect stale
+  blobs."""
+  root = json.loads(raw)
+  if kind == BLOB_CONFIG:
+    payload, count = compile_config(root)
+  elif kind == BLOB_REVIEWS:
+    payload, count = compile_reviews(root)
+  else:
+    payload, count = compile_strings(root)
+
+  header = struct.pack("<4sHHIIIIII",
+    BLOB_MAGIC, BLOB_VERSION, kind,
+    stored_size, zlib.crc32(raw),
+    len(payload), zlib.crc32(payload),
+    count, 0)
+  return header + payload
+
+def generate_shipped_header(raw: bytes) -> None:
+  """Writes the shipped balance constants as a C++ header. The file is only
+  touched if its contents change, so the game is not rebuilt needlessly."""
+  root = json.loads(raw)
+  # the header is not next to the game's sources
+  config_include = bip.Path(os.path.relpath(g_src / "../sbs/config.hpp", g_gen)).as_posix()
+  lines = [
+    "#pragma once",
+    "",
+    "/*",
+    "shipped.hpp",
+    "-----------",
+    "Balance constants of the shipped cfg.json",
+    "",
+    "Generated by the bundle step (see source/bndl/plug.py) from",
+    "source/data/cfg.json into the build directory. Do not edit.",
+    "*/",
+    "",
+    f"#include \"{config_include}\"",
+    "",
+    "namespace sbs::shipped {",
+    "",
+  ]
+  for type_name, section, fields in SHIPPED_SECTIONS:
+    values = []
+    for key, integer in fields:
+      value = root[section][key]
+      # floats are written as doubles and narrowed, the same way the config
+      # loader narrows them, so the values compare equal
+      values.append(str(int(value)) if integer else f"f32({float(value)!r})")
+    lines.append(f"inline constexpr Config::{type_name} c{type_name}{{")
+    lines += [f"  {value}," for value in values]
+    lines.append("};")
+    lines.append("")
+  lines.append("} // namespace sbs::shipped")
+  text = "\n".join(lines) + "\n"
+
+  header = g_gen / SHIPPED_HEADER
+  if not header.exists() or header.read_text() != text:
+    g_gen.mkdir(parents=True, exist_ok=True)
+    header.write_text(text)
+
+def lz4_length(out: bytearray, length: int) -> None:
+  while length >= 255:
+    out.append(255)
+    length -= 255
+  out.append(length)
+
+def lz4_compress(src: bytes) -> bytes:
+  """Compresses `src` into a single LZ4 block, greedily matching 4-byte
+  sequences against their last occurrence."""
+  out = bytearray()
+  last_seen: dict[bytes, int] = {}
+  anchor = 0
+  pos = 0
+  # the last match has to start 12 bytes before the end, and the last 5 bytes
+  # have to be literals
+  match_limit = len(src) - 12
+  while pos < match_limit:
+    key = src[pos:pos + 4]
+    candidate = last_seen.get(key)
+    last_seen[key] = pos
+    if candidate is None or pos - candidate > 0xFFFF:
+      pos += 1
+      continue
+
+    length = 4
+    max_length = len(src) - 5 - pos
+    while length < max_length and src[candidate + length] == src[pos + length]:
+      length += 1
+
+    literals = pos - anchor
+    out.append((min(literals, 15) << 4) | min(length - 4, 15))
+    if literals >= 15:
+      lz4_length(out, literals - 15)
+    out += src[anchor:pos]
+    out += struct.pack("<H", pos - candidate)
+    if length - 4 >= 15:
+      lz4_length(out, length - 4 - 15)
+
+    pos += length
+    anchor = pos
+
+  literals = len(src) - anchor
+  out.append(min(literals, 15) << 4)
+  if literals >= 15:
+    lz4_length(out, literals - 15)
+  out += src[anchor:]
+  return bytes(out)
+
+def delta16_filter(raw: bytes) -> bytes:
+  """Replaces every 16-bit word by its difference from the previous one, then
+  splits those into a plane of low bytes and one of high bytes. PCM changes
+  little from sample to sample, so this leaves LZ4 runs to find."""
+  count = len(raw) // 2
+  words = array.array("H", raw[:2 * count])
+  if sys.byteorder == "big":
+    words.byteswap()
+  deltas = array.array("H", bytes(2 * count))
+  previous = 0
+  for i, word in enumerate(words):
+    deltas[i] = (word - previous) & 0xFFFF
+    previous = word
+  if sys.byteorder == "big":
+    deltas.byteswap()
+  little = deltas.tobytes()
+  return little[0::2] + little[1::2] + raw[2 * count:]
+
+def pack_entry(name: str, raw: bytes) -> bytes:
+  """Returns what to store in the bundle for an entry: packed, if the game can
+  unpack it and that saves at least an eighth of its size"""
+  suffix = bip.Path(name).suffix.lower()
+  if suffix not in PACKABLE or len(raw) < PACK_MIN_SIZE:
+    return raw
+  flags = PACK_LZ4
+  source = raw
+  if suffix in PACK_FILTERED:
+    flags |= PACK_DELTA16
+    source = delta16_filter(raw)
+  packed = struct.pack("<4sHHI", PACK_MAGIC, flags, 0, len(raw)) \
+    + lz4_compress(source)
+  if len(packed) > len(raw) * 7 // 8:
+    return raw
+  return packed
+
+def decode_pcm(frames: bytes, width: int) -> array.array:
+  """Returns interleaved little-endian PCM samples of any width as 16-bit ones
+  in the host's byte order"""
+  if width == 1:
+    return array.array("h", ((byte - 128) << 8 for byte in frames))
+  if width == 2:
+    samples = array.array("h", frames)
+  elif width == 3:
+    # keep the upper two bytes of each little-endian sample
+    upper = bytearray(len(frames) // 3 * 2)
+    upper[0::2] = frames[1::3]
+    upper[1::2] = frames[2::3]
+    samples = array.array("h", upper)
+  elif width == 4:
+    wide = array.array("i", frames)
+    if sys.byteorder == "big":
+      wide.byteswap()
+    return array.array("h", (sample >> 16 for sample in wide))
+  else:
+    raise ValueError(f"{width * 8}-bit samples are not supported")
+  if sys.byteorder == "big":
+    samples.byteswap()
+  return samples
+
+def encode_pcm(samples: array.array) -> bytes:
+  """Returns 16-bit samples in the host's byte order as the little-endian
+  bytes of a WAV file"""
+  if sys.byteorder == "big":
+    samples = array.array("h", samples)
+    samples.byteswap()
+  return samples.tobytes()
+
+def wav_format(raw: bytes) -> tuple[int, int, int]:
+  """Returns the format tag, channel count and sample width in bits of the
+  WAV file's fmt chunk"""
+  if len(raw) < 12 or raw[0:4] != b"RIFF" or raw[8:12] != b"WAVE":
+    raise ValueError("not a RIFF WAVE file")
+  pos = 12
+  while pos + 8 <= len(raw):
+    chunk_id, chunk_size = struct.unpack_from("<4sI", raw, pos)
+    if chunk_id == b"fmt " and chunk_size >= 16:
+      tag, channels, _, _, _, bits = struct.unpack_from("<HHIIHH", raw, pos + 8)
+      return tag, channels, bits
+    # chunks are padded to an even size
+    pos += 8 + chunk_size + (chunk_size & 1)
+  raise ValueError("no fmt chunk")
+
+def convert_audio(raw: bytes) -> bytes:
+  """Returns the WAV file as plain 16-bit PCM, or as-is if it already is"""
+  # anything else is written again, e.g. a WAVE_FORMAT_EXTENSIBLE file, which
+  # Sfx would reject
+  tag, channels, bits = wav_format(raw)
+  if tag == WAVE_FORMAT_PCM and channels in (1, 2) and bits == AUDIO_WIDTH * 8:
+    return raw
+  with wave.open(io.BytesIO(raw)) as src:
+    channels = src.getnchannels()
+    width = src.getsampwidth()
+    rate = src.getframerate()
+    frames = src.readframes(src.getnframes())
+  if channels not in (1, 2):
+    raise ValueError(f"{channels} channels are not supported")
+
+  out = io.BytesIO()
+  with wave.open(out, "wb") as dst:
+    dst.setnchannels(channels)
+    dst.setsampwidth(AUDIO_WIDTH)
+    dst.setframerate(rate)
+    dst.writeframes(encode_pcm(decode_pcm(frames, width)))
+  converted = out.getvalue()
+  if wav_format(converted) != (WAVE_FORMAT_PCM, channels, AUDIO_WIDTH * 8):
+    raise ValueError("the converted file is not plain 16-bit PCM")
+  return converted
+
+def cached_audio(raw: bytes) -> bytes:
+  """Converts the WAV file, reusing the result of an earlier build if the source
+  has not changed"""
+  # named after the format too, so conversions to an older one are not reused
+  cached = g_audio / f"{zlib.crc32(raw):08x}-{len(raw)}-pcm{AUDIO_WIDTH * 8}.wav"
+  if cached.exists():
+    return cached.read_bytes()
+  converted = convert_audio(raw)
+  g_audio.mkdir(exist_ok=True)
+  cached.write_bytes(converted)
+  return converted
+
+def load_ignores() -> list[str]:
+  path = g_src / IGNORE_FILE
+  if not path.exists():
+    return []
+  patterns = []
+  for line in path.read_text().splitlines():
+    line = line.strip()
+    if line and not line.startswith("#"):
+      patterns.append(line)
+  return patterns
+
+def is_ignored(name: str, patterns: list[str]) -> bool:
+  if name.startswith("_") or name.startswith("."):
+    return True
+  return any(fnmatch.fnmatchcase(name, pattern) for pattern in patterns)
+
+def write_entry(name: str, raw: bytes, srcfile: bip.Path | None = None) -> int:
+  """Stages one entry, returning its stored size"""
+  stored = pack_entry(name, raw)
+  if stored is raw and srcfile is not None:
+    try:
+      os.link(srcfile, g_stage / name)
+    except OSError:
+      shutil.copy2(srcfile, g_stage / name)
+  else:
+    (g_stage / name).write_bytes(stored)
+  return len(stored)
+
+def write_pak(path: bip.Path, entries: dict[str, bytes]) -> None:
+  """Writes the entries, uncompressed, into a pak the game memory-maps. The pak
+  is stamped with the size and CRC of the finished bundle, so the game ignores
+  it next to any other bundle."""
+  bundle = g_out.read_bytes()
+  names = bytearray()
+  name_offsets = []
+  header_size = 24 + 16 * len(entries)
+  for name in entries:
+    name_offsets.append(header_size + len(names))
+    names += name.encode("utf-8")
+
+  data = bytearray()
+  data_start = header_size + len(names)
+  data_start += -data_start % PAK_ALIGN
+  directory = bytearray()
+  for (name, raw), name_offset in zip(entries.items(), name_offsets):
+    data += b"\0" * (-len(data) % PAK_ALIGN)
+    directory += struct.pack("<IIII", name_offset, len(name.encode("utf-8")),
+                             data_start + len(data), len(raw))
+    data += raw
+
+  header = struct.pack("<4sHHIIQ", PAK_MAGIC, PAK_VERSION, 0, len(entries),
+                       zlib.crc32(bundle), len(bundle))
+  padding = b"\0" * (data_start - header_size - len(names))
+  path.write_bytes(header + directory + names + padding + data)
+
+def stage() -> dict[str, bytes] | None:
+  """Copies the bundle sources into the staging directory, leaving out ignored
+  files, compiles the JSON data files next to them and packs what it can.
+  Returns the entries for the pak, which can only be written once the bundle
+  is."""
+  if g_stage.exists():
+    shutil.rmtree(g_stage)
+  g_stage.mkdir(parents=True)
+  if g_pak.exists():
+    g_pak.unlink()
+
+  patterns = load_ignores()
+  skipped = 0
+  source_size = 0
+  stored_size = 0
+  stored_sizes: dict[str, int] = {}
+  pak_entries: dict[str, bytes] = {}
+  converted = 0
+  for srcfile in sorted(g_src.iterdir()):
+    if not srcfile.is_file():
+      continue
+    if is_ignored(srcfile.name, patterns):
+      skipped += srcfile.stat().st_size
+      continue
+    raw = srcfile.read_bytes()
+    link = srcfile
+    if srcfile.suffix.lower() == AUDIO_SUFFIX:
+      try:
+        audio = cached_audio(raw)
+      except (wave.Error, ValueError, EOFError, struct.error) as err:
+        bip.err(f"Could not convert `{srcfile.name}`: {err}",
+                 "It will be stored as-is and converted at runtime.")
+        audio = raw
+      if audio != raw:
+        raw = audio
+        link = None
+        converted += 1
+    stored = write_entry(srcfile.name, raw, link)
+    if srcfile.suffix in PAK_SUFFIXES:
+      pak_entries[srcfile.name] = raw
+    stored_sizes[srcfile.name] = stored
+    source_size += len(raw)
+    stored_size += stored
+
+  for source, (blob, kind) in COMPILED.items():
+    if source not in stored_sizes:
+      continue
+    raw = pak_entries[source]
+    try:
+      compiled = compile_blob(raw, stored_sizes[source], kind)
+      # the pak holds the JSON uncompressed
+      pak_entries[blob] = compile_blob(raw, len(raw), kind)
+    except (ValueError, KeyError, TypeError, struct.error) as err:
+      bip.err(f"Could not compile `{source}`: {err}",
+               "The game will fall back to parsing the JSON file.")
+      continue
+    source_size += len(compiled)
+    stored_size += write_entry(blob, compiled)
+
+  print(f"bundle: left out {skipped} bytes of source files, "
+        f"stored {source_size} bytes as {stored_size}")
+  print(f"bundle: converted {converted} audio files to {AUDIO_WIDTH * 8}-bit")
+  return pak_entries
+
 def run() -> bool:
-  if not bip.cmd("nwgebndl", ["create", f"{g_src}", f"{g_out}"]):
+  pak_entries = stage()
+  if pak_entries is None:
+    return False
+
+  if not bip.cmd("nwgebndl", ["create", f"{g_stage}", f"{g_out}"]):
     return False
 
+  write_pak(g_pak, pak_entries)
   return True
@@ -0,0 +1,279 @@
+#include "AssetCache.hpp"
+#include "config.hpp"
+#include "reviews.hpp"
+#include "Sfx.hpp"
+#include <nwge/audio/Buffer.hpp>
+#include <algorithm>
+#include <nwge/console.hpp>
+#if __has_include(<malloc.h>)
+#include <malloc.h>
+#endif
+
+using namespace nwge;
+
+namespace sbs {
+
+void AssetCache::trim() {
+  usize current = total();
+  auto iter = mEntries.end();
+  while(current > mBudget && iter != mEntries.begin()) {
+    --iter;
+    // still held by a state
+    if(iter->use_count() > 1) {
+      continue;
+    }
+    const auto &entry = **iter;
+    console::note("Evicting {} ({} bytes)", StringView{entry.key.data(), entry.key.size()}, entry.cost);
+    current -= entry.cost;
+    mIndex.erase(entry.key);
+    iter = mEntries.erase(iter);
+  }
+}
+
+void AssetCache::forget(StringView path, StringView name) {
+  auto found = mIndex.find(makeKey(path, name));
+  if(found == mIndex.end() || found->second->use_count() > 1) {
+    return;
+  }
+  const auto &entry = **found->second;
+  console::note("Releasing {} ({} bytes)", StringView{entry.key.data(), entry.key.size()}, entry.cost);
+  mEntries.erase(found->second);
+  mIndex.erase(found);
+}
+
+void AssetCache::discard(const EntryBase &entry) {
+  auto found = mIndex.find(entry.key);
+  if(found == mIndex.end() || found->second->get() != &entry) {
+    return;
+  }
+  console::note("Dropping {}, it did not load", StringView{entry.key.data(), entry.key.size()});
+  mEntries.erase(found->second);
+  mIndex.erase(found);
+}
+
+void AssetCache::handOff(StringView path, const AssetManifest *next) {
+  mCarried.clear();
+  if(next != nullptr) {
+    for(const auto &entry: next->entries) {
+      auto found = mIndex.find(makeKey(path, entry.name));
+      if(found != mIndex.end()) {
+        mCarried.push_back(*found->second);
+        // the next state uses it first, so it is the most recently used
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+      }
+    }
+  }
+
+  usize count = mEntries.size();
+  usize before = total();
+  trim();
+  usize released = count - mEntries.size();
+#ifdef __GLIBC__
+  if(released != 0) {
+    // give the freed heap back, so the next state's preload can reuse the pages
+    malloc_trim(0);
+  }
+#endif
+  console::note("Handing off {} assets, released {} ({} bytes)",
+    mCarried.size(), released, before - total());
+}
+
+void AssetCache::endHandOff() {
+  mCarried.clear();
+}
+
+void AssetCache::setBudget(usize budget) {
+  mBudget = budget;
+  trim();
+}
+
+usize AssetCache::total() const {
+  usize sum = 0;
+  for(const auto &entry: mEntries) {
+    sum += entry->cost;
+  }
+  return sum;
+}
+
+void AssetCache::recordTiming(std::string_view key, const char *stage, Clock::time_point start) {
+  auto time = Clock::now() - start;
+  bool worker = jobs::onWorker();
+  std::lock_guard lock{mTimingMutex};
+  mTimings.push_back({std::string{key}, stage, time, worker});
+}
+
+void AssetCache::markEngineStart() {
+  mEngineStart = Clock::now();
+}
+
+void AssetCache::markEngineLoad(std::string_view key) {
+  recordTiming(key, "load", mEngineStart);
+  mEngineStart = Clock::now();
+}
+
+void AssetCache::reportTimings() {
+  std::vector<Timing> timings;
+  {
+    std::lock_guard lock{mTimingMutex};
+    timings.swap(mTimings);
+  }
+  if(timings.empty()) {
+    return;
+  }
+  std::sort(timings.begin(), timings.end(), [](const auto &lhs, const auto &rhs) {
+    return lhs.time > rhs.time;
+  });
+  Clock::duration mainTotal{}, workerTotal{};
+  for(const auto &timing: timings) {
+    (timing.worker ? workerTotal : mainTotal) += timing.time;
+  }
+  using Ms = std::chrono::duration<f64, std::milli>;
+  console::note("Asset timings: {:.2f} ms on the main thread, {:.2f} ms across {} workers",
+    Ms(mainTotal).count(), Ms(workerTotal).count(), jobs::workerCount());
+  for(const auto &timing: timings) {
+    console::note("  {:8.2f} ms  {} {}{}",
+      Ms(timing.time).count(), timing.stage,
+      StringView{timing.key.data(), timing.key.size()},
+      timing.worker ? " (worker)" : "");
+  }
+}
+
+std::string AssetCache::makeKey(StringView path, StringView name) {
+  std::string key;
+  key.reserve(path.size() + 1 + name.size());
+  key.append(path.begin(), path.size());
+  key.push_back(':');
+  key.append(name.begin(), name.size());
+  return key;
+}
+
+AssetCache &assetCache() {
+  // intentionally leaked, so no asset is freed after the renderer is gone
+  static auto *sCache = new AssetCache;
+  return *sCache;
+}
+
+CachedBundle &CachedBundle::nqManifest(const AssetManifest &manifest, u8 kinds) {
+  for(const auto &entry: manifest.entries) {
+    if((entry.kind & kinds) == 0) {
+      continue;
+    }
+    switch(entry.kind) {
+    case AssetManifest::Texture:
+      pin<render::Texture>(entry, [this](const auto &item, auto &handle){
+        nqTexture(item.name, handle, false);
+      });
+      break;
+    case AssetManifest::Font:
+      pin<render::Font>(entry, [this](const auto &item, auto &handle){
+        nqFont(item.name, handle, false);
+      });
+      break;
+    case AssetManifest::Sound:
+      pin<Unpacked<audio::Buffer>>(entry, [this](const auto &item, auto &handle){
+        nqCustom(item.name, handle, false);
+      });
+      break;
+    case AssetManifest::SoundEffect:
+      pin<Sfx>(entry, [this](const auto &item, auto &handle){
+        nqCustom(item.name, handle, false);
+      });
+      break;
+    case AssetManifest::Animation:
+      pin<render::AnimatedTexture>(entry, [this](const auto &item, auto &handle){
+        nqCustom(item.name, handle, false);
+      });
+      break;
+    case AssetManifest::ConfigFile:
+      pin<ConfigSnapshot>(entry, [this](const auto &item, auto &handle){
+        nqCompiled(item.name, item.compiled, blob::Config, handle, false);
+      });
+      break;
+    case AssetManifest::ReviewsFile:
+      pin<Reviews>(entry, [this](const auto &item, auto &handle){
+        nqCompiled(item.name, item.compiled, blob::Reviews, handle, false);
+      });
+      break;
+    }
+  }
+  return *this;
+}
+
+CachedBundle &CachedBundle::nqConfig() {
+  if(sharedConfig() == nullptr) {
+    AssetHandle<ConfigSnapshot> handle;
+    nqCompiled("cfg.json"_sv, "cfg.bin"_sv, blob::Config, handle, false);
+    pinLocal(std::move(handle));
+  }
+  return *this;
+}
+
+bool CachedBundle::wait() {
+  bool ok = true;
+  for(const auto &entry: mWaitList) {
+    if(entry->pending.valid() && !entry->pending.get()) {
+      ok = false;
+    }
+    // the parse is over, so its messages can be shown here on the main thread
+    entry->log.report();
+  }
+  mWaitList.clear();
+  if(mOpened && !TextureCache::shared().finish(mBundle)) {
+    ok = false;
+  }
+  dropFailed();
+  assetCache().reportTimings();
+  // whatever was carried across is held by this state by now
+  assetCache().endHandOff();
+  return ok;
+}
+
+bool CachedBundle::ready() const {
+  for(const auto &entry: mWaitList) {
+    if(entry->pending.valid()
+    && entry->pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return false;
+    }
+  }
+  return !mOpened || TextureCache::shared().ready(mBundle);
+}
+
+void CachedBundle::beginHandOff(const AssetManifest *next) {
+  dropFailed();
+  assetCache().handOff(mPath, next);
+}
+
+void CachedBundle::handOff(const AssetManifest *next) {
+  for(auto &release: mReleasers) {
+    release();
+  }
+  mReleasers.clear();
+  mWaitList.clear();
+  if(mOpened) {
+    TextureCache::shared().drop(mBundle);
+  }
+  dropFailed();
+  mPins.clear();
+  assetCache().handOff(mPath, next);
+}
+
+void CachedBundle::dropFailed() {
+  for(const auto &entry: mMisses) {
+    if(entry->failed()) {
+      assetCache().discard(*entry);
+    }
+  }
+  mMisses.clear();
+}
+
+data::Bundle &CachedBundle::raw() {
+  if(!mOpened) {
+    mBundle.load({mPath});
+    mOpened = true;
+    // the engine starts loading once preload() returns
+    assetCache().markEngineStart();
+  }
+  return mBundle;
+}
+
+} // namespace sbs
@@ -0,0 +1,406 @@
+#pragma once
+
+/*
+AssetCache.hpp
+--------------
+Process-wide cache of bundle assets, shared between states
+*/
+
+#include "arena.hpp"
+#include "blob.hpp"
+#include "data.hpp"
+#include "jobs.hpp"
+#include "manifest.hpp"
+#include "TextureCache.hpp"
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/data/bundle.hpp>
+#include <nwge/render/Font.hpp>
+#include <nwge/render/Texture.hpp>
+
+namespace sbs {
+
+class AssetCache;
+
+AssetCache &assetCache();
+
+class AssetCache {
+private:
+  friend class CachedBundle;
+
+  struct EntryBase: std::enable_shared_from_this<EntryBase> {
+    std::string key;
+    usize cost = 0;
+
+    /* Enqueued right after the entry's load. Records the size of the bundle
+       entry, used as the entry's cost, and that the engine loaded it. */
+    struct SizeProbe {
+      EntryBase *entry;
+
+      bool load(nwge::data::RW &file);
+    } probe{this};
+    bool loaded = false;
+
+    /* set once the entry is being parsed on a worker thread */
+    std::shared_future<bool> pending;
+    /* what the parse had to say, reported by CachedBundle::wait() */
+    ParseLog log;
+
+    virtual ~EntryBase() = default;
+
+    std::weak_ptr<EntryBase> weak() {
+      return weak_from_this();
+    }
+
+    /* Whether loading the entry is over and did not work out. Only meaningful
+       once the engine is done with the bundle. */
+    [[nodiscard]] bool failed() const {
+      if(pending.valid()) {
+        return pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+          && !pending.get();
+      }
+      return !loaded;
+    }
+  };
+
+  template<typename T>
+  struct Entry: EntryBase {
+    T value;
+
+    /* data file which is parsed on a worker once it has been read */
+    std::unique_ptr<blob::CompiledFile> compiled;
+
+    blob::CompiledFile &compile(blob::Kind kind) {
+      compiled = std::make_unique<blob::CompiledFile>(kind);
+      compiled->onLoaded = [weak = this->weak()]{
+        auto self = std::static_pointer_cast<Entry>(weak.lock());
+        if(self == nullptr) {
+          // evicted while it was being read, nobody wants it any more
+          return true;
+        }
+        self->cost = self->compiled->bytes.size();
+        self->pending = jobs::submit([self]{
+          LoadScope scope;
+          auto start = Clock::now();
+          auto &file = *self->compiled;
+          bool isBlob = file.view.has_value();
+          bool ok = isBlob
+            ? self->value.parseBlob(*file.view, std::move(file.bytes), self->log)
+            : self->value.parse(file.text(), self->log);
+          file.view.reset();
+          file.bytes = {};
+          file.mapped = {};
+          assetCache().recordTiming(self->key, isBlob ? "parse blob" : "parse", start);
+          return ok;
+        });
+        return true;
+      };
+      return *compiled;
+    }
+  };
+
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /* 64 MiB worth of bundle entries */
+  static constexpr usize cDefaultBudget = usize(64) * 1024 * 1024;
+
+  template<typename T>
+  class Handle {
+  public:
+    Handle() = default;
+
+    [[nodiscard]] inline bool present() const {
+      return mEntry != nullptr;
+    }
+
+    inline T &operator*() const {
+      return mEntry->value;
+    }
+
+    inline T *operator->() const {
+      return &mEntry->value;
+    }
+
+  private:
+    friend class AssetCache;
+    friend class CachedBundle;
+
+    std::shared_ptr<Entry<T>> mEntry;
+
+    Handle(std::shared_ptr<Entry<T>> entry)
+      : mEntry(std::move(entry))
+    {}
+  };
+
+  /* Returns the handle for `name` in the bundle at `path`. If the asset is not
+     cached yet, `miss` is set and the caller must enqueue the load into the
+     returned handle. */
+  template<typename T>
+  Handle<T> acquire(nwge::StringView path, nwge::StringView name, bool &miss) {
+    auto key = makeKey(path, name);
+    auto found = mIndex.find(key);
+    if(found != mIndex.end()) {
+      mEntries.splice(mEntries.begin(), mEntries, found->second);
+      miss = false;
+      return {std::static_pointer_cast<Entry<T>>(*found->second)};
+    }
+
+    auto entry = std::make_shared<Entry<T>>();
+    entry->key = std::move(key);
+    mEntries.push_front(entry);
+    mIndex[entry->key] = mEntries.begin();
+    miss = true;
+    trim();
+    return {std::move(entry)};
+  }
+
+  /* Evicts least recently used assets that are not held by any state until the
+     cache fits in its budget. */
+  void trim();
+
+  /* Evicts the asset right away if no state holds it any more, regardless of
+     the budget. */
+  void forget(nwge::StringView path, nwge::StringView name);
+
+  /* Evicts an asset that failed to load, even if states still hold it, so the
+     next acquire() loads it again. */
+  void discard(const EntryBase &entry);
+
+  /* Keeps the cached assets the next state's manifest lists, held until
+     endHandOff(), and marks them most recently used. Then trims the other
+     assets no state holds down to the budget, so a state visited again soon
+     after finds its assets still cached. */
+  void handOff(nwge::StringView path, const AssetManifest *next);
+  void endHandOff();
+
+  void setBudget(usize budget);
+
+  [[nodiscard]] inline usize budget() const {
+    return mBudget;
+  }
+
+  [[nodiscard]] usize total() const;
+
+  /* Records that `stage` of loading `key` ran from `start` until now. Safe to
+     call from worker threads. */
+  void recordTiming(std::string_view key, const char *stage, Clock::time_point start);
+
+  /* Logs the timings recorded since the last report, slowest first. */
+  void reportTimings();
+
+private:
+  using EntryList = std::list<std::shared_ptr<EntryBase>>;
+
+  struct Timing {
+    std::string key;
+    const char *stage;
+    Clock::duration time;
+    bool worker;
+  };
+
+  usize mBudget = cDefaultBudget;
+  EntryList mEntries;
+  std::unordered_map<std::string, EntryList::iterator> mIndex;
+  /* assets passed from one state to the next, see handOff() */
+  std::vector<std::shared_ptr<EntryBase>> mCarried;
+
+  std::mutex mTimingMutex;
+  std::vector<Timing> mTimings;
+  /* the engine loads bundle entries one after another on the main thread, so
+     an entry's load is timed from the previous probe until its own */
+  Clock::time_point mEngineStart;
+
+  void markEngineStart();
+  void markEngineLoad(std::string_view key);
+
+  static std::string makeKey(nwge::StringView path, nwge::StringView name);
+};
+
+template<typename T>
+using AssetHandle = AssetCache::Handle<T>;
+
+inline bool AssetCache::EntryBase::SizeProbe::load(nwge::data::RW &file) {
+  s64 size = file.size();
+  entry->cost = size > 0 ? usize(size) : 0;
+  entry->loaded = true;
+  assetCache().markEngineLoad(entry->key);
+  return true;
+}
+
+/* Drop-in replacement for data::Bundle which goes through the asset cache. The
+   underlying bundle is only opened if something actually needs loading. */
+class CachedBundle {
+public:
+  CachedBundle(nwge::StringView path = "sbs.bndl"_sv)
+    : mPath(path)
+  {}
+
+  CachedBundle(const CachedBundle&) = delete;
+  CachedBundle(CachedBundle&&) = delete;
+  CachedBundle &operator=(const CachedBundle&) = delete;
+  CachedBundle &operator=(CachedBundle&&) = delete;
+
+  ~CachedBundle() {
+    dropFailed();
+    if(mOpened) {
+      TextureCache::shared().drop(mBundle);
+    }
+  }
+
+  /* The nq functions bind `out` to the cached asset, and handOff() resets it.
+     Pass `tracked = false` for a handle that does not outlive the call, whose
+     asset is pinned some other way. */
+  inline CachedBundle &nqTexture(nwge::StringView name, AssetHandle<nwge::render::Texture> &out, bool tracked = true) {
+    return nq(name, out, tracked, [](auto &bundle, auto name, auto &value) {
+      TextureCache::shared().nq(bundle, name, value);
+    });
+  }
+
+  inline CachedBundle &nqFont(nwge::StringView name, AssetHandle<nwge::render::Font> &out, bool tracked = true) {
+    return nq(name, out, tracked, [](auto &bundle, auto name, auto &value) {
+      bundle.nqFont(name, value);
+    });
+  }
+
+  template<typename T>
+  inline CachedBundle &nqCustom(nwge::StringView name, AssetHandle<T> &out, bool tracked = true) {
+    return nq(name, out, tracked, [](auto &bundle, auto name, auto &value) {
+      bundle.nqCustom(name, value);
+    });
+  }
+
+  /* Loads a JSON data file, or the blob the bundle step compiled from it. If
+     the pak has them, they are parsed straight out of the mapping and the
+     bundle is not touched. Otherwise only the file reads happen during the
+     load. Either way `T::parseBlob` or `T::parse` runs on a worker thread. Call
+     wait() before using the asset. */
+  template<typename T>
+  CachedBundle &nqCompiled(nwge::StringView source, nwge::StringView blobName, blob::Kind kind, AssetHandle<T> &out, bool tracked = true) {
+    bool miss;
+    out = assetCache().acquire<T>(mPath, source, miss);
+    if(miss) {
+      mMisses.push_back(out.mEntry);
+      auto &file = out.mEntry->compile(kind);
+      if(file.openMapped(source, blobName)) {
+        file.onLoaded();
+      } else {
+        raw()
+          .nqCustom(blobName, file.blobLoader)
+          .nqCustom(source, file.sourceLoader);
+      }
+    }
+    mWaitList.push_back(out.mEntry);
+    if(tracked) {
+      track(out);
+    }
+    return *this;
+  }
+
+  /* Enqueues cfg.json unless the shared config has already been parsed. Once
+     wait() returns true, sharedConfig() is available. */
+  CachedBundle &nqConfig();
+
+  /* Enqueues the manifest's assets of the given kinds without binding them to
+     anything, so that they are already cached by the time a later state wants
+     them. Data assets are parsed in the background. */
+  CachedBundle &nqManifest(const AssetManifest &manifest, u8 kinds = AssetManifest::cAll);
+
+  /* Drops `out` and evicts the asset from the cache, unless another state
+     still holds it. */
+  template<typename T>
+  inline CachedBundle &release(nwge::StringView name, AssetHandle<T> &out) {
+    out = {};
+    assetCache().forget(mPath, name);
+    return *this;
+  }
+
+  /* Waits for background parsing and decoding of the assets enqueued through
+     this bundle, uploads its textures, then logs how long each asset took.
+     Returns false if any of them failed to parse. */
+  bool wait();
+
+  /* Whether wait() would return without waiting on a worker. */
+  [[nodiscard]] bool ready() const;
+
+  /* Pins the cached assets the next state uses and trims the ones neither
+     state uses down to the budget, while this state keeps its own. Call it as
+     soon as the next state is known, e.g. when a fade-out starts, so the
+     excess is not resident during the fade. handOff() must still follow. */
+  void beginHandOff(const AssetManifest *next);
+
+  /* Called by a state right before it swaps to the next one, once its fade
+     is over and it needs none of its assets. Drops every handle bound through
+     this bundle, then trims the cache down to its budget, least recently
+     used first, never evicting the assets in the next state's manifest,
+     which pass across without a reload. The next state's preload thus runs
+     on top of at most a budget's worth of older assets. The state must not
+     touch its handles afterwards. */
+  void handOff(const AssetManifest *next);
+
+  /* the underlying bundle, for assets which should bypass the cache */
+  nwge::data::Bundle &raw();
+
+private:
+  nwge::StringView mPath;
+  nwge::data::Bundle mBundle;
+  bool mOpened = false;
+  std::vector<std::shared_ptr<AssetCache::EntryBase>> mWaitList;
+  /* entries whose load this bundle enqueued, see dropFailed() */
+  std::vector<std::shared_ptr<AssetCache::EntryBase>> mMisses;
+  std::vector<std::shared_ptr<void>> mPins;
+  /* reset the handles bound through this bundle */
+  std::vector<std::function<void()>> mReleasers;
+
+  template<typename T>
+  void track(AssetHandle<T> &out) {
+    mReleasers.emplace_back([&out]{
+      out = {};
+    });
+  }
+
+  /* Pins an asset bound to a local, untracked handle. */
+  template<typename T>
+  void pinLocal(AssetHandle<T> &&handle) {
+    mPins.push_back(std::move(handle.mEntry));
+  }
+
+  /* Evicts the entries this bundle failed to load, so they are not handed
+     out half-loaded. */
+  void dropFailed();
+
+  template<typename T, typename Fn>
+  CachedBundle &nq(nwge::StringView name, AssetHandle<T> &out, bool tracked, Fn &&load) {
+    bool miss;
+    out = assetCache().acquire<T>(mPath, name, miss);
+    if(miss) {
+      auto &bundle = raw();
+      load(bundle, name, out.mEntry->value);
+      bundle.nqCustom(name, out.mEntry->probe);
+      mMisses.push_back(out.mEntry);
+    }
+    if(tracked) {
+      track(out);
+    }
+    return *this;
+  }
+
+  template<typename T, typename Fn>
+  void pin(const AssetManifest::Entry &entry, Fn &&nqFn) {
+    AssetHandle<T> handle;
+    nqFn(entry, handle);
+    pinLocal(std::move(handle));
+  }
+};
+
+} // namespace sbs
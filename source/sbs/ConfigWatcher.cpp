@@ -0,0 +1,224 @@
+#include "ConfigWatcher.hpp"
+
+#ifdef DEBUG
+
+#include "arena.hpp"
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <nwge/console.hpp>
+
+#if __has_include(<sys/inotify.h>)
+#define SBS_INOTIFY 1
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace nwge;
+
+namespace sbs {
+
+/* where the source tree is, relative to where the game runs from */
+static constexpr std::array<const char*, 2> cDataDirs{
+  "../source/data",
+  "source/data",
+};
+static constexpr std::string_view cFileName = "cfg.json";
+
+/* editors write in several steps, so wait for them to settle */
+static constexpr auto cSettleTime = std::chrono::milliseconds(50);
+
+static bool sameText(StringView lhs, StringView rhs) {
+  return std::string_view{lhs.begin(), lhs.size()} == std::string_view{rhs.begin(), rhs.size()};
+}
+
+static bool sameStore(const Config &from, const Config &to) {
+  if(from.store.size() != to.store.size()) {
+    return false;
+  }
+  for(usize i = 0; i < from.store.size(); ++i) {
+    const auto &lhs = from.store[i];
+    const auto &rhs = to.store[i];
+    if(lhs.kind != rhs.kind || lhs.argument != rhs.argument
+    || lhs.price != rhs.price || lhs.icon != rhs.icon
+    || lhs.prestige != rhs.prestige
+    || !sameText(lhs.name, rhs.name) || !sameText(lhs.desc, rhs.desc)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+u8 diffConfig(const Config &from, const Config &to) {
+  u8 changes = 0;
+  if(!(from.toilet == to.toilet && from.shitter == to.shitter && from.water == to.water)) {
+    changes |= GeometryChanged;
+  }
+  if(!(from.lube == to.lube && from.gravity == to.gravity
+  && from.oxy == to.oxy && from.brick == to.brick)) {
+    changes |= BalanceChanged;
+  }
+  if(!sameStore(from, to)) {
+    changes |= StoreChanged;
+  }
+  if(!sameText(from.socials.xDotCom, to.socials.xDotCom)
+  || !sameText(from.socials.discord, to.socials.discord)) {
+    changes |= SocialsChanged;
+  }
+  return changes;
+}
+
+#ifdef SBS_INOTIFY
+
+ConfigWatcher::ConfigWatcher() {
+  const char *dir = nullptr;
+  for(const auto *candidate: cDataDirs) {
+    mPath = candidate;
+    mPath.push_back('/');
+    mPath.append(cFileName);
+    struct stat info{};
+    if(stat(mPath.c_str(), &info) == 0) {
+      dir = candidate;
+      break;
+    }
+  }
+  if(dir == nullptr) {
+    return;
+  }
+
+  mNotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  mWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  // the directory is watched, as editors often replace the file on save
+  if(mNotify < 0 || mWake < 0
+  || inotify_add_watch(mNotify, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    console::error("Could not watch {}: {}", mPath, std::strerror(errno));
+    return;
+  }
+  console::note("Watching {} for changes.", mPath);
+  mThread = std::thread{[this]{
+    watchLoop();
+  }};
+}
+
+ConfigWatcher::~ConfigWatcher() {
+  if(mThread.joinable()) {
+    u64 one = 1;
+    [[maybe_unused]] auto written = write(mWake, &one, sizeof(one));
+    mThread.join();
+  }
+  if(mNotify >= 0) {
+    close(mNotify);
+  }
+  if(mWake >= 0) {
+    close(mWake);
+  }
+}
+
+#else
+
+// without inotify, cfg.json is not watched
+ConfigWatcher::ConfigWatcher() = default;
+ConfigWatcher::~ConfigWatcher() = default;
+
+#endif
+
+ConfigPtr ConfigWatcher::poll() {
+  ParseLog log;
+  bool failed;
+  ConfigPtr reloaded;
+  {
+    std::lock_guard lock{mMutex};
+    log = std::move(mLog);
+    mLog = ParseLog{};
+    failed = std::exchange(mFailed, false);
+    reloaded = std::move(mReloaded);
+  }
+  // the error dialog blocks, so not while the watcher may need the lock
+  log.report();
+  if(failed) {
+    console::error("{} did not parse, keeping the current config.", mPath);
+  }
+  return reloaded;
+}
+
+#ifdef SBS_INOTIFY
+
+void ConfigWatcher::watchLoop() {
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  bool pending = false;
+  for(;;) {
+    std::array<pollfd, 2> fds{{
+      {mNotify, POLLIN, 0},
+      {mWake, POLLIN, 0},
+    }};
+    int timeout = pending ? int(cSettleTime.count()) : -1;
+    int ready = ::poll(fds.data(), fds.size(), timeout);
+    if(ready < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    if(fds[1].revents != 0) {
+      return;
+    }
+    if(ready == 0 && pending) {
+      pending = false;
+      reload();
+      continue;
+    }
+    if(fds[0].revents == 0) {
+      continue;
+    }
+
+    ssize_t size;
+    while((size = read(mNotify, buffer.data(), buffer.size())) > 0) {
+      for(ssize_t pos = 0; pos < size;) {
+        const auto *event = reinterpret_cast<const inotify_event*>(buffer.data() + pos);
+        if(event->len != 0 && std::string_view{event->name} == cFileName) {
+          pending = true;
+        }
+        pos += ssize_t(sizeof(inotify_event) + event->len);
+      }
+    }
+  }
+}
+
+void ConfigWatcher::reload() {
+  LoadScope scope;
+  LoadVector<char> raw;
+  int fd = open(mPath.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    return;
+  }
+  std::array<char, 4096> chunk;
+  ssize_t got;
+  while((got = read(fd, chunk.data(), chunk.size())) > 0) {
+    raw.insert(raw.end(), chunk.begin(), chunk.begin() + got);
+  }
+  close(fd);
+
+  // reported by poll(), this thread must not print or open dialogs
+  auto config = std::make_shared<Config>();
+  ParseLog log;
+  bool parsed = config->parse({raw.data(), raw.size()}, log);
+  std::lock_guard lock{mMutex};
+  mLog = std::move(log);
+  mFailed = !parsed;
+  if(parsed) {
+    mReloaded = std::move(config);
+  }
+}
+
+#endif
+
+} // namespace sbs
+
+#endif
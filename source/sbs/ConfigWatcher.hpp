@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ConfigWatcher.hpp
+-----------------
+Reloads cfg.json from the source tree as it is edited, in debug builds
+*/
+
+#ifdef DEBUG
+
+#include "config.hpp"
+#include "data.hpp"
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* Sections of the config that differ between two configs. */
+enum ConfigChange: u8 {
+  GeometryChanged = 1 << 0, // toilet, shitter, water
+  BalanceChanged  = 1 << 1, // lube, gravity, oxy, brick
+  StoreChanged    = 1 << 2,
+  SocialsChanged  = 1 << 3,
+};
+
+u8 diffConfig(const Config &from, const Config &to);
+
+/* Watches the unpacked cfg.json with inotify. Whenever it is written, a thread
+   of its own parses it again; poll() hands out the result on the main thread.
+   Does nothing if there is no source tree next to the game, or on systems
+   without inotify. */
+class ConfigWatcher {
+public:
+  ConfigWatcher();
+  ConfigWatcher(const ConfigWatcher&) = delete;
+  ConfigWatcher(ConfigWatcher&&) = delete;
+  ConfigWatcher &operator=(const ConfigWatcher&) = delete;
+  ConfigWatcher &operator=(ConfigWatcher&&) = delete;
+  ~ConfigWatcher();
+
+  /* The config parsed since the last call, or null. Also reports what the
+     last parse had to say, so call it on the main thread. */
+  ConfigPtr poll();
+
+private:
+  std::string mPath;
+  int mNotify = -1;
+  int mWake = -1;
+  std::thread mThread;
+
+  std::mutex mMutex;
+  ConfigPtr mReloaded;
+  /* what the last parse had to say, and whether it failed */
+  ParseLog mLog;
+  bool mFailed = false;
+
+  void watchLoop();
+  void reload();
+};
+
+} // namespace sbs
+
+#endif
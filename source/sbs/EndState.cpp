@@ -1,6 +1,10 @@
+#include "AssetCache.hpp"
+#include "memory.hpp"
 #include "save.hpp"
+#include "saves.hpp"
+#include "startup.hpp"
 #include "states.hpp"
-#include <nwge/data/bundle.hpp>
+#include <nwge/console.hpp>
 #include <nwge/data/store.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/draw.hpp>
@@ -11,11 +15,10 @@ namespace sbs {
 
 class EndState: public State {
 private:
-  data::Bundle mBundle;
-  render::AnimatedTexture mTexture;
+  CachedBundle mBundle;
+  AssetHandle<render::AnimatedTexture> mTexture;
   f32 mCountdown = 11.91f;
-  audio::Source mSource;
-  audio::Buffer mSound;
+  Music mMusic;
 
   data::Store mStore;
   Savefile mSave{};
@@ -23,32 +26,40 @@ class EndState: public State {
 public:
   bool preload() override {
     mBundle
-      .load({"sbs.bndl"})
-      .nqCustom("michael.gif", mTexture)
-      .nqCustom("michael.wav", mSound);
-    mStore.nqLoad("save.json", mSave.v2);
+      .nqCustom("michael.gif", mTexture);
+    mMusic.nq(mBundle.raw(), "michael.wav"_sv);
+    if(saves::migrationPending()) {
+      mStore.nqLoad("save.json", mSave.v2);
+    }
     return true;
   }
 
   bool init() override {
-    auto prestige = s16(mSave.v2.prestige + 1);
+    reportStartup();
+    reportPeakMemory("from the store to the end");
+    console::note("Peak RSS of the whole run: {:.1f} MiB",
+      f64(overallPeakMemory()) / (1024.0 * 1024.0));
+    saves::load(mSave);
+    auto prestige = s16(mSave.v3.prestige + 1);
     mSave = {};
-    mSave.v2.prestige = prestige;
-    mStore.nqSave("save.json", mSave);
-    mSource.buffer(mSound);
-    mSource.play();
+    mSave.v3.prestige = prestige;
+    // the wiped save should not wait for the window
+    saves::nq(mSave);
+    saves::flush();
+    mMusic.play();
     // nwge starts playing the animation immediately, so we have to stop it
     // first to reset back to the first frame and then start it again to ensure
     // it's in sync with audio
-    mTexture.stop();
-    mTexture.play();
+    mTexture->stop();
+    mTexture->play();
     return true;
   }
 
   bool tick(f32 delta) override {
+    saves::report();
     mCountdown -= delta;
     if(mCountdown <= 0) {
-      if(mSave.v2.prestige == 1) {
+      if(mSave.v3.prestige == 1) {
         dialog::info("Notification", "Something new has appeared in the store...");
       }
       return false;
@@ -57,7 +68,7 @@ class EndState: public State {
   }
 
   void render() const override {
-    render::rect({0, 0, 0}, {1, 1}, mTexture);
+    render::rect({0, 0, 0}, {1, 1}, *mTexture);
   }
 };
 
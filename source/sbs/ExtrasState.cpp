@@ -1,6 +1,8 @@
+#include "AssetCache.hpp"
+#include "StringPool.hpp"
 #include "states.hpp"
+#include <array>
 #include <nwge/bind.hpp>
-#include <nwge/data/bundle.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/Texture.hpp>
 #include <nwge/render/mat.hpp>
@@ -18,19 +20,19 @@ class ExtrasState: public State {
   {}
 
   bool preload() override {
+    // each tab's assets are only loaded once the tab is looked at
     mBundle
-      .load({"sbs.bndl"})
       .nqFont("GrapeSoda.cfn"_sv, mFont)
-      .nqTexture("email.png"_sv, mEMail)
-      .nqTexture("deving.png"_sv, mDevingTexture)
-      .nqTexture("rock.png"_sv, mRockTexture)
-      .nqTexture("brick.png"_sv, mBrickTexture)
-      .nqCustom("credits.txt"_sv, mCredits);
+      .nqTexture("brick.png"_sv, mBrickTexture);
     return true;
   }
 
   bool init() override {
+    if(!mBundle.wait()) {
+      return false;
+    }
     populateBricks();
+    requestTab(mSelection);
     return true;
   }
 
@@ -43,6 +45,7 @@ class ExtrasState: public State {
     switch(evt.type) {
     case Event::MouseMotion:
       mHover = buttonAt(evt.motion.to);
+      requestTab(mHover);
       break;
 
     case Event::MouseUp:
@@ -54,6 +57,7 @@ class ExtrasState: public State {
         mFadeOut = 0.0f;
       } else {
         mSelection = mHover = hover;
+        requestTab(mSelection);
       }
       break;
 
@@ -65,6 +69,7 @@ class ExtrasState: public State {
 
   bool tick(f32 delta) override {
     updateBricks(delta);
+    updateTabs(delta);
 
     if(mFadeIn >= 0) {
       mFadeIn += delta;
@@ -86,7 +91,7 @@ class ExtrasState: public State {
 
   void render() const override {
     render::clear({0, 0, 0});
-    renderBricks(mBrickTexture);
+    renderBricks(*mBrickTexture);
 
     render::color(cBgClr);
     render::rect({cInnerX, cInnerY, cBgZ}, {cInnerW, cInnerH});
@@ -95,14 +100,18 @@ class ExtrasState: public State {
       {cSeparatorX, cSeparatorY, cTextZ},
       {cSeparatorW, cSeparatorH});
 
-    mFont.draw("Extras", {cBigTextX, cBigTextY, cTextZ}, cBigTextH);
+    mFont->draw("Extras", {cBigTextX, cBigTextY, cTextZ}, cBigTextH);
     renderButton("Lore", BLore);
     renderButton("BTS", BBehindTheScenes);
     renderButton("Credits", BCredits);
     renderButton("Rock", BRock);
     renderButton("Back", BBack);
 
-    switch(mSelection) {
+    switch(isTab(mSelection) && !mTabs[mSelection].loaded ? BNone : mSelection) {
+    case BNone:
+      renderPlaceholder();
+      break;
+
     case BLore:
       renderLoreTab();
       break;
@@ -136,8 +145,8 @@ class ExtrasState: public State {
 
 private:
   Music mMusic;
-  data::Bundle mBundle;
-  render::Font mFont;
+  CachedBundle mBundle;
+  AssetHandle<render::Font> mFont;
   KeyBind mNext{"sbs.next", Key::Right, [this]{
     next();
   }};
@@ -221,6 +230,164 @@ class ExtrasState: public State {
 
   Button mSelection = BLore;
 
+  /* Seconds a tab may go unseen before its assets are released. */
+  static constexpr f32 cTabReleaseDelay = 30.0f;
+
+  struct Tab {
+    bool requested = false;
+    bool loaded = false;
+    f32 idle = 0;
+  };
+  std::array<Tab, BBack> mTabs{};
+  bool mTabLoading = false;
+
+  /* Loads one tab's assets while the Extras screen keeps running below it. */
+  class TabLoader: public SubState {
+  public:
+    TabLoader(ExtrasState &owner, Button tab)
+      : mOwner(owner), mTab(tab)
+    {}
+
+    bool preload() override {
+      mOwner.nqTab(mBundle, mTab);
+      return true;
+    }
+
+    bool on(Event &evt) override {
+      return mOwner.on(evt);
+    }
+
+    bool tick([[maybe_unused]] f32 delta) override {
+      // the textures are decoded on workers, the screen keeps running
+      if(!mBundle.ready()) {
+        return true;
+      }
+      if(!mBundle.wait()) {
+        return false;
+      }
+      mOwner.tabLoaded(mTab);
+      popSubState();
+      return true;
+    }
+
+    void render() const override {}
+
+  private:
+    ExtrasState &mOwner;
+    Button mTab;
+    CachedBundle mBundle;
+  };
+
+  static constexpr inline bool isTab(Button button) {
+    return button > BNone && button < BBack;
+  }
+
+  void requestTab(Button tab) {
+    if(!isTab(tab)) {
+      return;
+    }
+    mTabs[tab].idle = 0;
+    if(!mTabs[tab].loaded) {
+      mTabs[tab].requested = true;
+    }
+  }
+
+  void nqTab(CachedBundle &bundle, Button tab) {
+    switch(tab) {
+    case BLore:
+      bundle.nqTexture("email.png"_sv, mEMail);
+      break;
+    case BCredits:
+      bundle.nqCustom("credits.txt"_sv, mCredits);
+      break;
+    case BBehindTheScenes:
+      bundle.nqTexture("deving.png"_sv, mDevingTexture);
+      break;
+    case BRock:
+      bundle.nqTexture("rock.png"_sv, mRockTexture);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void tabLoaded(Button tab) {
+    // a hover while it was loading may have requested it again
+    mTabs[tab].requested = false;
+    mTabs[tab].loaded = true;
+    mTabs[tab].idle = 0;
+    mTabLoading = false;
+  }
+
+  void releaseTab(Button tab) {
+    switch(tab) {
+    case BLore:
+      mBundle.release("email.png"_sv, mEMail);
+      break;
+    case BCredits:
+      mBundle.release("credits.txt"_sv, mCredits);
+      break;
+    case BBehindTheScenes:
+      mBundle.release("deving.png"_sv, mDevingTexture);
+      break;
+    case BRock:
+      mBundle.release("rock.png"_sv, mRockTexture);
+      break;
+    default:
+      break;
+    }
+    mTabs[tab] = {};
+  }
+
+  void updateTabs(f32 delta) {
+    for(s32 i = 0; i < BBack; ++i) {
+      auto tab = Button(i);
+      auto &state = mTabs[tab];
+      if(tab == mSelection || tab == mHover) {
+        state.idle = 0;
+        continue;
+      }
+      if(state.loaded) {
+        state.idle += delta;
+        if(state.idle >= cTabReleaseDelay) {
+          releaseTab(tab);
+        }
+      }
+    }
+
+    if(mTabLoading) {
+      return;
+    }
+    // the selected tab goes first, then whatever was hovered
+    auto next = mTabs[mSelection].requested ? mSelection : BNone;
+    for(s32 i = 0; next == BNone && i < BBack; ++i) {
+      if(mTabs[i].requested) {
+        next = Button(i);
+      }
+    }
+    if(next != BNone) {
+      mTabs[next].requested = false;
+      mTabLoading = true;
+      pushSubStatePtr(new TabLoader(*this, next), {
+        .tickParent = true,
+        .renderParent = true,
+      });
+    }
+  }
+
+  static constexpr f32 cLoadingTextH = 0.04f;
+
+  void renderPlaceholder() const {
+    render::color(cButtonBgClr);
+    render::rect(
+      {cInnerX + cInnerPad, cInnerY + cInnerPad, cTextZ},
+      {cInnerW - 2*cInnerPad, cInnerH - 2*cInnerPad});
+    render::color();
+    mFont->draw("Loading...",
+      {cInnerX + 2*cInnerPad, cInnerY + 2*cInnerPad, cTextZ},
+      cLoadingTextH);
+  }
+
   static constexpr glm::vec4
     cBgClr{0, 0, 0, 0.6f},
     cButtonBgClr{0, 0, 0, 0.5f},
@@ -245,10 +412,10 @@ class ExtrasState: public State {
     } else {
       render::color(cButtonTextClr);
     }
-    mFont.draw(name, {baseX + cButtonTextX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
+    mFont->draw(name, {baseX + cButtonTextX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
   }
 
-  render::Texture mEMail;
+  AssetHandle<render::Texture> mEMail;
 
   static constexpr f32
     cLoreMailX = cInnerX + cInnerPad,
@@ -260,10 +427,10 @@ class ExtrasState: public State {
     render::rect(
       {cLoreMailX, cLoreMailY, cTextZ},
       {cLoreMailW, cLoreMailH},
-      mEMail);
+      *mEMail);
   }
 
-  render::Texture mDevingTexture;
+  AssetHandle<render::Texture> mDevingTexture;
 
   static constexpr f32
     cDevingX = cInnerX + cInnerPad,
@@ -284,9 +451,9 @@ class ExtrasState: public State {
     render::rect(
       {cDevingX, cDevingY, cTextZ},
       {cDevingW, cDevingH},
-      mDevingTexture,
+      *mDevingTexture,
       {{texX, 0}, {cDevingTexW, 1}});
-    mFont.draw(
+    mFont->draw(
       "Use arrows to cycle screenshots",
       {cDevingTextX, cDevingTextY, cTextZ},
       cButtonTextH);
@@ -294,15 +461,15 @@ class ExtrasState: public State {
 
   static constexpr f32 cCreditsTextX = cInnerX + 0.05f;
 
-  String<> mCredits;
+  AssetHandle<PooledText> mCredits;
 
   void renderCreditsTab() const {
-    glm::vec2 measure = mFont.measure(mCredits, cButtonTextH);
+    glm::vec2 measure = mFont->measure(*mCredits, cButtonTextH);
     f32 textY = cInnerY + (cInnerH - measure.y)/2.0f;
-    mFont.draw(mCredits, {cCreditsTextX, textY, cTextZ}, cButtonTextH);
+    mFont->draw(*mCredits, {cCreditsTextX, textY, cTextZ}, cButtonTextH);
   }
 
-  render::Texture mRockTexture;
+  AssetHandle<render::Texture> mRockTexture;
 
   static constexpr f32
     cRockX = cInnerX + cInnerPad,
@@ -311,7 +478,7 @@ class ExtrasState: public State {
     cRockH = cRockW;
 
   void renderRockTab() const {
-    render::rect({cRockX, cRockY, cTextZ}, {cRockW, cRockH}, mRockTexture);
+    render::rect({cRockX, cRockY, cTextZ}, {cRockW, cRockH}, *mRockTexture);
   }
 
   static constexpr s32 cBrickCount = 50;
@@ -335,7 +502,7 @@ class ExtrasState: public State {
   static constexpr glm::vec3
     cBrickColor{0.667f, 0.29f, 0.267f};
 
-  render::Texture mBrickTexture;
+  AssetHandle<render::Texture> mBrickTexture;
 
   struct Brick {
     glm::vec3 pos;
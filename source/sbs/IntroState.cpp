@@ -1,5 +1,5 @@
+#include "AssetCache.hpp"
 #include "states.hpp"
-#include <nwge/data/bundle.hpp>
 #include <nwge/render/AspectRatio.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/Texture.hpp>
@@ -31,12 +31,28 @@ class IntroState: public State {
 
   Music mMusic;
 
+  CachedBundle mBundle;
+
 public:
   IntroState(render::Texture &&logoTexture, Music &&music)
     : mLogo(std::move(logoTexture)), mMusic(std::move(music))
   {}
 
+  bool preload() override {
+    // The screen is black at this point anyway, so this is the cheapest moment
+    // to get the menu's and the game's assets into the cache. Whatever is still
+    // in flight from the warning screen keeps parsing in the background.
+    mBundle
+      .nqManifest(gMenuManifest, AssetManifest::cEngine)
+      .nqManifest(gShitManifest, AssetManifest::cEngine);
+    return true;
+  }
+
   bool init() override {
+    // uploads the textures decoded in the meantime, they are not used here
+    if(!mBundle.wait()) {
+      return false;
+    }
     mMusic.play();
     return true;
   }
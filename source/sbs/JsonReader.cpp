@@ -0,0 +1,409 @@
+#include "JsonReader.hpp"
+#include <charconv>
+#include <cstring>
+
+using namespace nwge;
+
+namespace sbs {
+
+JsonReader::JsonReader(StringView text)
+  : mBegin(text.begin()), mCur(text.begin()), mEnd(text.begin() + text.size())
+{}
+
+JsonReader::Kind JsonReader::peek() {
+  if(failed()) {
+    return Invalid;
+  }
+  skipSpace();
+  if(mCur == mEnd) {
+    return Invalid;
+  }
+  switch(*mCur) {
+  case '{':
+    return Object;
+  case '[':
+    return Array;
+  case '"':
+    return String;
+  case 't':
+  case 'f':
+    return Bool;
+  case 'n':
+    return Null;
+  case '-':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    return Number;
+  default:
+    return Invalid;
+  }
+}
+
+bool JsonReader::beginObject() {
+  if(peek() != Object) {
+    return fail("expected an object");
+  }
+  if(++mDepth > cMaxDepth) {
+    return fail("too deeply nested");
+  }
+  ++mCur;
+  mFirst = true;
+  return true;
+}
+
+bool JsonReader::nextKey(StringView &key) {
+  if(failed()) {
+    return false;
+  }
+  skipSpace();
+  if(mCur == mEnd) {
+    return fail("unexpected end of text");
+  }
+  if(*mCur == '}') {
+    ++mCur;
+    --mDepth;
+    mFirst = false;
+    return false;
+  }
+  if(!mFirst && !expect(',')) {
+    return false;
+  }
+  if(peek() != String) {
+    return fail("expected a key");
+  }
+  return readString(key) && expect(':');
+}
+
+bool JsonReader::beginArray() {
+  if(peek() != Array) {
+    return fail("expected an array");
+  }
+  if(++mDepth > cMaxDepth) {
+    return fail("too deeply nested");
+  }
+  ++mCur;
+  mFirst = true;
+  return true;
+}
+
+bool JsonReader::nextElement() {
+  if(failed()) {
+    return false;
+  }
+  skipSpace();
+  if(mCur == mEnd) {
+    return fail("unexpected end of text");
+  }
+  if(*mCur == ']') {
+    ++mCur;
+    --mDepth;
+    mFirst = false;
+    return false;
+  }
+  return mFirst || expect(',');
+}
+
+bool JsonReader::readString(StringView &out) {
+  if(peek() != String) {
+    return fail("expected a string");
+  }
+  const char *start = ++mCur;
+  while(mCur != mEnd) {
+    char chr = *mCur;
+    if(chr == '"') {
+      out = {start, usize(mCur - start)};
+      ++mCur;
+      mFirst = false;
+      return true;
+    }
+    if(chr == '\\') {
+      return readEscaped(start, out);
+    }
+    if(u8(chr) < 0x20) {
+      return fail("control character in string");
+    }
+    ++mCur;
+  }
+  return fail("unterminated string");
+}
+
+static bool isDigit(char chr) {
+  return chr >= '0' && chr <= '9';
+}
+
+/* Returns the end of the JSON number at `cur`, or nullptr if it is not one.
+   from_chars() alone would also take inf, nan, hex floats and leading
+   zeros. */
+static const char *numberEnd(const char *cur, const char *end) {
+  if(cur != end && *cur == '-') {
+    ++cur;
+  }
+  if(cur == end || !isDigit(*cur)) {
+    return nullptr;
+  }
+  if(*cur == '0') {
+    ++cur;
+    if(cur != end && isDigit(*cur)) {
+      return nullptr;
+    }
+  } else {
+    while(cur != end && isDigit(*cur)) {
+      ++cur;
+    }
+  }
+  if(cur != end && *cur == '.') {
+    ++cur;
+    if(cur == end || !isDigit(*cur)) {
+      return nullptr;
+    }
+    while(cur != end && isDigit(*cur)) {
+      ++cur;
+    }
+  }
+  if(cur != end && (*cur == 'e' || *cur == 'E')) {
+    ++cur;
+    if(cur != end && (*cur == '+' || *cur == '-')) {
+      ++cur;
+    }
+    if(cur == end || !isDigit(*cur)) {
+      return nullptr;
+    }
+    while(cur != end && isDigit(*cur)) {
+      ++cur;
+    }
+  }
+  return cur;
+}
+
+bool JsonReader::readNumber(f64 &out) {
+  if(peek() != Number) {
+    return fail("expected a number");
+  }
+  const char *numEnd = numberEnd(mCur, mEnd);
+  if(numEnd == nullptr) {
+    return fail("invalid number");
+  }
+  auto [end, err] = std::from_chars(mCur, numEnd, out);
+  if(err != std::errc{} || end != numEnd) {
+    return fail("invalid number");
+  }
+  mCur = end;
+  mFirst = false;
+  return true;
+}
+
+bool JsonReader::readBool(bool &out) {
+  if(peek() != Bool) {
+    return fail("expected a boolean");
+  }
+  out = *mCur == 't';
+  return out ? literal("true", 4) : literal("false", 5);
+}
+
+bool JsonReader::skipValue() {
+  switch(peek()) {
+  case Object: {
+    if(!beginObject()) {
+      return false;
+    }
+    StringView key;
+    while(nextKey(key)) {
+      if(!skipValue()) {
+        return false;
+      }
+    }
+    return !failed();
+  }
+  case Array:
+    if(!beginArray()) {
+      return false;
+    }
+    while(nextElement()) {
+      if(!skipValue()) {
+        return false;
+      }
+    }
+    return !failed();
+  case String: {
+    StringView str;
+    return readString(str);
+  }
+  case Number: {
+    f64 number;
+    return readNumber(number);
+  }
+  case Bool: {
+    bool value;
+    return readBool(value);
+  }
+  case Null:
+    return literal("null", 4);
+  default:
+    return fail("expected a value");
+  }
+}
+
+bool JsonReader::finish() {
+  if(failed()) {
+    return false;
+  }
+  skipSpace();
+  if(mCur != mEnd) {
+    return fail("unexpected text after the value");
+  }
+  return true;
+}
+
+void JsonReader::skipSpace() {
+  while(mCur != mEnd && (*mCur == ' ' || *mCur == '\n' || *mCur == '\r' || *mCur == '\t')) {
+    ++mCur;
+  }
+}
+
+bool JsonReader::expect(char chr) {
+  skipSpace();
+  if(mCur == mEnd || *mCur != chr) {
+    return fail(chr == ':' ? "expected `:`" : "expected `,`");
+  }
+  ++mCur;
+  return true;
+}
+
+bool JsonReader::fail(const char *message) {
+  if(mError == nullptr) {
+    mError = message;
+  }
+  return false;
+}
+
+bool JsonReader::literal(const char *text, usize size) {
+  if(usize(mEnd - mCur) < size || std::memcmp(mCur, text, size) != 0) {
+    return fail("invalid literal");
+  }
+  mCur += size;
+  mFirst = false;
+  return true;
+}
+
+static s32 hexDigit(char chr) {
+  if(chr >= '0' && chr <= '9') {
+    return chr - '0';
+  }
+  if(chr >= 'a' && chr <= 'f') {
+    return chr - 'a' + 10;
+  }
+  if(chr >= 'A' && chr <= 'F') {
+    return chr - 'A' + 10;
+  }
+  return -1;
+}
+
+static void appendUtf8(LoadString &out, u32 codepoint) {
+  if(codepoint < 0x80) {
+    out.push_back(char(codepoint));
+  } else if(codepoint < 0x800) {
+    out.push_back(char(0xC0 | (codepoint >> 6)));
+    out.push_back(char(0x80 | (codepoint & 0x3F)));
+  } else if(codepoint < 0x10000) {
+    out.push_back(char(0xE0 | (codepoint >> 12)));
+    out.push_back(char(0x80 | ((codepoint >> 6) & 0x3F)));
+    out.push_back(char(0x80 | (codepoint & 0x3F)));
+  } else {
+    out.push_back(char(0xF0 | (codepoint >> 18)));
+    out.push_back(char(0x80 | ((codepoint >> 12) & 0x3F)));
+    out.push_back(char(0x80 | ((codepoint >> 6) & 0x3F)));
+    out.push_back(char(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+bool JsonReader::readEscaped(const char *start, StringView &out) {
+  mScratch.assign(start, mCur);
+  u32 highSurrogate = 0;
+  while(mCur != mEnd) {
+    char chr = *mCur++;
+    if(chr == '"') {
+      if(highSurrogate != 0) {
+        return fail("unpaired surrogate in string");
+      }
+      out = {mScratch.data(), mScratch.size()};
+      mFirst = false;
+      return true;
+    }
+    if(u8(chr) < 0x20) {
+      return fail("control character in string");
+    }
+    if(chr != '\\') {
+      mScratch.push_back(chr);
+      continue;
+    }
+    if(mCur == mEnd) {
+      break;
+    }
+    chr = *mCur++;
+    if(chr != 'u' && highSurrogate != 0) {
+      return fail("unpaired surrogate in string");
+    }
+    switch(chr) {
+    case '"':
+    case '\\':
+    case '/':
+      mScratch.push_back(chr);
+      break;
+    case 'b':
+      mScratch.push_back('\b');
+      break;
+    case 'f':
+      mScratch.push_back('\f');
+      break;
+    case 'n':
+      mScratch.push_back('\n');
+      break;
+    case 'r':
+      mScratch.push_back('\r');
+      break;
+    case 't':
+      mScratch.push_back('\t');
+      break;
+    case 'u': {
+      if(mEnd - mCur < 4) {
+        return fail("unterminated string");
+      }
+      u32 unit = 0;
+      for(s32 i = 0; i < 4; ++i) {
+        s32 digit = hexDigit(*mCur++);
+        if(digit < 0) {
+          return fail("invalid unicode escape");
+        }
+        unit = (unit << 4) | u32(digit);
+      }
+      if(unit >= 0xD800 && unit < 0xDC00) {
+        if(highSurrogate != 0) {
+          return fail("unpaired surrogate in string");
+        }
+        highSurrogate = unit;
+        // the low half has to follow right away
+        if(mEnd - mCur < 2 || mCur[0] != '\\' || mCur[1] != 'u') {
+          return fail("unpaired surrogate in string");
+        }
+      } else if(unit >= 0xDC00 && unit < 0xE000) {
+        if(highSurrogate == 0) {
+          return fail("unpaired surrogate in string");
+        }
+        appendUtf8(mScratch, 0x10000 + ((highSurrogate - 0xD800) << 10) + (unit - 0xDC00));
+        highSurrogate = 0;
+      } else {
+        if(highSurrogate != 0) {
+          return fail("unpaired surrogate in string");
+        }
+        appendUtf8(mScratch, unit);
+      }
+      break;
+    }
+    default:
+      return fail("invalid escape in string");
+    }
+  }
+  return fail("unterminated string");
+}
+
+} // namespace sbs
@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+JsonReader.hpp
+--------------
+Pull parser which walks JSON text without building a tree
+*/
+
+#include "arena.hpp"
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+
+namespace sbs {
+
+/* Reads values one at a time, in document order. Objects are walked with
+   beginObject() and nextKey(), arrays with beginArray() and nextElement().
+   Once any call fails, every later call fails too and error() says why. */
+class JsonReader {
+public:
+  enum Kind: u8 {
+    Invalid,
+    Object,
+    Array,
+    String,
+    Number,
+    Bool,
+    Null,
+  };
+
+  JsonReader(nwge::StringView text);
+
+  /* Kind of the next value, without consuming it. */
+  Kind peek();
+
+  bool beginObject();
+
+  /* Reads the next key of the current object and the colon after it. Returns
+     false at the end of the object or on error. */
+  bool nextKey(nwge::StringView &key);
+
+  bool beginArray();
+
+  /* Returns true if the current array has another element to read. */
+  bool nextElement();
+
+  /* The view points into the text, or into the reader if the string had
+     escapes, in which case it is only valid until the next read. */
+  bool readString(nwge::StringView &out);
+  bool readNumber(f64 &out);
+  bool readBool(bool &out);
+
+  /* Skips over the next value, however deeply nested. */
+  bool skipValue();
+
+  /* Checks that nothing but whitespace follows the last value. */
+  bool finish();
+
+  [[nodiscard]] inline bool failed() const {
+    return mError != nullptr;
+  }
+
+  [[nodiscard]] inline const char *error() const {
+    return mError != nullptr ? mError : "no error";
+  }
+
+  /* Whether `str` points into the text, rather than into the reader, in which
+     case it stays valid after the next read. */
+  [[nodiscard]] inline bool inText(nwge::StringView str) const {
+    return str.begin() >= mBegin && str.begin() + str.size() <= mEnd;
+  }
+
+  /* byte offset of the error, or of the next value */
+  [[nodiscard]] inline usize offset() const {
+    return mCur - mBegin;
+  }
+
+private:
+  static constexpr s32 cMaxDepth = 64;
+
+  const char *mBegin;
+  const char *mCur;
+  const char *mEnd;
+  const char *mError = nullptr;
+  /* whether the current container has not had a value yet */
+  bool mFirst = false;
+  s32 mDepth = 0;
+  /* unescaped strings, in the load arena while a load is running */
+  LoadString mScratch;
+
+  void skipSpace();
+  bool expect(char chr);
+  bool fail(const char *message);
+  bool literal(const char *text, usize size);
+  bool readEscaped(const char *start, nwge::StringView &out);
+};
+
+} // namespace sbs
@@ -0,0 +1,112 @@
+#include "MappedFile.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <nwge/console.hpp>
+
+#if __has_include(<sys/mman.h>)
+#define SBS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace nwge;
+
+namespace sbs {
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+#ifdef SBS_MMAP
+
+bool MappedFile::open(const char *path, usize minSize, bool sequential) {
+  close();
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    return false;
+  }
+  struct stat info{};
+  if(fstat(fd, &info) != 0 || info.st_size == 0 || usize(info.st_size) < minSize) {
+    ::close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, usize(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file referenced
+  ::close(fd);
+  if(map == MAP_FAILED) {
+    console::error("Could not map {}: {}", path, std::strerror(errno));
+    return false;
+  }
+  if(sequential) {
+    madvise(map, usize(info.st_size), MADV_SEQUENTIAL);
+  }
+
+  mData = static_cast<const char*>(map);
+  mSize = usize(info.st_size);
+  mMapped = true;
+  return true;
+}
+
+#else
+
+bool MappedFile::open(const char *path, usize minSize, [[maybe_unused]] bool sequential) {
+  close();
+  std::FILE *file = std::fopen(path, "rb");
+  if(file == nullptr) {
+    return false;
+  }
+  std::fseek(file, 0, SEEK_END);
+  long size = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+  if(size <= 0 || usize(size) < minSize) {
+    std::fclose(file);
+    return false;
+  }
+  auto data = std::make_unique<char[]>(usize(size));
+  bool read = std::fread(data.get(), 1, usize(size), file) == usize(size);
+  std::fclose(file);
+  if(!read) {
+    console::error("Could not read {}: {}", path, std::strerror(errno));
+    return false;
+  }
+  mData = data.release();
+  mSize = usize(size);
+  return true;
+}
+
+#endif
+
+void MappedFile::close() {
+  if(mData == nullptr) {
+    return;
+  }
+#ifdef SBS_MMAP
+  if(mMapped) {
+    munmap(const_cast<char*>(mData), mSize);
+  }
+#endif
+  if(!mMapped) {
+    delete[] mData;
+  }
+  mData = nullptr;
+  mSize = 0;
+  mMapped = false;
+}
+
+void MappedFile::willNeed([[maybe_unused]] usize offset, [[maybe_unused]] usize size) const {
+#ifdef SBS_MMAP
+  if(!mMapped || size == 0) {
+    return;
+  }
+  static const auto sPageSize = usize(sysconf(_SC_PAGESIZE));
+  auto alignedStart = offset - offset % sPageSize;
+  madvise(const_cast<char*>(mData) + alignedStart, offset + size - alignedStart,
+    MADV_WILLNEED);
+#endif
+}
+
+} // namespace sbs
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+MappedFile.hpp
+--------------
+Read-only file mapping
+*/
+
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* A whole file mapped read-only. Where there is no mmap(), the file is read
+   into memory instead. */
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) = delete;
+  MappedFile &operator=(const MappedFile&) = delete;
+  MappedFile &operator=(MappedFile&&) = delete;
+  ~MappedFile();
+
+  /* Maps the file at `path`, replacing whatever was mapped. Returns false if
+     it is missing, shorter than `minSize` bytes or cannot be mapped; only the
+     latter is printed. `sequential` tells the kernel the file is read front
+     to back. */
+  bool open(const char *path, usize minSize, bool sequential);
+  void close();
+
+  [[nodiscard]] inline bool present() const {
+    return mData != nullptr;
+  }
+
+  [[nodiscard]] inline const char *data() const {
+    return mData;
+  }
+
+  [[nodiscard]] inline usize size() const {
+    return mSize;
+  }
+
+  /* Asks the kernel to start reading in `size` bytes at `offset`, which are
+     about to be used. */
+  void willNeed(usize offset, usize size) const;
+
+private:
+  const char *mData = nullptr;
+  usize mSize = 0;
+  bool mMapped = false;
+};
+
+} // namespace sbs
@@ -1,10 +1,20 @@
+#include "AssetCache.hpp"
+#include "adpcm.hpp"
+#include "blob.hpp"
+#include "compress.hpp"
+#include "memory.hpp"
+#include "reviews.hpp"
+#include "saves.hpp"
 #include "save.hpp"
 #include "version.h"
+#include "startup.hpp"
 #include "states.hpp"
 #include "minigames.hpp"
 #include <array>
+#include <ctime>
+#include <fstream>
+#include <string>
 #include <nwge/console/Command.hpp>
-#include <nwge/data/bundle.hpp>
 #include <nwge/data/store.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/AspectRatio.hpp>
@@ -13,6 +23,7 @@
 #include <nwge/render/mat.hpp>
 #include <nwge/render/window.hpp>
 #include <nwge/time.hpp>
+#include <boost/lexical_cast.hpp>
 #include <random>
 
 using namespace nwge;
@@ -21,11 +32,13 @@ namespace sbs {
 
 class MenuState: public State {
 private:
-  data::Bundle mBundle{"sbs"_sv};
-  render::AnimatedTexture mLogo;
+  CachedBundle mBundle;
+  AssetHandle<render::AnimatedTexture> mLogo;
 
   f32 mFadeIn = 0.0f;
   f32 mFadeOut = -1.0f;
+  /* set once the assets went to the next state */
+  bool mHandedOff = false;
   static constexpr f32
     cVignetteZ = 0.409f,
     cFadeZ = 0.1f,
@@ -64,7 +77,7 @@ class MenuState: public State {
   static constexpr glm::vec3
     cBrickColor{0.667f, 0.29f, 0.267f};
 
-  render::Texture mBrickTexture;
+  AssetHandle<render::Texture> mBrickTexture;
 
   struct Brick {
     glm::vec3 pos;
@@ -145,7 +158,7 @@ class MenuState: public State {
     }
   }
 
-  render::Font mFont;
+  AssetHandle<render::Font> mFont;
 
   static constexpr f32
     cTextZ = 0.4f,
@@ -167,60 +180,10 @@ class MenuState: public State {
     cHoverTextColor{1, 1, 1, 1};
 
   struct ReviewManager {
-    Array<String<>> reviews;
+    AssetHandle<Reviews> reviews;
 
-    bool load(data::RW &file) {
-      ScratchArray<char> data{usize(file.size())};
-      if(!file.read(data.view())) {
-        dialog::error("Error", "Could not load reviews: I/O error");
-        return false;
-      }
-      auto res = json::parse(data.view());
-      if(res.error != json::OK) {
-        dialog::error("Error", "Could not load reviews: Invalid JSON ({})",
-          json::errorMessage(res.error));
-        return false;
-      }
-      if(!res.value->isArray()) {
-        dialog::error("Error", "Could not load reviews: Not an array");
-        return false;
-      }
-
-      auto array = res.value->array();
-      reviews = {array.size()};
-      for(usize i = 0; i < reviews.size(); ++i) {
-        const auto &value = array[i];
-        if(!value.isObject()) {
-          dialog::error("Error", "Could not load review {}: Not an object",
-            i);
-          return false;
-        }
-        const auto &object = value.object();
-        const auto *personV = object.get("person");
-        if(personV == nullptr || !personV->isString()) {
-          dialog::error("Error", "Could not load review {}: Invalid `person`",
-            i);
-          return false;
-        }
-        const auto *quoteV = object.get("quote");
-        if(quoteV == nullptr || !quoteV->isString()) {
-          dialog::error("Error", "Could not load review {}: Invalid `quote`",
-            i);
-          return false;
-        }
-        const auto *ratingV = object.get("rating");
-        if(ratingV == nullptr || !ratingV->isNumber()) {
-          dialog::error("Error", "Could not load review {}: Invalid `rating`",
-            i);
-          return false;
-        }
-        reviews[i] = String<>::formatted("\"{} {}/10\"\n   ~ {}",
-          quoteV->string(), ratingV->number(), personV->string());
-      }
-
-      console::note("Loaded {} reviews.", reviews.size());
-      reviewIdxDis = std::uniform_int_distribution<usize>{0, reviews.size() - 1};
-      return true;
+    void setup() {
+      reviewIdxDis = std::uniform_int_distribution<usize>{0, reviews->entries.size() - 1};
     }
 
     static constexpr s32 cInstanceCount = 10;
@@ -262,7 +225,7 @@ class MenuState: public State {
         }
         if(reviewManager != nullptr) {
           auto idx = reviewManager->reviewIdxDis(sEng);
-          text = reviewManager->reviews[idx];
+          text = reviewManager->reviews->entries[idx];
         }
       }
 
@@ -313,7 +276,7 @@ class MenuState: public State {
     }
   } mReviewManager;
 
-  render::Texture mVignetteTexture;
+  AssetHandle<render::Texture> mVignetteTexture;
 
   Music mMusic;
 
@@ -321,6 +284,7 @@ class MenuState: public State {
     BNone = -1,
     BShit,
     BExtras,
+    BSlot,
     BMax,
   };
 
@@ -339,7 +303,7 @@ class MenuState: public State {
     if(pos.x < cButtonX || pos.x > cButtonX + cButtonW) {
       return BNone;
     }
-    if(pos.y < cButtonY || pos.y > cButtonY + 2*cButtonH) {
+    if(pos.y < cButtonY || pos.y > cButtonY + f32(BMax)*cButtonH) {
       return BNone;
     }
     auto button = Button((pos.y - cButtonY) / cButtonH);
@@ -375,13 +339,56 @@ class MenuState: public State {
     } else {
       render::color(cButtonTextClr);
     }
-    auto measure = mFont.measure(name, cButtonTextH);
+    auto measure = mFont->measure(name, cButtonTextH);
     f32 textX = (cButtonW - measure.x) / 2;
-    mFont.draw(name, {baseX + textX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
+    mFont->draw(name, {baseX + textX, baseY + cButtonTextY, cTextZ}, cButtonTextH);
   }
 
-  Config mConfig;
+  static constexpr f32
+    cSlotInfoH = 0.025f,
+    cSlotInfoY = cButtonY + f32(BMax)*cButtonH + 0.01f;
+
+  /* only the index, the slots themselves are read once one is played */
+  saves::SlotIndex mSlots{};
+  usize mSlot = 0;
+  ScratchString mSlotName;
+  ScratchString mSlotInfo;
+
+  [[nodiscard]] const saves::SlotInfo &slot() const {
+    return mSlots[mSlot];
+  }
+
+  void refreshSlot() {
+    mSlots = saves::slots();
+    mSlot = saves::currentSlot();
+    mSlotName = ScratchString::formatted("Slot {}", mSlot + 1);
+    if(slot().used == 0) {
+      mSlotInfo = ScratchString::formatted("Empty");
+      return;
+    }
+    char date[16] = "";
+    std::time_t lastPlayed = slot().lastPlayed;
+    std::tm local{};
+#ifdef _WIN32
+    bool converted = localtime_s(&local, &lastPlayed) == 0;
+#else
+    bool converted = localtime_r(&lastPlayed, &local) != nullptr;
+#endif
+    if(converted) {
+      std::strftime(date, sizeof(date), "%Y-%m-%d", &local);
+    }
+    mSlotInfo = ScratchString::formatted("Score {}, prestige {}, played {}",
+      slot().score, slot().prestige, static_cast<const char*>(date));
+  }
+
+  void nextSlot() {
+    saves::selectSlot((mSlot + 1) % saves::cSlotCount);
+    refreshSlot();
+  }
+
+  ConfigPtr mConfig;
   data::Store mStore;
+  /* only for the saves from before there were slots */
   Savefile mSave;
 
   static constexpr s32 cSocialButtonCount = 2;
@@ -394,7 +401,7 @@ class MenuState: public State {
     cSocialButtonTexUnit = 1.0f / cSocialButtonCount,
     cSocialButtonZ = cTextZ;
 
-  render::Texture mSocialsTexture;
+  AssetHandle<render::Texture> mSocialsTexture;
 
   void renderSocialButton(s32 buttonNo) const {
     f32 buttonX = cSocialButtonX + f32(buttonNo) * cSocialButtonStride;
@@ -402,7 +409,7 @@ class MenuState: public State {
     render::rect(
       {buttonX, cSocialButtonY, cSocialButtonZ},
       {cSocialButtonW, cSocialButtonH},
-      mSocialsTexture,
+      *mSocialsTexture,
       {{texX, 0}, {cSocialButtonTexUnit, 1}});
   }
 
@@ -421,10 +428,10 @@ class MenuState: public State {
     }
     switch(button) {
     case 0:
-      dialog::openURL(mConfig.socials.xDotCom);
+      dialog::openURL(mConfig->socials.xDotCom);
       break;
     case 1:
-      dialog::openURL(mConfig.socials.discord);
+      dialog::openURL(mConfig->socials.discord);
       break;
     default:
       break;
@@ -435,6 +442,80 @@ class MenuState: public State {
     swapStatePtr(getMiniGameState(MiniGame::test(), MiniGame::ReturnToMenu));
   }};
 
+  console::Command mAssetBudgetCommand{"sbs.assetBudget", [](auto &args){
+    auto &cache = assetCache();
+    if(args.size() == 1) {
+      try {
+        cache.setBudget(boost::lexical_cast<usize>(args[0].begin(), args[0].size()));
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
+      }
+    }
+    console::print("asset cache: {}/{} bytes", cache.total(), cache.budget());
+  }};
+
+  /* Parses `<path> [iterations]` and runs `benchmark` on the file's text. */
+  template<typename Args>
+  static void runBenchmark(const Args &args, const char *usage, void (*benchmark)(StringView, usize)) {
+    if(args.size() == 0 || args.size() > 2) {
+      console::error("usage: {}", usage);
+      return;
+    }
+    usize iterations = 1000;
+    if(args.size() == 2) {
+      try {
+        iterations = boost::lexical_cast<usize>(args[1].begin(), args[1].size());
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[1]);
+        return;
+      }
+    }
+    std::ifstream file{std::string{args[0].begin(), args[0].size()}, std::ios::binary};
+    if(!file) {
+      console::error("could not open {}", args[0]);
+      return;
+    }
+    std::string raw{std::istreambuf_iterator<char>{file}, {}};
+    benchmark({raw.data(), raw.size()}, iterations);
+  }
+
+  console::Command mBenchConfigCommand{"sbs.benchConfig", [](auto &args){
+    runBenchmark(args, "sbs.benchConfig <path to cfg.json> [iterations]", benchmarkConfig);
+  }};
+
+  console::Command mBenchReviewsCommand{"sbs.benchReviews", [](auto &args){
+    runBenchmark(args, "sbs.benchReviews <path to reviews.json> [iterations]", benchmarkReviews);
+  }};
+
+  console::Command mBenchSaveCommand{"sbs.benchSave", [](auto &args){
+    usize iterations = 100000;
+    if(args.size() == 1) {
+      try {
+        iterations = boost::lexical_cast<usize>(args[0].begin(), args[0].size());
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
+        return;
+      }
+    }
+    benchmarkSave(iterations);
+  }};
+
+  /* Round-trips the binary formats and codecs, and feeds them damaged data.
+     The save writer's checks work in a directory of their own. */
+  console::Command mCheckCommand{"sbs.check", [](auto &){
+    console::print("Checking the binary formats:");
+    bool ok = blob::check();
+    ok = compress::check() && ok;
+    ok = adpcm::check() && ok;
+    ok = checkSave() && ok;
+    ok = saves::check() && ok;
+    if(ok) {
+      console::print("All checks passed.");
+    } else {
+      console::error("Some checks failed.");
+    }
+  }};
+
 public:
   MenuState(Music &&music)
     : mMusic(std::move(music))
@@ -445,21 +526,38 @@ class MenuState: public State {
       .nqCustom("sbs2024.gif"_sv, mLogo)
       .nqTexture("brick.png"_sv, mBrickTexture)
       .nqFont("GrapeSoda.cfn"_sv, mFont)
-      .nqCustom("reviews.json"_sv, mReviewManager)
       .nqTexture("vignette.png"_sv, mVignetteTexture)
       .nqTexture("socials.png"_sv, mSocialsTexture)
-      .nqCustom("cfg.json"_sv, mConfig);
-    mStore.nqLoad("progress"_sv, mSave.v1);
-    mStore.nqLoad("save.json"_sv, mSave.v2);
+      .nqConfig()
+      .nqCompiled("reviews.json"_sv, "reviews.bin"_sv, blob::Reviews, mReviewManager.reviews);
+    saves::prefetch();
+    if(saves::migrationPending()) {
+      mStore.nqLoad("progress"_sv, mSave.v1);
+      mStore.nqLoad("save.json"_sv, mSave.v2);
+    }
     return true;
   }
 
   bool init() override {
+    reportStartup();
+    if(!mBundle.wait()) {
+      return false;
+    }
+    reportPeakMemory("until the menu");
+    mConfig = sharedConfig();
     populateBricks();
+    mReviewManager.setup();
     mReviewManager.populateInstances();
-    mStore.nqSave("save.json", mSave);
-    if(mSave.v1.loaded) {
-      mStore.nqDelete("progress"_sv);
+    refreshSlot();
+    if(mSlot == 0 && slot().used == 0 && (mSave.v1.loaded || mSave.v2.loaded)) {
+      saves::load(mSave);
+      // saving may drop the old save, so remember where it came from
+      bool fromProgress = mSave.v1.loaded;
+      saves::nq(mSave);
+      if(fromProgress) {
+        mStore.nqDelete("progress"_sv);
+      }
+      refreshSlot();
     }
     return true;
   }
@@ -480,10 +578,15 @@ class MenuState: public State {
         checkSocialButtonClick(evt.click.pos);
         break;
       }
+      if(hover == BSlot) {
+        nextSlot();
+        break;
+      }
       mHover = mSelection = hover;
       if(hover == BShit
-      ||(hover == BExtras && mSave.v2.prestige >= 1)) {
+      ||(hover == BExtras && slot().prestige >= 1)) {
         mFadeOut = 0.0f;
+        mBundle.beginHandOff(&nextManifest());
         break;
       }
       break;
@@ -493,7 +596,22 @@ class MenuState: public State {
     return true;
   }
 
+  [[nodiscard]] const AssetManifest &nextManifest() const {
+    return mSelection == BExtras ? gExtrasManifest : gShitManifest;
+  }
+
+  /* The fade is over, so nothing of the menu is drawn any more. */
+  void handOff() {
+    reportPeakMemory("in the menu");
+    mBundle.handOff(&nextManifest());
+    mHandedOff = true;
+  }
+
   bool tick(f32 delta) override {
+    if(mHandedOff) {
+      return true;
+    }
+    saves::report();
     updateBricks(delta);
     mReviewManager.updateInstances(delta);
 
@@ -514,8 +632,10 @@ class MenuState: public State {
           return false;
         }
         if(mSelection == BShit) {
+          handOff();
           swapStatePtr(getShitState(std::move(mMusic)));
         } else if(mSelection == BExtras) {
+          handOff();
           swapStatePtr(getExtrasState(std::move(mMusic)));
         }
       }
@@ -526,30 +646,37 @@ class MenuState: public State {
 
   void render() const override {
     render::clear({0, 0, 0});
+    if(mHandedOff) {
+      return;
+    }
 
     render::color();
-    render::rect(m1x1.pos(cLogoPos), m1x1.size(cLogoSize), mLogo);
+    render::rect(m1x1.pos(cLogoPos), m1x1.size(cLogoSize), *mLogo);
 
-    renderBricks(mBrickTexture, m1x1);
-    mReviewManager.renderInstances(mFont);
+    renderBricks(*mBrickTexture, m1x1);
+    mReviewManager.renderInstances(*mFont);
 
     renderButton("Shit", BShit);
-    if(mSave.v2.prestige >= 1) {
+    if(slot().prestige >= 1) {
       renderButton("Extras", BExtras);
     }
+    renderButton(mSlotName, BSlot);
+    render::color(cButtonTextClr);
+    auto infoMeasure = mFont->measure(mSlotInfo, cSlotInfoH);
+    mFont->draw(mSlotInfo, {(1.0f - infoMeasure.x) / 2, cSlotInfoY, cTextZ}, cSlotInfoH);
 
     render::color();
-    render::rect({0, 0, cVignetteZ}, {1, 1}, mVignetteTexture);
+    render::rect({0, 0, cVignetteZ}, {1, 1}, *mVignetteTexture);
 
     // render::color({1, 0, 0});
-    // mFont.draw("If you leak this build we will leak your internal organs",
+    // mFont->draw("If you leak this build we will leak your internal organs",
     //  {cCopyrightX, cCopyrightY - 2*cCopyrightH, cCopyrightZ}, cCopyrightH);
     render::color();
-    mFont.draw("Copyright (c) Nwge Game Studio 2024",
+    mFont->draw("Copyright (c) Nwge Game Studio 2024",
       {cCopyrightX, cCopyrightY, cCopyrightZ}, cCopyrightH);
-    auto measure = mFont.measure(SBS_VER_STR, cVerH);
+    auto measure = mFont->measure(SBS_VER_STR, cVerH);
     auto textX = cVerX - measure.x;
-    mFont.draw(SBS_VER_STR, {textX, cVerY, cVerZ}, cVerH);
+    mFont->draw(SBS_VER_STR, {textX, cVerY, cVerZ}, cVerH);
 
     #pragma unroll
     for(s32 i = 0; i < cSocialButtonCount; ++i) {
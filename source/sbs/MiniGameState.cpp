@@ -1,9 +1,9 @@
+#include "AssetCache.hpp"
 #include "minigames.hpp"
 #include "states.hpp"
 #include <memory>
 #include <nwge/bind.hpp>
 #include <nwge/console/Command.hpp>
-#include <nwge/data/bundle.hpp>
 #include <nwge/render/window.hpp>
 #include <nwge/render/draw.hpp>
 
@@ -18,8 +18,7 @@ class MiniGameState: public State {
   {}
 
   bool preload() override {
-    mBundle
-      .load({"sbs.bndl"})
+    mBundle.raw()
       .nqFont("Symtext.cfn", mMiniGameData.font);
     return true;
   }
@@ -74,7 +73,7 @@ class MiniGameState: public State {
   }
 
 private:
-  data::Bundle mBundle;
+  CachedBundle mBundle;
 
   static constexpr f32
     cBarStride = 1.0f / MiniGame::Data::cFakeResolution,
@@ -1,26 +1,36 @@
 #include "Music.hpp"
+#include "data.hpp"
+#include <nwge/audio/Sound.hpp>
 
 using namespace nwge;
 
 namespace sbs {
 
-void Music::nq(data::Bundle &bundle) {
+void Music::nq(data::Bundle &bundle, StringView name) {
   buffer.label("music buffer");
   source.label("music source");
-  bundle.nqCustom("GROOVY.WAV"_sv, *this);
+  bundle.nqCustom(name, *this);
 }
 
 bool Music::load(data::RW &file) {
-  if(!sound.load(file)) {
+  // only needed until the samples are in the engine's buffer
+  audio::Sound sound;
+  bool decoded = loadUnpacked(file, [&sound](data::RW &unpacked){
+    return sound.load(unpacked);
+  });
+  if(!decoded) {
     return false;
   }
   buffer.upload(sound);
   source.buffer(buffer);
+  loaded = true;
   return true;
 }
 
 void Music::play() {
-  source.play();
+  if(loaded) {
+    source.play();
+  }
 }
 
 } // namespace sbs
@@ -6,14 +6,19 @@
 
 namespace sbs {
 
+/* A music track, played through the engine like any other sound. It is read
+   from the bundle, where it may be packed, and only the engine's buffer is
+   kept once it has been uploaded. The whole track is decoded during the load,
+   since an engine source plays one whole buffer and cannot be fed a stream. */
 struct Music {
-  nwge::audio::Sound sound;
   nwge::audio::Buffer buffer;
   nwge::audio::Source source;
+  bool loaded = false;
 
-  void nq(nwge::data::Bundle &bundle);
+  void nq(nwge::data::Bundle &bundle, nwge::StringView name);
   bool load(nwge::data::RW &file);
+  /* Does nothing if no track was loaded. */
   void play();
 };
 
-}
\ No newline at end of file
+}
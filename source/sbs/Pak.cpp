@@ -0,0 +1,100 @@
+#include "Pak.hpp"
+#include "blob.hpp"
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <nwge/console.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+const Pak &Pak::shared() {
+  // intentionally leaked, parsed assets may point into the mapping
+  static auto *sPak = new Pak("sbs.pak", "sbs.bndl");
+  return *sPak;
+}
+
+Pak::Pak(const char *path, const char *bundle) {
+  // entries are parsed front to back, right after being found
+  if(!mFile.open(path, sizeof(Header), true)) {
+    return;
+  }
+  if(!index()) {
+    console::error("{} is damaged, using the bundle instead.", path);
+    close();
+  } else if(!matches(bundle)) {
+    console::note("{} was written for a different {}, using the bundle instead.",
+      path, bundle);
+    close();
+  }
+}
+
+void Pak::close() {
+  mFile.close();
+  mEntries.clear();
+}
+
+bool Pak::index() {
+  const char *data = mFile.data();
+  usize size = mFile.size();
+  Header header{};
+  std::memcpy(&header, data, sizeof(Header));
+  if(std::memcmp(header.magic, cMagic, sizeof(cMagic)) != 0
+  || header.version != cVersion
+  || header.count > (size - sizeof(Header)) / sizeof(DirEntry)) {
+    return false;
+  }
+
+  mEntries.reserve(header.count);
+  for(u32 i = 0; i < header.count; ++i) {
+    DirEntry dir{};
+    std::memcpy(&dir, data + sizeof(Header) + i * sizeof(DirEntry), sizeof(DirEntry));
+    if(dir.nameOffset > size || dir.nameSize > size - dir.nameOffset
+    || dir.dataOffset > size || dir.dataSize > size - dir.dataOffset) {
+      return false;
+    }
+    mEntries.push_back({
+      {data + dir.nameOffset, dir.nameSize},
+      {data + dir.dataOffset, dir.dataSize},
+    });
+  }
+  return true;
+}
+
+/* Checks the pak's stamp against the whole bundle. Unlike a size or a
+   modification time, the checksum survives copying and installing the game,
+   and catches a bundle rebuilt to the same size. The engine reads most of the
+   bundle right after, so this mostly warms the page cache for it. */
+bool Pak::matches(const char *bundle) const {
+  Header header{};
+  std::memcpy(&header, mFile.data(), sizeof(Header));
+  std::FILE *file = std::fopen(bundle, "rb");
+  if(file == nullptr) {
+    return false;
+  }
+  std::array<char, 64 * 1024> chunk;
+  u64 size = 0;
+  u32 crc = 0;
+  usize got;
+  while((got = std::fread(chunk.data(), 1, chunk.size(), file)) != 0) {
+    crc = blob::crc32(chunk.data(), got, crc);
+    size += got;
+  }
+  bool failed = std::ferror(file) != 0;
+  std::fclose(file);
+  return !failed && size == header.bundleSize && crc == header.bundleCrc;
+}
+
+std::optional<StringView> Pak::find(std::string_view name) const {
+  for(const auto &entry: mEntries) {
+    if(entry.name != name) {
+      continue;
+    }
+    mFile.willNeed(usize(entry.data.begin() - mFile.data()), entry.data.size());
+    return entry.data;
+  }
+  return {};
+}
+
+} // namespace sbs
@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+Pak.hpp
+-------
+Memory-mapped pack of the data files the game parses itself
+*/
+
+#include "MappedFile.hpp"
+#include <optional>
+#include <string_view>
+#include <vector>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+
+namespace sbs {
+
+/* The bundle step (see source/bndl/plug.py) writes sbs.pak next to sbs.bndl. It
+   holds the JSON data files and the blobs compiled from them, uncompressed, so
+   they can be parsed straight out of the mapping. The bundle keeps its own
+   copies, which are used if there is no pak, or if it was written for another
+   bundle than the one next to it.
+
+   Layout, little-endian: a Header, `count` DirEntries, then the names and the
+   data, which DirEntries point at by offset from the start of the file. */
+class Pak {
+public:
+  static constexpr char cMagic[4] = {'S', 'B', 'S', 'P'};
+  static constexpr u16 cVersion = 2;
+
+  struct Header {
+    char magic[4];
+    u16 version;
+    u16 reserved;
+    u32 count;
+    u32 bundleCrc;  // CRC32 of the bundle the pak was written with
+    u64 bundleSize; // and its size
+  };
+  static_assert(sizeof(Header) == 24);
+
+  struct DirEntry {
+    u32 nameOffset;
+    u32 nameSize;
+    u32 dataOffset;
+    u32 dataSize;
+  };
+  static_assert(sizeof(DirEntry) == 16);
+
+  /* sbs.pak, mapped on first use. Never unmapped, so views into it stay valid
+     for the rest of the process. */
+  static const Pak &shared();
+
+  /* Maps the pak at `path`. If it is missing, damaged or was not written with
+     the bundle at `bundle`, the pak is empty. */
+  Pak(const char *path, const char *bundle);
+
+  Pak(const Pak&) = delete;
+  Pak(Pak&&) = delete;
+  Pak &operator=(const Pak&) = delete;
+  Pak &operator=(Pak&&) = delete;
+
+  [[nodiscard]] inline bool present() const {
+    return mFile.present();
+  }
+
+  /* The entry's bytes in the mapping. Asks the kernel to start reading them in,
+     since the caller is about to parse them. */
+  [[nodiscard]] std::optional<nwge::StringView> find(std::string_view name) const;
+
+private:
+  struct Entry {
+    std::string_view name;
+    nwge::StringView data;
+  };
+
+  MappedFile mFile;
+  std::vector<Entry> mEntries;
+
+  void close();
+  bool index();
+  bool matches(const char *bundle) const;
+};
+
+} // namespace sbs
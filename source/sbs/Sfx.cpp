@@ -0,0 +1,240 @@
+#include "Sfx.hpp"
+#include "arena.hpp"
+#include "bench.hpp"
+#include "data.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <nwge/console.hpp>
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_rwops.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+namespace {
+
+struct WavInfo {
+  u16 format = 0;
+  u16 channels = 0;
+  u32 rate = 0;
+  u16 bits = 0;
+  const char *data = nullptr;
+  usize size = 0;
+};
+
+} // namespace
+
+static u16 readLE16(const char *ptr) {
+  return u16(u8(ptr[0]) | (u8(ptr[1]) << 8));
+}
+
+static u32 readLE32(const char *ptr) {
+  return u32(readLE16(ptr)) | (u32(readLE16(ptr + 2)) << 16);
+}
+
+/* Finds the format and sample data of a WAV file in memory. */
+static bool parseWav(const char *bytes, usize size, WavInfo &info) {
+  if(size < 12 || std::memcmp(bytes, "RIFF", 4) != 0
+  || std::memcmp(bytes + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool hasFormat = false;
+  usize pos = 12;
+  while(pos + 8 <= size) {
+    const char *id = bytes + pos;
+    usize chunkSize = std::min<usize>(readLE32(bytes + pos + 4), size - pos - 8);
+    const char *chunk = bytes + pos + 8;
+    if(std::memcmp(id, "fmt ", 4) == 0 && chunkSize >= 16) {
+      info.format = readLE16(chunk);
+      info.channels = readLE16(chunk + 2);
+      info.rate = readLE32(chunk + 4);
+      info.bits = readLE16(chunk + 14);
+      hasFormat = true;
+    } else if(std::memcmp(id, "data", 4) == 0) {
+      info.data = chunk;
+      info.size = chunkSize;
+      return hasFormat;
+    }
+    // chunks are padded to an even size
+    pos += 8 + chunkSize + (chunkSize & 1);
+  }
+  return false;
+}
+
+bool Sfx::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> raw;
+  if(!readAll(file, raw)) {
+    console::error("Could not read sound effect: {}", SDL_GetError());
+    return false;
+  }
+  WavInfo info;
+  if(!parseWav(raw.data(), raw.size(), info)
+  || info.format != 1 // PCM
+  || info.bits != 16
+  || info.channels == 0 || info.channels > 2
+  || info.rate == 0) {
+    console::error("Sound effect is not a 16-bit mono or stereo PCM WAV file.");
+    return false;
+  }
+
+  usize frames = info.size / (2 * info.channels);
+  LoadVector<s16> pcm(frames);
+  for(usize i = 0; i < frames; ++i) {
+    const char *frame = info.data + i * 2 * info.channels;
+    s32 sum = 0;
+    for(usize channel = 0; channel < info.channels; ++channel) {
+      sum += s16(readLE16(frame + channel * 2));
+    }
+    pcm[i] = s16(sum / info.channels);
+  }
+  if(frames > cMaxSfxSamples) {
+    console::error("Sound effect is longer than {} samples.", cMaxSfxSamples);
+    return false;
+  }
+  rate = info.rate;
+  samples = frames;
+  if(samples == 0) {
+    blocks.clear();
+    return true;
+  }
+  adpcm::encode(pcm.data(), pcm.size(), blocks);
+  return true;
+}
+
+static void writeLE16(char *ptr, u16 value) {
+  ptr[0] = char(value & 0xFF);
+  ptr[1] = char(value >> 8);
+}
+
+static void writeLE32(char *ptr, u32 value) {
+  writeLE16(ptr, u16(value & 0xFFFF));
+  writeLE16(ptr + 2, u16(value >> 16));
+}
+
+static constexpr usize cWavHeaderSize = 44;
+
+/* Decodes the sound into `out` as a mono 16-bit WAV file, which is what the
+   engine loads sounds from. The samples are decoded right into its data
+   chunk. */
+static void decodeWav(const Sfx &sfx, std::vector<s16> &out) {
+  static constexpr usize cHeaderSamples = cWavHeaderSize / sizeof(s16);
+  usize count = sfx.blockCount();
+  out.resize(cHeaderSamples + count * adpcm::cBlockSamples);
+  s16 *pcm = out.data() + cHeaderSamples;
+  usize block = 0;
+  for(; block + adpcm::cLanes <= count; block += adpcm::cLanes) {
+    adpcm::decodeBlocks(sfx.blocks.data() + block * adpcm::cBlockSize,
+      pcm + block * adpcm::cBlockSamples);
+  }
+  for(; block < count; ++block) {
+    adpcm::decodeBlock(sfx.blocks.data() + block * adpcm::cBlockSize,
+      pcm + block * adpcm::cBlockSamples);
+  }
+  if constexpr(std::endian::native == std::endian::big) {
+    for(usize i = 0; i < sfx.samples; ++i) {
+      auto sample = u16(pcm[i]);
+      pcm[i] = s16(u16((sample >> 8) | (sample << 8)));
+    }
+  }
+
+  // the last block is padded
+  u32 dataSize = u32(sfx.samples * 2);
+  char *header = reinterpret_cast<char*>(out.data());
+  std::memcpy(header, "RIFF", 4);
+  writeLE32(header + 4, u32(cWavHeaderSize - 8 + dataSize));
+  std::memcpy(header + 8, "WAVEfmt ", 8);
+  writeLE32(header + 16, 16);
+  writeLE16(header + 20, 1); // PCM
+  writeLE16(header + 22, 1); // mono
+  writeLE32(header + 24, sfx.rate);
+  writeLE32(header + 28, sfx.rate * 2);
+  writeLE16(header + 32, 2);
+  writeLE16(header + 34, 16);
+  std::memcpy(header + 36, "data", 4);
+  writeLE32(header + 40, dataSize);
+}
+
+SfxVoice::SfxVoice() {
+  mSlots[0].buffer.label("sfx buffer");
+  mSlots[1].buffer.label("sfx buffer");
+  mSource.label("sfx source");
+}
+
+void SfxVoice::play(const Sfx &sfx) {
+  mSource.stop();
+  if(sfx.samples == 0) {
+    return;
+  }
+  usize slot = 0;
+  while(slot < mSlots.size() && mSlots[slot].sfx != &sfx) {
+    ++slot;
+  }
+  if(slot == mSlots.size()) {
+    // the buffer attached to the source cannot be uploaded to
+    slot = 1 - mCurrent;
+    if(!upload(sfx, mSlots[slot])) {
+      return;
+    }
+  }
+  mSource.buffer(mSlots[slot].buffer);
+  mCurrent = slot;
+  mSource.play();
+}
+
+void SfxVoice::stop() {
+  mSource.stop();
+  for(auto &slot: mSlots) {
+    slot.sfx = nullptr;
+  }
+  mScratch = {};
+}
+
+bool SfxVoice::upload(const Sfx &sfx, Slot &slot) {
+  decodeWav(sfx, mScratch);
+  usize size = cWavHeaderSize + sfx.samples * sizeof(s16);
+  data::RW file{SDL_RWFromConstMem(mScratch.data(), int(size))};
+  slot.sfx = nullptr;
+  if(!slot.buffer.load(file)) {
+    console::error("Could not upload sound effect: {}", SDL_GetError());
+    return false;
+  }
+  slot.sfx = &sfx;
+  return true;
+}
+
+/* a common audio device period, 1024 frames at 48 kHz */
+static constexpr f64 cAudioPeriodMicros = 1024.0 / 48000.0 * 1e6;
+
+void benchmarkSfx(std::initializer_list<std::pair<const char*, const Sfx*>> sounds, usize iterations) {
+  iterations = std::max<usize>(iterations, 1);
+  // never played, so nothing is heard
+  SfxVoice voice;
+  console::print("sound effects, decode and upload before a sound starts, {} iterations:", iterations);
+  bool allInTime = true;
+  for(const auto &[name, sfx]: sounds) {
+    BenchResult result;
+    bool ok = bench(iterations, result, [&voice, sfx = sfx]{
+      return voice.upload(*sfx, voice.mSlots[0]);
+    });
+    if(!ok) {
+      console::error("could not upload {}, not benchmarking", name);
+      return;
+    }
+    printBench(name, result);
+    allInTime = allInTime && result.micros <= cAudioPeriodMicros;
+  }
+  if(allInTime) {
+    console::print("  every sound starts within one audio period ({:.0f}us)", cAudioPeriodMicros);
+  } else {
+    console::error("some sounds take longer than one audio period ({:.0f}us) to start",
+      cAudioPeriodMicros);
+  }
+  if(!AllocationCounter::cSupported) {
+    console::print("  (allocations are only counted in debug builds)");
+  }
+}
+
+} // namespace sbs
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+Sfx.hpp
+-------
+Sound effects kept compressed in memory, decoded when they play
+*/
+
+#include "adpcm.hpp"
+#include <array>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include <nwge/audio/Buffer.hpp>
+#include <nwge/audio/Source.hpp>
+#include <nwge/common/def.h>
+#include <nwge/data/rw.hpp>
+
+namespace sbs {
+
+/* longest sound effect, so a voice never decodes more than 256 KiB of PCM,
+   about 6 seconds at 22050 Hz */
+static constexpr usize cMaxSfxSamples = usize(128) * 1024;
+
+/* A sound effect, kept IMA-ADPCM compressed (see adpcm.hpp) at a quarter of
+   the size of its PCM. Loaded from a 16-bit PCM WAV, which the bundle step
+   makes every WAV; stereo is mixed down to mono. Sounds longer than
+   cMaxSfxSamples are rejected. */
+struct Sfx {
+  std::vector<u8> blocks;
+  usize samples = 0;
+  u32 rate = 0;
+
+  bool load(nwge::data::RW &file);
+
+  [[nodiscard]] inline usize blockCount() const {
+    return blocks.size() / adpcm::cBlockSize;
+  }
+};
+
+/* Plays one sound effect at a time through the engine, like an
+   audio::Source. A sound is decoded into one of the voice's two engine
+   buffers when it is played, and stays there until another sound needs the
+   buffer, so the PCM of at most two sounds per voice is resident. Sounds
+   replayed often, like pop.wav, are only decoded the first time.
+   The engine takes sounds as WAV files, so a sound is decoded straight into
+   the data chunk of a WAV image in the voice's scratch buffer, which is
+   handed to the engine buffer as is. */
+class SfxVoice {
+public:
+  SfxVoice();
+
+  /* Starts the sound from the beginning, cutting off the one playing. */
+  void play(const Sfx &sfx);
+  /* Also forgets the decoded sounds, so the ones played so far may be
+     released. */
+  void stop();
+
+private:
+  friend void benchmarkSfx(std::initializer_list<std::pair<const char*, const Sfx*>> sounds, usize iterations);
+
+  struct Slot {
+    nwge::audio::Buffer buffer;
+    /* the sound in the buffer, only compared against */
+    const Sfx *sfx = nullptr;
+  };
+
+  std::array<Slot, 2> mSlots;
+  nwge::audio::Source mSource;
+  /* the slot attached to the source */
+  usize mCurrent = 0;
+  /* the WAV image of the last sound decoded, kept for the next one */
+  std::vector<s16> mScratch;
+
+  /* Decodes the sound into the slot's buffer. */
+  bool upload(const Sfx &sfx, Slot &slot);
+};
+
+/* Times what playing each sound costs before it starts when it is not in a
+   voice's buffers yet, decoding and uploading it, against one audio period. */
+void benchmarkSfx(std::initializer_list<std::pair<const char*, const Sfx*>> sounds, usize iterations);
+
+} // namespace sbs
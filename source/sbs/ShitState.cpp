@@ -1,9 +1,16 @@
+#include "AssetCache.hpp"
+#include "ConfigWatcher.hpp"
+#include "Sfx.hpp"
+#include "Sim.hpp"
+#include "memory.hpp"
+#include "saves.hpp"
+#include "startup.hpp"
 #include "states.hpp"
 #include "save.hpp"
 #include "ui.hpp"
+#include <algorithm>
 #include <cmath>
 #include <nwge/console/Command.hpp>
-#include <nwge/data/bundle.hpp>
 #include <nwge/data/store.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/Texture.hpp>
@@ -18,8 +25,10 @@ namespace sbs {
 
 class ShitState: public State {
 private:
-  data::Bundle mBundle;
-  render::Texture mBarsTexture;
+  CachedBundle mBundle;
+  AssetHandle<render::Texture> mBarsTexture;
+  /* set once the assets went to the end state */
+  bool mHandedOff = false;
 
   static constexpr f32
     cBarFillOff = 0.001f,
@@ -35,7 +44,7 @@ class ShitState: public State {
     render::color(color);
     render::enableScissor();
     render::scissor({pos.x, pos.y}, {size.x, size.y * progress});
-    render::rect({pos.x, pos.y, pos.z - cBarFillOff}, size, mBarsTexture);
+    render::rect({pos.x, pos.y, pos.z - cBarFillOff}, size, *mBarsTexture);
     render::disableScissor();
 
     render::color(color * cBarBgClrMult);
@@ -47,17 +56,17 @@ class ShitState: public State {
       {size.x + 2*cPad, size.y + 3*cPad + cBarTextH}
     );
 
-    auto measure = mFont.measure(name, cBarTextH);
+    auto measure = mFont->measure(name, cBarTextH);
     f32 textX = size.x / 2 - measure.x / 2 + pos.x - 3*cBarTextH/4;
     f32 textY = pos.y + size.y + cPad;
     f32 textZ = pos.z - 2*cBarFillOff;
-    drawTextWithShadow(mFont, name,
+    drawTextWithShadow(*mFont, name,
       {textX + cBarTextH, textY, textZ},
       cBarTextH);
     render::rect(
       {textX, textY, textZ},
       {cBarTextH, cBarTextH},
-      mIconsTexture,
+      *mIconsTexture,
       {
         {f32(icon % 2) * cIconTexUnit, f32(s16(icon / 2)) * cIconTexUnit},
         {cIconTexUnit, cIconTexUnit}});
@@ -65,19 +74,22 @@ class ShitState: public State {
       render::rect(
         {textX, textY, textZ - cBarFillOff},
         {cBarTextH, cBarTextH},
-        mIconsTexture,
+        *mIconsTexture,
         {
           {0, 0.5f},
           {1.0f/8.0f, 1.0f/8.0f}});
     }
   }
 
-  f32 mEffort = 0.0f;
+  Sim mSim;
 
-  static constexpr f32
-    cEffortDecay = 0.3f,
-    cEffortIncrement = 0.1f,
-    cMaxEffort = 1.0f;
+  SimTiers tiers() const {
+    return {
+      .lube = mSave.v3.lubeTier,
+      .gravity = mSave.v3.gravityTier,
+      .oxy = mSave.v3.oxyTier,
+    };
+  }
 
   static constexpr f32
     cEffortBarW = 0.1f,
@@ -88,11 +100,6 @@ class ShitState: public State {
   static constexpr glm::vec3
     cEffortBarColor{2, 2, 0};
 
-  f32 mOxy = 1.0f;
-  f32 mOxyCooldown = 0.0f;
-
-  bool mOuttaBreath = false;
-
   static constexpr f32
     cOxyBarW = 0.1f,
     cOxyBarH = 4*cOxyBarW,
@@ -103,26 +110,7 @@ class ShitState: public State {
     cOxyBarColor{0, 1, 1},
     cOxyBarBadColor{1, 0, 0};
 
-  f32 mProgress = 0.0f;
-
-  static constexpr f32 cProgressScalar = 0.5f;
-
-  f32 mCooldown = 0.0f;
-
-  f32 mGravity = 0.0f;
-  f32 mProgressDecay = 0.9f;
-
-  void recalculateProgressDecay() {
-    mProgressDecay = mConfig.lube.base - f32(mSave.v2.lubeTier) * mConfig.lube.upgrade;
-  }
-
-  void recalculateGravity() {
-    mGravity = mConfig.gravity.base + f32(mSave.v2.gravityTier) * mConfig.gravity.upgrade;
-  }
-
-  render::Texture mBrickTexture;
-
-  f32 mBrickFall = -1.0f;
+  AssetHandle<render::Texture> mBrickTexture;
 
   static constexpr f32
     cBrickX = 0.5f,
@@ -136,14 +124,14 @@ class ShitState: public State {
     cTextY = 0.075f,
     cTextZ = 0.53f;
 
-  render::Font mFont;
+  AssetHandle<render::Font> mFont;
   ScratchString mScoreString;
 
   void refreshScoreString() {
-    mScoreString = ScratchString::formatted("Score: {}", mSave.v2.score);
+    mScoreString = ScratchString::formatted("Score: {}", mSave.v3.score);
   }
 
-  render::Texture mWaterTexture;
+  AssetHandle<render::Texture> mWaterTexture;
 
   static constexpr f32
     cWaterW = 1,
@@ -155,10 +143,42 @@ class ShitState: public State {
     cWaterZ = 0.54f;
 
   f32 mTimer = 0.0f;
+  /* whether the splash plays when the falling brick reaches the water */
+  bool mSplashPending = true;
 
   static constexpr f32 cFadeInTime = 1.0f;
 
-  render::Texture mBgTexture, mVignetteTexture;
+  /* Keeps the gameplay in flight for the next time the game is entered. */
+  void suspend() const {
+    saves::Snapshot snapshot{};
+    snapshot.sim = mSim.snapshot();
+    snapshot.tiers = tiers();
+    snapshot.score = mSave.v3.score;
+    snapshot.timer = mTimer;
+    snapshot.splash = u8(mSplashPending);
+    snapshot.balance = balanceCrc(*mConfig);
+    saves::suspend(snapshot);
+  }
+
+  /* Picks up where suspend() left off. Returns false if there is nothing to
+     resume. */
+  bool resume() {
+    saves::Snapshot snapshot{};
+    if(!saves::resume(snapshot, mSave.v3)) {
+      return false;
+    }
+    if(snapshot.balance != balanceCrc(*mConfig)) {
+      console::note("The suspended game ran with a different config, not resuming it.");
+      return false;
+    }
+    mSim.restore(snapshot.sim);
+    // straight back into the game, without fading in again
+    mTimer = std::max(snapshot.timer, cFadeInTime);
+    mSplashPending = snapshot.splash != 0;
+    return true;
+  }
+
+  AssetHandle<render::Texture> mBgTexture, mVignetteTexture;
 
   static constexpr f32
     cBgZ = 0.6f,
@@ -169,7 +189,7 @@ class ShitState: public State {
   data::Store mStore;
 
   void save() {
-    mStore.nqSave("save.json", mSave);
+    saves::nq(mSave);
     refreshScoreString();
   }
 
@@ -178,7 +198,7 @@ class ShitState: public State {
     save();
   }
 
-  render::Texture mIconsTexture;
+  AssetHandle<render::Texture> mIconsTexture;
 
   bool mHoveringStoreIcon = false;
 
@@ -203,17 +223,45 @@ class ShitState: public State {
       (mousePos.y > cStoreIconY && mousePos.y < cStoreIconY+cStoreIconH);
   }
 
-  Config mConfig;
+  ConfigPtr mConfig;
   Savefile mSave{};
 
+#ifdef DEBUG
+  ConfigWatcher mConfigWatcher;
+  /* configs a reload replaced, kept for a store opened before it */
+  std::vector<ConfigPtr> mReplacedConfigs;
+
+  /* Switches to the reloaded config. Geometry is read from the config every
+     frame and the store on opening, so only the sim has to be told. */
+  void applyConfig(ConfigPtr config) {
+    u8 changes = diffConfig(*mConfig, *config);
+    if(changes == 0) {
+      console::note("cfg.json reloaded, nothing changed.");
+      return;
+    }
+    console::note("cfg.json reloaded, changed:{}{}{}{}",
+      (changes & GeometryChanged) != 0 ? " geometry" : "",
+      (changes & BalanceChanged) != 0 ? " balance" : "",
+      (changes & StoreChanged) != 0 ? " store" : "",
+      (changes & SocialsChanged) != 0 ? " socials" : "");
+    replaceSharedConfig(config);
+    mReplacedConfigs.push_back(std::move(mConfig));
+    mConfig = std::move(config);
+    mSim.setConfig(mConfig);
+    if((changes & BalanceChanged) != 0) {
+      mSim.recalculate(tiers());
+    }
+  }
+#endif
+
   console::Command mLubeCommand{"sbs.lube", [this](auto &args){
     if(args.size() == 0) {
-      console::print("lube tier: {}", mSave.v2.lubeTier);
+      console::print("lube tier: {}", mSave.v3.lubeTier);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.lubeTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("lube tier: {}", mSave.v2.lubeTier);
+        mSave.v3.lubeTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        console::print("lube tier: {}", mSave.v3.lubeTier);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -222,26 +270,38 @@ class ShitState: public State {
 
   console::Command mGravityCommand{"sbs.gravity", [this](auto &args){
     if(args.size() == 0) {
-      console::print("gravity tier: {}", mSave.v2.gravityTier);
+      console::print("gravity tier: {}", mSave.v3.gravityTier);
+    }
+    if(args.size() == 1) {
+      try {
+        mSave.v3.gravityTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        console::print("gravity tier: {}", mSave.v3.gravityTier);
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
+      }
     }
+  }};
+
+  console::Command mSaveWindowCommand{"sbs.saveWindow", [](auto &args){
     if(args.size() == 1) {
       try {
-        mSave.v2.gravityTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("gravity tier: {}", mSave.v2.gravityTier);
+        saves::setWindow(boost::lexical_cast<f32>(args[0].begin(), args[0].size()));
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
+        return;
       }
     }
+    console::print("save window: {}s", saves::window());
   }};
 
   console::Command mScoreCommand{"sbs.score", [this](auto &args){
     if(args.size() == 0) {
-      console::print("score: {}", mSave.v2.score);
+      console::print("score: {}", mSave.v3.score);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.score = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("score: {}", mSave.v2.score);
+        mSave.v3.score = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        console::print("score: {}", mSave.v3.score);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -250,12 +310,12 @@ class ShitState: public State {
 
   console::Command mOxyCommand{"sbs.oxyTier", [this](auto &args){
     if(args.size() == 0) {
-      console::print("oxyTier: {}", mSave.v2.oxyTier);
+      console::print("oxyTier: {}", mSave.v3.oxyTier);
     }
     if(args.size() == 1) {
       try {
-        mSave.v2.oxyTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
-        console::print("oxyTier: {}", mSave.v2.oxyTier);
+        mSave.v3.oxyTier = boost::lexical_cast<s16>(args[0].begin(), args[0].size());
+        console::print("oxyTier: {}", mSave.v3.oxyTier);
       } catch(boost::bad_lexical_cast &e) {
         console::error("bad numeric literal: {}", args[0]);
       }
@@ -266,68 +326,98 @@ class ShitState: public State {
     resetSave();
   }};
 
+  console::Command mBenchSimCommand{"sbs.benchSim", [this](auto &args){
+    usize ticks = 1000000;
+    if(args.size() == 1) {
+      try {
+        ticks = boost::lexical_cast<usize>(args[0].begin(), args[0].size());
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
+        return;
+      }
+    }
+    benchmarkSim(mConfig, ticks);
+  }};
+
+  console::Command mBenchSfxCommand{"sbs.benchSfx", [this](auto &args){
+    usize iterations = 100;
+    if(args.size() == 1) {
+      try {
+        iterations = boost::lexical_cast<usize>(args[0].begin(), args[0].size());
+      } catch(boost::bad_lexical_cast &e) {
+        console::error("bad numeric literal: {}", args[0]);
+        return;
+      }
+    }
+    benchmarkSfx({
+      {"breath.wav", &*mBreath},
+      {"splash.wav", &*mSplash},
+      {"buy.wav", &*mBuy},
+      {"broke.wav", &*mBrokeAssMfGetAJob},
+      {"pop.wav", &*mPop},
+    }, iterations);
+  }};
+
   f32 mWaterX = 0.0f;
   f32 mWaterY = 0.0f;
 
-  audio::Source mBreathSource;
-  audio::Buffer mBreath;
-
-  audio::Source mSfxSource;
-  audio::Buffer mSplash;
-  audio::Buffer mBuy;
-  audio::Buffer mBrokeAssMfGetAJob;
-  audio::Buffer mPop;
-  inline void play(audio::Buffer &sound) {
-    mSfxSource.stop();
-    mSfxSource.buffer(sound);
-    mSfxSource.play();
+  AssetHandle<Sfx> mBreath;
+  AssetHandle<Sfx> mSplash;
+  AssetHandle<Sfx> mBuy;
+  AssetHandle<Sfx> mBrokeAssMfGetAJob;
+  AssetHandle<Sfx> mPop;
+  // after the sounds, so the voices go first
+  SfxVoice mBreathVoice;
+  SfxVoice mSfxVoice;
+  inline void play(const Sfx &sound) {
+    mSfxVoice.play(sound);
   }
 
-  render::Texture mToiletTexture, mToiletFTexture;
+  AssetHandle<render::Texture> mToiletTexture, mToiletFTexture;
 
   void renderBrick() const {
     f32 brickY;
-    if(mCooldown == 0.0) {
-      brickY = mConfig.brick.startY + mProgress * (mConfig.brick.endY - mConfig.brick.startY);
+    if(mSim.cooldown == 0.0) {
+      brickY = mConfig->brick.startY + mSim.progress * (mConfig->brick.endY - mConfig->brick.startY);
     } else {
-      brickY = mConfig.brick.endY + mBrickFall * (cBrickFallEndY - mConfig.brick.endY);
+      brickY = mConfig->brick.endY + mSim.brickFall * (cBrickFallEndY - mConfig->brick.endY);
     }
     render::mat::push();
-    render::mat::translate({mConfig.brick.xPos, brickY, cBrickZ});
+    render::mat::translate({mConfig->brick.xPos, brickY, cBrickZ});
     render::mat::rotate(M_PI/2, {0, 0, 1});
     render::rect(
       {0, 0, 0},
-      {2*mConfig.brick.size, mConfig.brick.size},
-      mBrickTexture);
+      {2*mConfig->brick.size, mConfig->brick.size},
+      *mBrickTexture);
     render::mat::pop();
   }
 
   void renderToilet() const {
     render::rect(
-      {mConfig.toilet.xPos, mConfig.toilet.yPos, cToiletZ},
-      {mConfig.toilet.size, mConfig.toilet.size},
-      mToiletTexture);
+      {mConfig->toilet.xPos, mConfig->toilet.yPos, cToiletZ},
+      {mConfig->toilet.size, mConfig->toilet.size},
+      *mToiletTexture);
     render::rect(
-      {mConfig.shitter.xPos, mConfig.shitter.yPos, cShitterZ},
-      {mConfig.shitter.width, mConfig.shitter.height},
-      mShitterTexture);
+      {mConfig->shitter.xPos, mConfig->shitter.yPos, cShitterZ},
+      {mConfig->shitter.width, mConfig->shitter.height},
+      *mShitterTexture);
 
     render::enableScissor();
     render::scissor(
-      {mConfig.water.scissorX, mConfig.water.scissorY},
-      {mConfig.water.scissorW, mConfig.water.scissorH});
+      {mConfig->water.scissorX, mConfig->water.scissorY},
+      {mConfig->water.scissorW, mConfig->water.scissorH});
     render::color({1, 1, 1, 0.5f});
     render::rect(
       {mWaterX, mWaterY, cWaterZ},
-      {mConfig.water.width, mConfig.water.height},
-      mWaterTexture);
+      {mConfig->water.width, mConfig->water.height},
+      *mWaterTexture);
     render::disableScissor();
 
     render::color();
     render::rect(
-      {mConfig.toilet.xPos, mConfig.toilet.yPos, cToiletFZ},
-      {mConfig.toilet.size, mConfig.toilet.size},
-      mToiletFTexture);
+      {mConfig->toilet.xPos, mConfig->toilet.yPos, cToiletFZ},
+      {mConfig->toilet.size, mConfig->toilet.size},
+      *mToiletFTexture);
   }
 
   void renderBars() const {
@@ -335,25 +425,25 @@ class ShitState: public State {
       "Effort",
       {cEffortBarX, cEffortBarY, cEffortBarZ},
       {cEffortBarW, cEffortBarH},
-      mEffort,
+      mSim.effort,
       cEffortBarColor,
       3);
     renderBar(
       "Oxy",
       {cOxyBarX, cOxyBarY, cOxyBarZ},
       {cOxyBarW, cOxyBarH},
-      mOxy,
-      mOuttaBreath ? cOxyBarBadColor : cOxyBarColor,
+      mSim.oxy,
+      mSim.outtaBreath ? cOxyBarBadColor : cOxyBarColor,
       2,
-      mOuttaBreath);
+      mSim.outtaBreath);
     render::color();
   }
 
   Music mMusic;
 
-  render::Texture mShitterTexture;
+  AssetHandle<render::Texture> mShitterTexture;
 
-  render::Texture mPRTexture;
+  AssetHandle<render::Texture> mPRTexture;
 
   std::mt19937 mRng;
   static constexpr s32 cPRRoll = 10000;   /* maximum number randomly rolled */
@@ -370,15 +460,30 @@ class ShitState: public State {
     : mMusic(std::move(music))
   {}
 
+  ShitState(const ShitState&) = delete;
+  ShitState(ShitState&&) = delete;
+  ShitState &operator=(const ShitState&) = delete;
+  ShitState &operator=(ShitState&&) = delete;
+
+  ~ShitState() override {
+    if(mConfig != nullptr && !mHandedOff) {
+      // the snapshot is only resumed on top of the save it was taken with
+      if(mSave.dirty) {
+        save();
+      }
+      suspend();
+    }
+    saves::flush();
+  }
+
   bool preload() override {
     mBundle
-      .load({"sbs.bndl"})
       .nqTexture("bars.png", mBarsTexture)
       .nqTexture("brick.png", mBrickTexture)
       .nqFont("GrapeSoda.cfn", mFont)
       .nqTexture("water.png", mWaterTexture)
       .nqTexture("bg.png", mBgTexture)
-      .nqCustom("cfg.json", mConfig)
+      .nqConfig()
       .nqTexture("vignette.png", mVignetteTexture)
       .nqTexture("icons.png", mIconsTexture)
       .nqCustom("splash.wav", mSplash)
@@ -390,25 +495,53 @@ class ShitState: public State {
       .nqTexture("toiletF.png", mToiletFTexture)
       .nqTexture("shitter.png", mShitterTexture)
       .nqTexture("PR.JPG"_sv, mPRTexture);
-    mStore.nqLoad("progress", mSave.v1);
-    mStore.nqLoad("save.json", mSave.v2);
+    saves::prefetch();
+    if(saves::migrationPending()) {
+      mStore.nqLoad("progress", mSave.v1);
+      mStore.nqLoad("save.json", mSave.v2);
+    }
     return true;
   }
 
   bool init() override {
-    mBreathSource.buffer(mBreath);
-    recalculateProgressDecay();
-    recalculateGravity();
+    reportStartup();
+    if(!mBundle.wait()) {
+      return false;
+    }
+    reportPeakMemory("from the menu to the game");
+    saves::load(mSave);
+    // saving may drop the old save, so remember where it came from
+    bool fromProgress = mSave.v1.loaded;
+    mConfig = sharedConfig();
+    mSim.setConfig(mConfig);
+    if(!mSim.shipped()) {
+      console::note("The config differs from the shipped one, using the runtime sim.");
+    }
+    if(!resume()) {
+      mSim.recalculate(tiers());
+    }
     refreshScoreString();
     save();
-    if(mSave.v1.loaded) {
+    if(fromProgress) {
       mStore.nqDelete("progress"_sv);
     }
     return true;
   }
 
+  void handOff() {
+    // the voices know their sounds by address, and these are about to be
+    // released
+    mBreathVoice.stop();
+    mSfxVoice.stop();
+    reportPeakMemory("in the game");
+    // the game was ended, there is nothing to come back to
+    saves::discardSnapshot();
+    mBundle.handOff(nullptr);
+    mHandedOff = true;
+  }
+
   bool on(Event &evt) override {
-    if(mTimer < cFadeInTime) {
+    if(mHandedOff || mTimer < cFadeInTime) {
       return true;
     }
     if(evt.type == Event::MouseDown) {
@@ -416,12 +549,13 @@ class ShitState: public State {
       if(mHoveringStoreIcon) {
         StoreData data{
           mSave,
-          mConfig,
-          mSfxSource,
-          mBuy,
-          mBrokeAssMfGetAJob,
-          mFont,
-          mIconsTexture,
+          *mConfig,
+          mSfxVoice,
+          *mBuy,
+          *mBrokeAssMfGetAJob,
+          *mFont,
+          *mIconsTexture,
+          [this]{ handOff(); },
         };
         pushSubStatePtr(getStoreSubState(data), {
           .tickParent = true,
@@ -429,11 +563,7 @@ class ShitState: public State {
         });
         return true;
       }
-      if(!mOuttaBreath
-      && mCooldown <= 0
-      && mEffort < cMaxEffort
-      && mOxy >= mConfig.oxy.min) {
-        mEffort += cEffortIncrement;
+      if(mSim.push()) {
         return true;
       }
     }
@@ -444,15 +574,22 @@ class ShitState: public State {
   }
 
   bool tick(f32 delta) override {
+    if(mHandedOff) {
+      return true;
+    }
     if(mSave.dirty) {
       save();
     }
-
-    static bool sSplash = true;
+    saves::report();
+#ifdef DEBUG
+    if(auto reloaded = mConfigWatcher.poll()) {
+      applyConfig(std::move(reloaded));
+    }
+#endif
 
     mTimer += delta;
-    mWaterX = mConfig.water.minX - (0.5f*sinf(1+1.2*mTimer) + 1) * (mConfig.water.maxX - mConfig.water.minX);
-    mWaterY = mConfig.water.minY + (0.5f*sinf(mTimer) + 1) * (mConfig.water.maxY - mConfig.water.minY);
+    mWaterX = mConfig->water.minX - (0.5f*sinf(1+1.2*mTimer) + 1) * (mConfig->water.maxX - mConfig->water.minX);
+    mWaterY = mConfig->water.minY + (0.5f*sinf(mTimer) + 1) * (mConfig->water.maxY - mConfig->water.minY);
     if(mPRImg > 0) {
       mPRImg = -1;
     } else {
@@ -466,87 +603,42 @@ class ShitState: public State {
       return true;
     }
 
-    if(mEffort > 0) {
-      mEffort -= cEffortDecay * delta;
-      if(mOuttaBreath || mCooldown > 0) {
-        mEffort -= delta;
-      }
-      if(mEffort < 0) {
-        mEffort = 0;
-      }
+    u8 events = mSim.step(tiers(), delta);
+    if(events & Sim::OuttaBreath) {
+      mBreathVoice.play(*mBreath);
     }
-
-    if(mOxy < 1.0f) {
-      f32 regen = mConfig.oxy.regenFast;
-      if(mOuttaBreath && mSave.v2.oxyTier < 1) {
-        regen = mConfig.oxy.regenSlow;
-      }
-      mOxy += regen * delta;
-    } else {
-      mOuttaBreath = false;
+    if(events & Sim::Scored) {
+      play(*mPop);
+      ++mSave.v3.score;
+      save();
     }
-
-    mOxy -= mEffort * mConfig.oxy.drain * delta;
-    if(mOxy <= 0) {
-      if(!mOuttaBreath) {
-        mBreathSource.play();
-      }
-      mOuttaBreath = true;
-      mOxy = 0;
+    if(events & Sim::BrickReset) {
+      mSplashPending = true;
     }
-
-    if(mProgress < 1) {
-      mProgress += mEffort * cProgressScalar * delta;
-      if(mProgress >= mConfig.gravity.threshold) {
-        mProgress += mGravity * delta;
-      }
-      if(mProgress >= 1) {
-        mCooldown = 1.0f;
-        mBrickFall = 0.0f;
-        play(mPop);
-        ++mSave.v2.score;
-        save();
-      } else if(mProgress > 0) {
-        mProgress -= mProgressDecay * delta;
-        if(mProgress < 0) {
-          mProgress = 0;
-        }
-      }
-    } else if(mCooldown > 0) {
-      mCooldown -= delta;
-    } else {
-      mProgress = 0;
-      mCooldown = 0;
-      mBrickFall = -1.0f;
-      recalculateProgressDecay();
-      recalculateGravity();
-      sSplash = true;
-    }
-
-    if(mBrickFall >= 0) {
-      mBrickFall += mConfig.brick.fallSpeed * delta;
-      if(mBrickFall >= mWaterY && sSplash) {
-        play(mSplash);
-        sSplash = false;
-      }
+    if(mSim.brickFall >= mWaterY && mSplashPending) {
+      play(*mSplash);
+      mSplashPending = false;
     }
     return true;
   }
 
   void render() const override {
+    if(mHandedOff) {
+      return;
+    }
     render::color();
-    render::rect({0, 0, cBgZ}, {1, 1}, mBgTexture);
+    render::rect({0, 0, cBgZ}, {1, 1}, *mBgTexture);
 
-    if(mCooldown <= 0 || mBrickFall >= 0) {
+    if(mSim.cooldown <= 0 || mSim.brickFall >= 0) {
       renderBrick();
     }
 
     renderToilet();
     renderBars();
 
-    auto measure = mFont.measure(mScoreString, cTextH);
+    auto measure = mFont->measure(mScoreString, cTextH);
     f32 textX = cTextX - measure.x;
-    drawTextWithShadow(mFont, mScoreString, {textX, cTextY, cTextZ}, cTextH);
+    drawTextWithShadow(*mFont, mScoreString, {textX, cTextY, cTextZ}, cTextH);
 
     if(mHoveringStoreIcon) {
       render::color(cHoverColor);
@@ -554,7 +646,7 @@ class ShitState: public State {
     render::rect(
       {cStoreIconX, cStoreIconY, cStoreIconZ},
       {cStoreIconW, cStoreIconH},
-      mIconsTexture,
+      *mIconsTexture,
       {
         {cStoreIconTexX, cStoreIconTexY},
         {cStoreIconTexW, cStoreIconTexH}});
@@ -566,14 +658,14 @@ class ShitState: public State {
       render::rect(
         {0, 0, cPRZ},
         {1, 1},
-        mPRTexture, {
+        *mPRTexture, {
           {uvX, uvY},
           {1.0f/cPRW, 1.0f/cPRH}});
     }
 
-    f32 vignetteAlpha = fmaxf(mEffort, 1.0f - mOxy);
+    f32 vignetteAlpha = fmaxf(mSim.effort, 1.0f - mSim.oxy);
     render::color({1, 1, 1, vignetteAlpha});
-    render::rect({0, 0, cVignetteZ}, {1, 1}, mVignetteTexture);
+    render::rect({0, 0, cVignetteZ}, {1, 1}, *mVignetteTexture);
 
     if(mTimer < cFadeInTime) {
       render::color({0, 0, 0, 1.0f - mTimer / cFadeInTime});
@@ -0,0 +1,263 @@
+#include "Sim.hpp"
+#include "blob.hpp"
+#include "shipped.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <type_traits>
+#include <nwge/console.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+namespace {
+
+/* reads the balance constants from the loaded config */
+struct RuntimeBalance {
+  const Config &config;
+
+  [[nodiscard]] inline const Config::Lube &lube() const {
+    return config.lube;
+  }
+
+  [[nodiscard]] inline const Config::Gravity &gravity() const {
+    return config.gravity;
+  }
+
+  [[nodiscard]] inline const Config::Oxy &oxy() const {
+    return config.oxy;
+  }
+
+  [[nodiscard]] inline const Config::Brick &brick() const {
+    return config.brick;
+  }
+};
+
+/* the shipped constants, which the compiler folds into the sim */
+struct ShippedBalance {
+  static constexpr const Config::Lube &lube() {
+    return shipped::cLube;
+  }
+
+  static constexpr const Config::Gravity &gravity() {
+    return shipped::cGravity;
+  }
+
+  static constexpr const Config::Oxy &oxy() {
+    return shipped::cOxy;
+  }
+
+  static constexpr const Config::Brick &brick() {
+    return shipped::cBrick;
+  }
+};
+
+template<typename Balance>
+Balance balanceFor(const Config &config) {
+  if constexpr(std::is_same_v<Balance, ShippedBalance>) {
+    return {};
+  } else {
+    return {config};
+  }
+}
+
+} // namespace
+
+template<typename Balance>
+struct SimOps {
+  static void recalculate(Sim &sim, const SimTiers &tiers) {
+    auto balance = balanceFor<Balance>(*sim.mConfig);
+    sim.progressDecay = balance.lube().base - f32(tiers.lube) * balance.lube().upgrade;
+    sim.gravity = balance.gravity().base + f32(tiers.gravity) * balance.gravity().upgrade;
+  }
+
+  static bool push(Sim &sim) {
+    auto balance = balanceFor<Balance>(*sim.mConfig);
+    if(sim.outtaBreath
+    || sim.cooldown > 0
+    || sim.effort >= Sim::cMaxEffort
+    || sim.oxy < balance.oxy().min) {
+      return false;
+    }
+    sim.effort += Sim::cEffortIncrement;
+    return true;
+  }
+
+  static u8 step(Sim &sim, const SimTiers &tiers, f32 delta) {
+    auto balance = balanceFor<Balance>(*sim.mConfig);
+    u8 events = 0;
+
+    if(sim.effort > 0) {
+      sim.effort -= Sim::cEffortDecay * delta;
+      if(sim.outtaBreath || sim.cooldown > 0) {
+        sim.effort -= delta;
+      }
+      if(sim.effort < 0) {
+        sim.effort = 0;
+      }
+    }
+
+    if(sim.oxy < 1.0f) {
+      f32 regen = balance.oxy().regenFast;
+      if(sim.outtaBreath && tiers.oxy < 1) {
+        regen = balance.oxy().regenSlow;
+      }
+      sim.oxy += regen * delta;
+    } else {
+      sim.outtaBreath = false;
+    }
+
+    sim.oxy -= sim.effort * balance.oxy().drain * delta;
+    if(sim.oxy <= 0) {
+      if(!sim.outtaBreath) {
+        events |= Sim::OuttaBreath;
+      }
+      sim.outtaBreath = true;
+      sim.oxy = 0;
+    }
+
+    if(sim.progress < 1) {
+      sim.progress += sim.effort * Sim::cProgressScalar * delta;
+      if(sim.progress >= balance.gravity().threshold) {
+        sim.progress += sim.gravity * delta;
+      }
+      if(sim.progress >= 1) {
+        sim.cooldown = 1.0f;
+        sim.brickFall = 0.0f;
+        events |= Sim::Scored;
+      } else if(sim.progress > 0) {
+        sim.progress -= sim.progressDecay * delta;
+        if(sim.progress < 0) {
+          sim.progress = 0;
+        }
+      }
+    } else if(sim.cooldown > 0) {
+      sim.cooldown -= delta;
+    } else {
+      sim.progress = 0;
+      sim.cooldown = 0;
+      sim.brickFall = -1.0f;
+      recalculate(sim, tiers);
+      events |= Sim::BrickReset;
+    }
+
+    if(sim.brickFall >= 0) {
+      sim.brickFall += balance.brick().fallSpeed * delta;
+    }
+    return events;
+  }
+
+  static constexpr Sim::Ops cOps{
+    .recalculate = recalculate,
+    .push = push,
+    .step = step,
+    .shipped = std::is_same_v<Balance, ShippedBalance>,
+  };
+};
+
+bool matchesShipped(const Config &config) {
+  return config.lube == shipped::cLube
+    && config.gravity == shipped::cGravity
+    && config.oxy == shipped::cOxy
+    && config.brick == shipped::cBrick;
+}
+
+u32 balanceCrc(const Config &config) {
+  // field by field, the sections have padding
+  const std::array<f32, 17> fields{
+    config.lube.base, config.lube.upgrade, f32(config.lube.maxTier),
+    config.gravity.base, config.gravity.upgrade, config.gravity.threshold,
+    f32(config.gravity.maxTier),
+    config.oxy.regenFast, config.oxy.regenSlow, config.oxy.drain, config.oxy.min,
+    config.oxy.cooldown,
+    config.brick.xPos, config.brick.startY, config.brick.endY,
+    config.brick.fallSpeed, config.brick.size,
+  };
+  return blob::crc32(fields.data(), sizeof(fields));
+}
+
+void Sim::setConfig(ConfigPtr config) {
+  mOps = matchesShipped(*config)
+    ? &SimOps<ShippedBalance>::cOps
+    : &SimOps<RuntimeBalance>::cOps;
+  mConfig = std::move(config);
+}
+
+bool Sim::shipped() const {
+  return mOps->shipped;
+}
+
+void Sim::recalculate(const SimTiers &tiers) {
+  mOps->recalculate(*this, tiers);
+}
+
+bool Sim::push() {
+  return mOps->push(*this);
+}
+
+u8 Sim::step(const SimTiers &tiers, f32 delta) {
+  return mOps->step(*this, tiers, delta);
+}
+
+SimSnapshot Sim::snapshot() const {
+  return {
+    .effort = effort,
+    .oxy = oxy,
+    .progress = progress,
+    .cooldown = cooldown,
+    .brickFall = brickFall,
+    .gravity = gravity,
+    .progressDecay = progressDecay,
+    .outtaBreath = u8(outtaBreath),
+    .reserved = {},
+  };
+}
+
+void Sim::restore(const SimSnapshot &snapshot) {
+  effort = snapshot.effort;
+  oxy = snapshot.oxy;
+  progress = snapshot.progress;
+  cooldown = snapshot.cooldown;
+  brickFall = snapshot.brickFall;
+  gravity = snapshot.gravity;
+  progressDecay = snapshot.progressDecay;
+  outtaBreath = snapshot.outtaBreath != 0;
+}
+
+void benchmarkSim(ConfigPtr config, usize ticks) {
+  using Clock = std::chrono::steady_clock;
+  ticks = std::max<usize>(ticks, 1);
+  static constexpr f32 cDelta = 1.0f / 60.0f;
+
+  auto run = [&](const Sim::Ops &ops, u32 &scored) {
+    Sim sim;
+    sim.setConfig(config);
+    SimTiers tiers{};
+    ops.recalculate(sim, tiers);
+    scored = 0;
+    auto start = Clock::now();
+    for(usize i = 0; i < ticks; ++i) {
+      // a player clicking about six times a second
+      if(i % 10 == 0) {
+        ops.push(sim);
+      }
+      if(ops.step(sim, tiers, cDelta) & Sim::Scored) {
+        ++scored;
+      }
+    }
+    return std::chrono::duration<f64, std::nano>(Clock::now() - start).count() / f64(ticks);
+  };
+
+  u32 runtimeScored, shippedScored;
+  f64 runtimeTime = run(SimOps<RuntimeBalance>::cOps, runtimeScored);
+  f64 shippedTime = run(SimOps<ShippedBalance>::cOps, shippedScored);
+  console::print("sim, {} ticks:", ticks);
+  console::print("  runtime config:    {:.2f}ns/tick, {} bricks", runtimeTime, runtimeScored);
+  console::print("  shipped constants: {:.2f}ns/tick, {} bricks", shippedTime, shippedScored);
+  if(!matchesShipped(*config)) {
+    console::print("  (the loaded config is not the shipped one, the game uses the runtime path)");
+  }
+}
+
+} // namespace sbs
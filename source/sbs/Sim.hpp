@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+Sim.hpp
+-------
+The brick pushing, apart from rendering and input
+*/
+
+#include "config.hpp"
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* upgrade tiers the sim depends on, from the save file */
+struct SimTiers {
+  s16 lube = 0;
+  s16 gravity = 0;
+  s16 oxy = 0;
+};
+
+/* everything a Sim steps, copied out as is to be resumed later */
+struct SimSnapshot {
+  f32 effort;
+  f32 oxy;
+  f32 progress;
+  f32 cooldown;
+  f32 brickFall;
+  f32 gravity;
+  f32 progressDecay;
+  u8 outtaBreath;
+  u8 reserved[3];
+};
+static_assert(sizeof(SimSnapshot) == 32);
+
+/* Effort, oxygen and brick progress, stepped once per tick. The sim is
+   instantiated twice: once reading the balance constants from the loaded
+   config, and once with the constants of the shipped cfg.json (see
+   shipped.hpp, which the bundle step generates) folded in. setConfig() picks
+   the latter whenever the loaded config matches what was shipped, so modded
+   configs still work. */
+class Sim {
+public:
+  enum Event: u8 {
+    OuttaBreath = 1 << 0,
+    Scored      = 1 << 1,
+    BrickReset  = 1 << 2,
+  };
+
+  static constexpr f32
+    cEffortDecay = 0.3f,
+    cEffortIncrement = 0.1f,
+    cMaxEffort = 1.0f,
+    cProgressScalar = 0.5f;
+
+  f32 effort = 0.0f;
+  f32 oxy = 1.0f;
+  bool outtaBreath = false;
+  f32 progress = 0.0f;
+  f32 cooldown = 0.0f;
+  f32 brickFall = -1.0f;
+
+  /* rates which depend on the upgrade tiers, see recalculate() */
+  f32 gravity = 0.0f;
+  f32 progressDecay = 0.9f;
+
+  void setConfig(ConfigPtr config);
+
+  /* whether the constant-folded instantiation is in use */
+  [[nodiscard]] bool shipped() const;
+
+  /* Recomputes the tier-dependent rates. Upgrades bought mid-brick only apply
+     to the next one. */
+  void recalculate(const SimTiers &tiers);
+
+  /* Adds effort for a click. Returns false if the player cannot push right
+     now. */
+  bool push();
+
+  /* Returns the Events which happened during the step. */
+  u8 step(const SimTiers &tiers, f32 delta);
+
+  [[nodiscard]] SimSnapshot snapshot() const;
+
+  /* Puts the sim back where snapshot() was taken, including the tier-dependent
+     rates, so there is no need to recalculate(). */
+  void restore(const SimSnapshot &snapshot);
+
+private:
+  template<typename Balance>
+  friend struct SimOps;
+  friend void benchmarkSim(ConfigPtr config, usize ticks);
+
+  struct Ops {
+    void (*recalculate)(Sim &sim, const SimTiers &tiers);
+    bool (*push)(Sim &sim);
+    u8 (*step)(Sim &sim, const SimTiers &tiers, f32 delta);
+    bool shipped;
+  };
+
+  ConfigPtr mConfig;
+  const Ops *mOps = nullptr;
+};
+
+/* Whether the sim-relevant sections of `config` are the shipped ones. */
+bool matchesShipped(const Config &config);
+
+/* CRC32 of the sim-relevant sections of `config`, to tell whether a sim
+   snapshot was taken with the same balance. */
+u32 balanceCrc(const Config &config);
+
+/* Times both sim instantiations over `ticks` ticks of simulated play, and
+   prints the results to the console. */
+void benchmarkSim(ConfigPtr config, usize ticks);
+
+} // namespace sbs
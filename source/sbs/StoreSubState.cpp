@@ -13,19 +13,21 @@ namespace sbs {
 class StoreSubState: public SubState {
 private:
   StoreData mData;
+  /* set once the game's assets went to the end state */
+  bool mEnded = false;
 
   [[nodiscard]]
   bool hasItem(const StoreItem &item) const {
-    if(mData.save.v2.prestige < item.prestige) {
+    if(mData.save.v3.prestige < item.prestige) {
       return false;
     }
     switch(item.kind) {
     case sbs::StoreItem::Lube:
-      return mData.save.v2.lubeTier >= item.argument;
+      return mData.save.v3.lubeTier >= item.argument;
     case sbs::StoreItem::Gravity:
-      return mData.save.v2.gravityTier >= item.argument;
+      return mData.save.v3.gravityTier >= item.argument;
     case sbs::StoreItem::Oxy:
-      return mData.save.v2.oxyTier >= item.argument;
+      return mData.save.v3.oxyTier >= item.argument;
     default:
       return false;
     }
@@ -110,35 +112,33 @@ class StoreSubState: public SubState {
     if(hasItem(item)) {
       mPurchaseFloat = cAlreadyOwnedFloat;
       mPurchaseFloatTimer = 0.0f;
-      mData.source.stop();
-      mData.source.buffer(mData.brokeSound);
-      mData.source.play();
+      mData.voice.play(mData.brokeSound);
       return;
     }
 
-    if(mData.save.v2.score < item.price) {
+    if(mData.save.v3.score < item.price) {
       // broke ahh
       mPurchaseFloat = cInsufficientFundsFloat;
       mPurchaseFloatTimer = 0.0f;
-      mData.source.stop();
-      mData.source.buffer(mData.brokeSound);
-      mData.source.play();
+      mData.voice.play(mData.brokeSound);
       return;
     }
 
-    mData.save.v2.score -= item.price;
+    mData.save.v3.score -= item.price;
     mData.save.dirty = true;
     switch(item.kind) {
     case sbs::StoreItem::Lube:
-      mData.save.v2.lubeTier = SDL_max(mData.save.v2.lubeTier, item.argument);
+      mData.save.v3.lubeTier = SDL_max(mData.save.v3.lubeTier, item.argument);
       break;
     case sbs::StoreItem::Gravity:
-      mData.save.v2.gravityTier = SDL_max(mData.save.v2.gravityTier, item.argument);
+      mData.save.v3.gravityTier = SDL_max(mData.save.v3.gravityTier, item.argument);
       break;
     case sbs::StoreItem::Oxy:
-      mData.save.v2.oxyTier = SDL_max(mData.save.v2.oxyTier, item.argument);
+      mData.save.v3.oxyTier = SDL_max(mData.save.v3.oxyTier, item.argument);
       break;
     case sbs::StoreItem::EndGame:
+      mEnded = true;
+      mData.handOff();
       swapStatePtr(getEndState());
       return;
     case sbs::StoreItem::None:
@@ -146,9 +146,7 @@ class StoreSubState: public SubState {
     }
     mPurchaseFloat = mItemHover;
     mItemHover = -1;
-    mData.source.stop();
-    mData.source.buffer(mData.buySound);
-    mData.source.play();
+    mData.voice.play(mData.buySound);
   }
 
   s32 mScroll = 0;
@@ -164,7 +162,7 @@ class StoreSubState: public SubState {
     }
     s32 displayIdx = 0;
     for(const auto &item: mData.config.store) {
-      if(item.prestige > mData.save.v2.prestige) {
+      if(item.prestige > mData.save.v3.prestige) {
         continue;
       }
       if(displayIdx++ == mItemHover) {
@@ -209,6 +207,9 @@ class StoreSubState: public SubState {
   }
 
   bool tick(f32 delta) override {
+    if(mEnded) {
+      return true;
+    }
     if(mPurchaseFloat != cNoPurchaseFloat) {
       mPurchaseFloatTimer += delta;
       if(mPurchaseFloatTimer >= cPurchaseFloatLifetime) {
@@ -219,6 +220,9 @@ class StoreSubState: public SubState {
   }
 
   void render() const override {
+    if(mEnded) {
+      return;
+    }
     render::color(cBgColor);
     render::rect({0, 0, cBgZ}, {1, 1});
 
@@ -230,7 +234,7 @@ class StoreSubState: public SubState {
     s32 displayIdx = 0;
     for(usize i = 0; i < mData.config.store.size(); ++i) {
       const auto &item = mData.config.store[i];
-      if(item.prestige > mData.save.v2.prestige) {
+      if(item.prestige > mData.save.v3.prestige) {
         continue;
       }
       owned = hasItem(item);
@@ -0,0 +1,99 @@
+#include "StringPool.hpp"
+#include "data.hpp"
+#include <cstring>
+
+using namespace nwge;
+
+namespace sbs {
+
+static u32 hashString(StringView string) {
+  u32 hash = 2166136261u;
+  for(char chr: string) {
+    hash = (hash ^ u8(chr)) * 16777619u;
+  }
+  return hash;
+}
+
+void StringPool::Builder::append(StringView string) {
+  mData.append(string.begin(), string.size());
+}
+
+void StringPool::Builder::push(char chr) {
+  mData.push_back(chr);
+}
+
+StringView StringPool::Builder::span(blob::Str str) const {
+  return {mData.data() + str.offset, str.size};
+}
+
+blob::Str StringPool::Builder::commit() {
+  blob::Str str{u32(mStart), u32(mData.size() - mStart)};
+  // keep the table at most half full
+  if((mCount + 1) * 2 > mSlots.size()) {
+    grow();
+  }
+  StringView string = span(str);
+  u32 hash = hashString(string);
+  usize mask = mSlots.size() - 1;
+  for(usize idx = hash & mask;; idx = (idx + 1) & mask) {
+    auto &slot = mSlots[idx];
+    if(!slot.used) {
+      slot = {hash, str, true};
+      ++mCount;
+      mStart = mData.size();
+      return str;
+    }
+    if(slot.hash == hash && slot.span.size == str.size
+    && std::memcmp(mData.data() + slot.span.offset, string.begin(), str.size) == 0) {
+      mData.resize(mStart);
+      ++mDuplicates;
+      return slot.span;
+    }
+  }
+}
+
+void StringPool::Builder::grow() {
+  LoadVector<Slot> old;
+  old.swap(mSlots);
+  mSlots.resize(old.empty() ? 16 : old.size() * 2);
+  usize mask = mSlots.size() - 1;
+  for(const auto &slot: old) {
+    if(!slot.used) {
+      continue;
+    }
+    usize idx = slot.hash & mask;
+    while(mSlots[idx].used) {
+      idx = (idx + 1) & mask;
+    }
+    mSlots[idx] = slot;
+  }
+}
+
+StringPool StringPool::Builder::build() {
+  StringPool pool;
+  pool.mSize = mData.size();
+  if(pool.mSize != 0) {
+    pool.mData = std::make_unique_for_overwrite<char[]>(pool.mSize);
+    std::memcpy(pool.mData.get(), mData.data(), pool.mSize);
+  }
+  mData.clear();
+  mSlots.clear();
+  mCount = 0;
+  mStart = 0;
+  return pool;
+}
+
+bool PooledText::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> raw;
+  if(!readAll(file, raw)) {
+    return false;
+  }
+  StringPool::Builder builder;
+  auto span = builder.add({raw.data(), raw.size()});
+  pool = builder.build();
+  text = pool.view(span);
+  return true;
+}
+
+} // namespace sbs
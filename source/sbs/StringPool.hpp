@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+StringPool.hpp
+--------------
+Read-only text of a data file, interned into one allocation
+*/
+
+#include "arena.hpp"
+#include "blob.hpp"
+#include <memory>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/data/rw.hpp>
+
+namespace sbs {
+
+/* The strings of one data file, back to back in a single allocation, with
+   duplicates stored once. Loaders collect the strings with a Builder, then
+   take views into the built pool; views stay valid as long as the pool lives,
+   even if it is moved. */
+class StringPool {
+public:
+  class Builder {
+  public:
+    /* Appends to the string being built. */
+    void append(nwge::StringView string);
+    void push(char chr);
+
+    /* Ends the string being built and returns its span. If an equal string
+       was committed before, the new copy is dropped and that one's span is
+       returned instead. */
+    blob::Str commit();
+
+    inline blob::Str add(nwge::StringView string) {
+      append(string);
+      return commit();
+    }
+
+    /* strings committed so far which were already in the pool */
+    [[nodiscard]] inline usize duplicates() const {
+      return mDuplicates;
+    }
+
+    /* Copies the strings into the pool. The builder is empty afterwards. */
+    StringPool build();
+
+  private:
+    struct Slot {
+      u32 hash;
+      blob::Str span;
+      bool used;
+    };
+
+    /* allocated from the load arena while a LoadScope is open */
+    LoadString mData;
+    LoadVector<Slot> mSlots;
+    usize mCount = 0;
+    usize mStart = 0;
+    usize mDuplicates = 0;
+
+    [[nodiscard]] nwge::StringView span(blob::Str str) const;
+    void grow();
+  };
+
+  [[nodiscard]] inline nwge::StringView view(blob::Str span) const {
+    return {mData.get() + span.offset, span.size};
+  }
+
+  [[nodiscard]] inline usize size() const {
+    return mSize;
+  }
+
+private:
+  std::unique_ptr<char[]> mData;
+  usize mSize = 0;
+};
+
+/* A text file loaded into its own pool. */
+struct PooledText {
+  StringPool pool;
+  nwge::StringView text;
+
+  bool load(nwge::data::RW &file);
+
+  [[nodiscard]] inline operator nwge::StringView() const {
+    return text;
+  }
+};
+
+} // namespace sbs
@@ -0,0 +1,275 @@
+#include "TextureCache.hpp"
+#include "AssetCache.hpp"
+#include "blob.hpp"
+#include "data.hpp"
+#include "jobs.hpp"
+#include "saves.hpp"
+#include <SDL2/SDL_rwops.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <nwge/cli/cli.h>
+#include <nwge/console.hpp>
+#include <nwge/render/window.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+static constexpr const char *cCacheDir = "textures";
+
+TextureCache &TextureCache::shared() {
+  // intentionally leaked, workers may still be writing to the cache on exit
+  static auto *sCache = new TextureCache(!cli::flag("no-texcache"));
+  return *sCache;
+}
+
+TextureCache::TextureCache(bool enabled) {
+  if(!enabled || saves::userDir().empty()) {
+    return;
+  }
+  std::string dir = saves::userDir() + cCacheDir;
+  std::error_code error;
+  std::filesystem::create_directories(dir, error);
+  if(error) {
+    console::error("Could not create the texture cache at {}: {}", dir, error.message());
+    return;
+  }
+  mDir = dir + '/';
+}
+
+struct Size {
+  u32 width;
+  u32 height;
+};
+
+static Size halved(Size size) {
+  return {std::max<u32>(size.width / 2, 1), std::max<u32>(size.height / 2, 1)};
+}
+
+/* Number of times a texture of the size is halved for the window. */
+static u32 levelFor(Size size, s32 windowExtent) {
+  if(windowExtent <= 0) {
+    return 0;
+  }
+  u32 level = 0;
+  while(std::max(size.width, size.height) / 2 >= u32(windowExtent)
+  && std::min(size.width, size.height) > 1) {
+    size = halved(size);
+    ++level;
+  }
+  return level;
+}
+
+/* Averages each 2x2 block of RGBA pixels. Odd edges reuse their last row or
+   column. */
+static void halve(const u8 *src, Size from, u8 *dst) {
+  auto to = halved(from);
+  usize stride = usize(from.width) * 4;
+  for(u32 y = 0; y < to.height; ++y) {
+    const u8 *row0 = src + usize(y * 2) * stride;
+    const u8 *row1 = src + usize(std::min(y * 2 + 1, from.height - 1)) * stride;
+    for(u32 x = 0; x < to.width; ++x) {
+      usize left = usize(x * 2) * 4;
+      usize right = usize(std::min(x * 2 + 1, from.width - 1)) * 4;
+      for(usize c = 0; c < 4; ++c) {
+        u32 sum = u32(row0[left + c]) + row0[right + c] + row1[left + c] + row1[right + c];
+        *dst++ = u8((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+static Size downscale(const u8 *pixels, Size size, u32 level, std::vector<u8> &out) {
+  std::vector<u8> scratch;
+  for(u32 i = 0; i < level; ++i) {
+    auto next = halved(size);
+    scratch.resize(usize(next.width) * next.height * 4);
+    halve(pixels, size, scratch.data());
+    out.swap(scratch);
+    pixels = out.data();
+    size = next;
+  }
+  return size;
+}
+
+static s32 windowExtent() {
+  auto size = render::windowSize();
+  return s32(std::max(size.x, size.y));
+}
+
+void TextureCache::nq(data::Bundle &bundle, StringView name, render::Texture &out) {
+  auto &upload = mUploads.emplace_back(Upload{
+    .bundle = &bundle,
+    .out = &out,
+    .key = {name.begin(), name.size()},
+    .windowExtent = windowExtent(),
+  });
+  bundle.nqCustom(name, upload);
+}
+
+bool TextureCache::Upload::load(data::RW &file) {
+  loaded = true;
+  if(!readAll(file, decode->file)) {
+    return false;
+  }
+  ready = jobs::submit([decode = decode, key = key, extent = windowExtent]{
+    return shared().prepare(*decode, key, extent);
+  });
+  return true;
+}
+
+/* Reads the cache file into memory here on the worker, so the upload on the
+   main thread never waits for the disk. */
+bool TextureCache::readCached(Decode &decode, const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if(file == nullptr) {
+    return false;
+  }
+  Header header{};
+  bool ok = std::fread(&header, sizeof(Header), 1, file) == 1
+    && std::memcmp(header.magic, cMagic, sizeof(cMagic)) == 0
+    && header.version == cVersion
+    && header.width != 0 && header.height != 0
+    && header.width <= 16384 && header.height <= 16384;
+  auto &image = decode.image;
+  usize size = usize(header.width) * header.height * 4;
+  // a file with more or fewer pixels was most likely cut short by a crash
+  ok = ok && std::fseek(file, 0, SEEK_END) == 0
+    && std::ftell(file) == long(sizeof(Header) + size)
+    && std::fseek(file, sizeof(Header), SEEK_SET) == 0;
+  if(ok) {
+    image.pixels.resize(size);
+    ok = std::fread(image.pixels.data(), 1, size, file) == size;
+  }
+  std::fclose(file);
+  if(!ok) {
+    image.pixels = {};
+    return false;
+  }
+  image.width = header.width;
+  image.height = header.height;
+  return true;
+}
+
+/* Writes the file next to `path` and renames it over, so other runs never see
+   it half-written. A cache file lost to a crash is only decoded again, so
+   nothing is synced. */
+void TextureCache::writeCached(const Decode &decode, const std::string &path) {
+  Header header{};
+  std::memcpy(header.magic, cMagic, sizeof(cMagic));
+  header.version = cVersion;
+  header.width = decode.image.width;
+  header.height = decode.image.height;
+
+  // several bundles may decode the same texture at once
+  auto temp = path + '.' + std::to_string(mTempCounter.fetch_add(1)) + ".tmp";
+  std::FILE *file = std::fopen(temp.c_str(), "wb");
+  if(file == nullptr) {
+    return;
+  }
+  const auto &pixels = decode.image.pixels;
+  bool written = std::fwrite(&header, sizeof(Header), 1, file) == 1
+    && std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+  written = std::fclose(file) == 0 && written;
+  if(!written || std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+  }
+}
+
+bool TextureCache::prepare(Decode &decode, const std::string &key, s32 extent) {
+  auto start = AssetCache::Clock::now();
+  const auto *bytes = reinterpret_cast<const u8*>(decode.file.begin());
+  std::string path;
+  if(!mDir.empty()) {
+    char name[40];
+    std::snprintf(name, sizeof(name), "%08x-%zu.rgba",
+      unsigned(blob::crc32(bytes, decode.file.size())), decode.file.size());
+    path = mDir + name;
+  }
+  if(!path.empty() && readCached(decode, path)) {
+    mHits.fetch_add(1, std::memory_order_relaxed);
+    assetCache().recordTiming(key, "read cache", start);
+  } else {
+    if(!png::decode(viewOf(decode.file), decode.image)) {
+      // left to the engine
+      mMisses.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    assetCache().recordTiming(key, "decode", start);
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+    if(!path.empty()) {
+      start = AssetCache::Clock::now();
+      writeCached(decode, path);
+      assetCache().recordTiming(key, "write cache", start);
+    }
+  }
+  decode.file = {};
+
+  auto &image = decode.image;
+  Size size{image.width, image.height};
+  u32 level = levelFor(size, extent);
+  if(level != 0) {
+    start = AssetCache::Clock::now();
+    std::vector<u8> scaled;
+    auto to = downscale(image.pixels.data(), size, level, scaled);
+    image.pixels = std::move(scaled);
+    image.width = to.width;
+    image.height = to.height;
+    decode.savedBytes = (u64(size.width) * size.height - u64(to.width) * to.height) * 4;
+    assetCache().recordTiming(key, "downscale", start);
+  }
+  return true;
+}
+
+bool TextureCache::ready(const data::Bundle &bundle) const {
+  return std::all_of(mUploads.begin(), mUploads.end(), [&bundle](const auto &upload) {
+    return upload.bundle != &bundle || (upload.loaded
+      && upload.ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+  });
+}
+
+bool TextureCache::finish(data::Bundle &bundle) {
+  bool ok = true;
+  for(auto &upload: mUploads) {
+    if(upload.bundle != &bundle || !upload.loaded) {
+      continue;
+    }
+    auto &decode = *upload.decode;
+    if(upload.ready.get()) {
+      auto start = AssetCache::Clock::now();
+      const auto &image = decode.image;
+      upload.out->replace({s32(image.width), s32(image.height)}, image.pixels.data());
+      assetCache().recordTiming(upload.key, "upload", start);
+      mSavedBytes.fetch_add(decode.savedBytes, std::memory_order_relaxed);
+    } else {
+      // not a PNG this decoder knows, e.g. PR.JPG
+      auto start = AssetCache::Clock::now();
+      data::RW file{SDL_RWFromConstMem(decode.file.begin(), int(decode.file.size()))};
+      if(!upload.out->load(file)) {
+        console::error("Could not load texture {}.", upload.key);
+        ok = false;
+      }
+      assetCache().recordTiming(upload.key, "engine decode", start);
+    }
+    // the GPU has its own copy now
+    decode = {};
+    upload.done = true;
+  }
+  mUploads.remove_if([](const auto &upload) {
+    return upload.done;
+  });
+  return ok;
+}
+
+void TextureCache::drop(const data::Bundle &bundle) {
+  // running workers hold on to their Decode
+  mUploads.remove_if([&bundle](const auto &upload) {
+    return upload.bundle == &bundle;
+  });
+}
+
+} // namespace sbs
@@ -0,0 +1,132 @@
+#pragma once
+
+/*
+TextureCache.hpp
+----------------
+Decoded textures kept on disk, so textures skip image decoding
+*/
+
+#include "png.hpp"
+#include <atomic>
+#include <future>
+#include <list>
+#include <memory>
+#include <string>
+#include <nwge/common/array.hpp>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/data/bundle.hpp>
+#include <nwge/render/Texture.hpp>
+
+namespace sbs {
+
+/* Textures are read from the bundle as they are, then decoded on a worker
+   (see png.hpp). The decoded pixels are written to the texture cache, a
+   directory in the user-data directory, as a Header followed by RGBA rows,
+   top to bottom. Cache files are named after the CRC32 and size of the bundle
+   entry they were decoded from, so they stay valid across bundles and are
+   never used for an entry whose contents changed. The next time, the worker
+   reads the cache file instead of decoding.
+
+   Textures larger than the window are halved with a box filter until they
+   would no longer cover it, since none is ever drawn bigger than the window.
+
+   Nothing is uploaded during the bundle's load: finish() uploads a bundle's
+   textures once its state is ready for them. Files the decoder does not
+   handle are decoded by the engine then, and are never cached. */
+class TextureCache {
+public:
+  static constexpr char cMagic[4] = {'S', 'B', 'S', 'T'};
+  static constexpr u16 cVersion = 1;
+
+  struct Header {
+    char magic[4];
+    u16 version;
+    u16 reserved;
+    u32 width;
+    u32 height;
+  };
+  static_assert(sizeof(Header) == 16);
+
+  /* Pass `--no-texcache` to neither read nor write the cache. */
+  static TextureCache &shared();
+
+  /* Enqueues the texture into the bundle. Once the load has read it, a worker
+     decodes it or reads it from the cache, and downscales it. */
+  void nq(nwge::data::Bundle &bundle, nwge::StringView name, nwge::render::Texture &out);
+
+  /* Whether the textures enqueued into `bundle` have been loaded and are
+     ready to be uploaded without waiting. */
+  [[nodiscard]] bool ready(const nwge::data::Bundle &bundle) const;
+
+  /* Uploads the textures enqueued into `bundle`, waiting for the workers if
+     needed. The engine decodes those the workers could not. Call it on the
+     main thread, after the bundle's load. Returns false if any texture
+     failed. */
+  bool finish(nwge::data::Bundle &bundle);
+
+  /* Forgets the textures enqueued into `bundle` which were not uploaded, e.g.
+     because the bundle is going away before its load. */
+  void drop(const nwge::data::Bundle &bundle);
+
+  [[nodiscard]] inline bool valid() const {
+    return !mDir.empty();
+  }
+
+  /* textures read from the cache, and decoded */
+  [[nodiscard]] inline u32 hits() const {
+    return mHits.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] inline u32 misses() const {
+    return mMisses.load(std::memory_order_relaxed);
+  }
+
+  /* bytes of texture memory downscaling has saved, in uploaded textures */
+  [[nodiscard]] inline u64 savedBytes() const {
+    return mSavedBytes.load(std::memory_order_relaxed);
+  }
+
+private:
+  /* what the worker made of one texture */
+  struct Decode {
+    /* the bundle entry, until it has been decoded */
+    nwge::Array<char> file;
+    /* the pixels as they are uploaded, decoded or read from the cache, then
+       downscaled */
+    png::Image image;
+    /* texture memory the downscale saved, counted once it is uploaded */
+    u64 savedBytes = 0;
+  };
+
+  struct Upload {
+    const nwge::data::Bundle *bundle;
+    nwge::render::Texture *out;
+    std::string key;
+    s32 windowExtent;
+    std::shared_ptr<Decode> decode = std::make_shared<Decode>();
+    /* set once the pixels are ready, false if the engine has to decode */
+    std::shared_future<bool> ready = {};
+    bool loaded = false;
+    bool done = false;
+
+    bool load(nwge::data::RW &file);
+  };
+
+  /* ends with a separator, empty if the cache is not used */
+  std::string mDir;
+  std::list<Upload> mUploads;
+  std::atomic<u32> mHits = 0;
+  std::atomic<u32> mMisses = 0;
+  std::atomic<u64> mSavedBytes = 0;
+  std::atomic<u32> mTempCounter = 0;
+
+  TextureCache(bool enabled);
+
+  /* Runs on a worker. */
+  bool prepare(Decode &decode, const std::string &key, s32 windowExtent);
+  bool readCached(Decode &decode, const std::string &path);
+  void writeCached(const Decode &decode, const std::string &path);
+};
+
+} // namespace sbs
@@ -1,6 +1,11 @@
+#include "AssetCache.hpp"
+#include "JsonReader.hpp"
 #include "Music.hpp"
+#include "arena.hpp"
+#include "blob.hpp"
+#include "data.hpp"
+#include "startup.hpp"
 #include "states.hpp"
-#include <nwge/data/bundle.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/render/draw.hpp>
 #include <nwge/render/window.hpp>
@@ -13,48 +18,77 @@ namespace sbs {
 
 class WarnState: public State {
 private:
-  data::Bundle mBundle;
-  render::Font mFont;
+  CachedBundle mBundle;
+  AssetHandle<render::Font> mFont;
   audio::Source mBoomSource;
-  audio::Buffer mBoomBuffer;
+  AssetHandle<Unpacked<audio::Buffer>> mBoomBuffer;
 
   render::Texture mLogoTexture;
 
   struct Warnings {
-    String<> warning;
+    StringView warning;
+    String<> ownedWarning;
 
-    bool load(data::RW &file) {
-      ScratchArray<char> raw{usize(file.size())};
-      if(!file.read(raw.view())) {
-        return false;
-      }
+    blob::CompiledFile file{blob::Warnings};
 
-      auto res = json::parse(raw.view());
-      if(res.error != json::OK) {
-        dialog::error("Error", "JSON parsing error: {}", json::errorMessage(res.error));
-        return false;
-      }
+    Warnings() {
+      file.onLoaded = [this]{
+        LoadScope scope;
+        if(file.view.has_value()) {
+          return parseBlob(*file.view);
+        }
+        bool ok = parse(file.text());
+        file.bytes = {};
+        file.mapped = {};
+        return ok;
+      };
+    }
 
-      if(!res.value->isArray()) {
-        dialog::error("Error", "JSON parsing error: expected array");
+    bool parseBlob(const blob::View &view) {
+      if(view.count() == 0 || !view.fits<blob::Str>(0, view.count())) {
+        dialog::error("Error", "Compiled warnings are invalid");
         return false;
       }
+      std::random_device randDev;
+      std::mt19937 randGen(randDev());
+      std::uniform_int_distribution<usize> randDist(0, view.count()-1);
+      // points into the blob, which stays in `file` or in the pak
+      warning = view.string(view.record<blob::Str>(randDist(randGen) * sizeof(blob::Str)));
+      return true;
+    }
 
-      auto array = res.value->array();
-      if(array.empty()) {
-        dialog::error("Error", "JSON parsing error: expected at least one element");
+    /* Picks one warning by reservoir sampling while walking the array, so
+       neither a tree nor the other warnings are kept. */
+    bool parse(StringView raw) {
+      JsonReader reader{raw};
+      if(!reader.beginArray()) {
+        dialog::error("Error", "JSON parsing error: expected array");
         return false;
       }
 
       std::random_device randDev;
       std::mt19937 randGen(randDev());
-      std::uniform_int_distribution<usize> randDist(0, array.size()-1);
-      const auto &warnV = array[randDist(randGen)];
-      if(!warnV.isString()) {
-        dialog::error("Error", "JSON parsing error: expected string");
+      usize seen = 0;
+      while(reader.nextElement()) {
+        StringView candidate;
+        if(!reader.readString(candidate)) {
+          break;
+        }
+        ++seen;
+        // keeps each of the `seen` warnings so far with probability 1/seen
+        if(std::uniform_int_distribution<usize>{0, seen - 1}(randGen) == 0) {
+          ownedWarning = candidate;
+        }
+      }
+      if(!reader.finish()) {
+        dialog::error("Error", "JSON parsing error: {}", reader.error());
+        return false;
+      }
+      if(seen == 0) {
+        dialog::error("Error", "JSON parsing error: expected at least one element");
         return false;
       }
-      warning = warnV.string();
+      warning = ownedWarning;
       return true;
     }
   } mWarnings;
@@ -85,24 +119,39 @@ class WarnState: public State {
     cContinueTextFadeInEnd = 6.0f,
     cFadeOutTime = 1.0f;
 
+  /* handed on to the intro and menu, which play it */
   Music mMusic;
 
 public:
   bool preload() override {
     mBundle
-      .load({"sbs.bndl"})
-      .nqFont("GrapeSoda.cfn", mFont)
-      .nqCustom("boom.wav", mBoomBuffer)
-      .nqCustom("warnings.json", mWarnings)
-      .nqTexture("logo1.png", mLogoTexture);
-    mBoomBuffer.label("boom buffer");
+      .nqFont("GrapeSoda.cfn"_sv, mFont)
+      .nqCustom("boom.wav"_sv, mBoomBuffer)
+      // parsed on worker threads while the warning is up
+      .nqManifest(gMenuManifest, AssetManifest::cData);
+    if(mWarnings.file.openMapped("warnings.json"_sv, "warnings.bin"_sv)) {
+      if(!mWarnings.file.onLoaded()) {
+        return false;
+      }
+    } else {
+      mBundle.raw()
+        .nqCustom("warnings.bin", mWarnings.file.blobLoader)
+        .nqCustom("warnings.json", mWarnings.file.sourceLoader);
+    }
+    TextureCache::shared().nq(mBundle.raw(), "logo1.png"_sv, mLogoTexture);
+    mBoomBuffer->value.label("boom buffer");
     mBoomSource.label("boom source");
-    mMusic.nq(mBundle);
+    mMusic.nq(mBundle.raw(), "GROOVY.WAV"_sv);
     return true;
   }
 
   bool init() override {
-    mBoomSource.buffer(mBoomBuffer);
+    // not wait(), the menu's data files may keep parsing while this is up
+    if(!TextureCache::shared().finish(mBundle.raw())) {
+      return false;
+    }
+    reportStartup();
+    mBoomSource.buffer(mBoomBuffer->value);
     return true;
   }
 
@@ -152,19 +201,19 @@ class WarnState: public State {
     render::clear({0, 0, 0});
 
     if(mBigText) {
-      auto measure = mFont.measure("WARNING", cBigTextH);
+      auto measure = mFont->measure("WARNING", cBigTextH);
       f32 textX = 0.5f - measure.x / 2;
       render::color(cBigTextColor);
-      mFont.draw("WARNING", {textX, cBigTextY, 0.5f}, cBigTextH);
+      mFont->draw("WARNING", {textX, cBigTextY, 0.5f}, cBigTextH);
     } else {
       return;
     }
 
     if(mSmallText) {
-      auto measure = mFont.measure(mWarnings.warning, cSmallTextH);
+      auto measure = mFont->measure(mWarnings.warning, cSmallTextH);
       f32 textX = 0.5f - measure.x / 2;
       render::color(cSmallTextColor);
-      mFont.draw(mWarnings.warning, {textX, cSmallTextY, 0.5f}, cSmallTextH);
+      mFont->draw(mWarnings.warning, {textX, cSmallTextY, 0.5f}, cSmallTextH);
     } else {
       return;
     }
@@ -173,14 +222,14 @@ class WarnState: public State {
       return;
     }
 
-    auto measure = mFont.measure("Click to continue", cContinueTextH);
+    auto measure = mFont->measure("Click to continue", cContinueTextH);
     f32 textX = cContinueTextX - measure.x;
     f32 alpha = 1.0f;
     if(mTimer < cContinueTextFadeInEnd) {
       alpha = (mTimer - cContinueTextFadeInBegin) / (cContinueTextFadeInEnd - cContinueTextFadeInBegin);
     }
     render::color({1, 1, 1, alpha});
-    mFont.draw("Click to continue", {textX, cContinueTextY, 0.5f}, cContinueTextH);
+    mFont->draw("Click to continue", {textX, cContinueTextY, 0.5f}, cContinueTextH);
 
     if(mFadeOutTimer >= 0.0f) {
       render::color({0, 0, 0, mFadeOutTimer});
@@ -0,0 +1,229 @@
+#include "adpcm.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace sbs::adpcm {
+
+static constexpr std::array<s32, 89> cSteps{
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767,
+};
+static constexpr s32 cMaxIndex = cSteps.size() - 1;
+
+/* index change for each code, without its sign bit */
+static constexpr std::array<s32, 8> cIndexDeltas{-1, -1, -1, -1, 2, 4, 6, 8};
+
+namespace {
+
+struct State {
+  s32 predictor = 0;
+  s32 index = 0;
+
+  s16 decode(u8 code) {
+    s32 step = cSteps[index];
+    s32 diff = step >> 3;
+    if(code & 4) {
+      diff += step;
+    }
+    if(code & 2) {
+      diff += step >> 1;
+    }
+    if(code & 1) {
+      diff += step >> 2;
+    }
+    predictor += (code & 8) ? -diff : diff;
+    predictor = std::clamp(predictor, -32768, 32767);
+    index = std::clamp(index + cIndexDeltas[code & 7], 0, cMaxIndex);
+    return s16(predictor);
+  }
+
+  u8 encode(s16 sample) {
+    s32 diff = sample - predictor;
+    u8 code = 0;
+    if(diff < 0) {
+      code = 8;
+      diff = -diff;
+    }
+    s32 step = cSteps[index];
+    for(u8 bit = 4; bit != 0; bit >>= 1) {
+      if(diff >= step) {
+        code |= bit;
+        diff -= step;
+      }
+      step >>= 1;
+    }
+    // decode the code again, so the encoder tracks what the decoder will see
+    decode(code);
+    return code;
+  }
+};
+
+} // namespace
+
+void encode(const s16 *samples, usize count, std::vector<u8> &out) {
+  usize blocks = (count + cBlockSamples - 1) / cBlockSamples;
+  out.assign(blocks * cBlockSize, 0);
+  State state;
+  for(usize block = 0; block < blocks; ++block) {
+    usize first = block * cBlockSamples;
+    auto sampleAt = [&](usize idx) {
+      return samples[std::min(idx, count - 1)];
+    };
+
+    u8 *data = out.data() + block * cBlockSize;
+    state.predictor = sampleAt(first);
+    auto header = s16(state.predictor);
+    std::memcpy(data, &header, sizeof(header));
+    data[2] = u8(state.index);
+    data += cHeaderSize;
+    for(usize i = 1; i < cBlockSamples; i += 2) {
+      u8 low = state.encode(sampleAt(first + i));
+      u8 high = state.encode(sampleAt(first + i + 1));
+      *data++ = u8(low | (high << 4));
+    }
+  }
+}
+
+void decodeBlock(const u8 *block, s16 *out) {
+  State state;
+  s16 first;
+  std::memcpy(&first, block, sizeof(first));
+  state.predictor = first;
+  state.index = std::min<s32>(block[2], cMaxIndex);
+  *out++ = first;
+  for(usize i = cHeaderSize; i < cBlockSize; ++i) {
+    *out++ = state.decode(block[i] & 0xF);
+    *out++ = state.decode(block[i] >> 4);
+  }
+}
+
+/* One s32 per block. The compiler lowers these to SSE2 or NEON. */
+using Lanes = s32 __attribute__((vector_size(sizeof(s32) * cLanes)));
+
+/* `value` where `mask` is set, `other` elsewhere */
+static inline Lanes select(Lanes mask, Lanes value, Lanes other) {
+  return (value & mask) | (other & ~mask);
+}
+
+void decodeBlocks(const u8 *blocks, s16 *out) {
+  Lanes predictor;
+  Lanes index;
+  for(usize lane = 0; lane < cLanes; ++lane) {
+    const u8 *block = blocks + lane * cBlockSize;
+    s16 first;
+    std::memcpy(&first, block, sizeof(first));
+    predictor[lane] = first;
+    index[lane] = std::min<s32>(block[2], cMaxIndex);
+    out[lane * cBlockSamples] = first;
+  }
+
+  // kept side by side while decoding, and only split into blocks at the end
+  std::array<Lanes, cBlockSamples> decoded;
+  const Lanes zero{};
+  auto step = [&](Lanes code, usize sample) {
+    static_assert(cLanes == 4);
+    Lanes stepSize{
+      cSteps[index[0]], cSteps[index[1]], cSteps[index[2]], cSteps[index[3]]};
+    // every bit of the code adds a fraction of the step, without branching
+    Lanes diff = stepSize >> 3;
+    diff += stepSize & -((code >> 2) & 1);
+    diff += (stepSize >> 1) & -((code >> 1) & 1);
+    diff += (stepSize >> 2) & -(code & 1);
+    Lanes negative = -((code >> 3) & 1);
+    predictor += (diff ^ negative) - negative;
+    predictor = select(predictor > 32767, zero + 32767, predictor);
+    predictor = select(predictor < -32768, zero - 32768, predictor);
+
+    // codes 4 to 7 step up by 2, 4, 6 or 8, the rest down by 1
+    Lanes up = -((code >> 2) & 1);
+    index += select(up, (code & 3) * 2 + 2, zero - 1);
+    index = select(index < 0, zero, index);
+    index = select(index > cMaxIndex, zero + cMaxIndex, index);
+
+    decoded[sample] = predictor;
+  };
+
+  for(usize i = cHeaderSize; i < cBlockSize; ++i) {
+    Lanes bytes{
+      blocks[i], blocks[cBlockSize + i],
+      blocks[2 * cBlockSize + i], blocks[3 * cBlockSize + i]};
+    usize sample = (i - cHeaderSize) * 2 + 1;
+    step(bytes & 0xF, sample);
+    step(bytes >> 4, sample + 1);
+  }
+  for(usize lane = 0; lane < cLanes; ++lane) {
+    s16 *blockOut = out + lane * cBlockSamples;
+    for(usize sample = 1; sample < cBlockSamples; ++sample) {
+      blockOut[sample] = s16(decoded[sample][lane]);
+    }
+  }
+}
+
+bool check() {
+  Checks checks{"IMA-ADPCM"};
+
+  // any bytes are a valid block, including step indices past the table and
+  // codes that clamp the predictor
+  std::vector<u8> blocks(cLanes * cBlockSize);
+  std::array<s16, cLanes * cBlockSamples> scalar{};
+  std::array<s16, cLanes * cBlockSamples> lanes{};
+  u32 seed = 12345;
+  bool same = true;
+  for(usize round = 0; round < 64; ++round) {
+    for(auto &byte: blocks) {
+      seed = seed * 1664525u + 1013904223u;
+      byte = u8(seed >> 24);
+    }
+    if(round % 2 == 1) {
+      // runs of the largest codes, which saturate
+      std::fill(blocks.begin() + cHeaderSize, blocks.begin() + cBlockSize, u8(0x77));
+      std::fill(blocks.begin() + cBlockSize + cHeaderSize, blocks.begin() + 2 * cBlockSize, u8(0xFF));
+    }
+    for(usize lane = 0; lane < cLanes; ++lane) {
+      decodeBlock(blocks.data() + lane * cBlockSize, scalar.data() + lane * cBlockSamples);
+    }
+    decodeBlocks(blocks.data(), lanes.data());
+    same = same && scalar == lanes;
+  }
+  checks.expect(same, "SIMD decoder matches the scalar one");
+
+  // a tone that swells, as loud as 16 bits go
+  static constexpr usize cCount = cBlockSamples * 5 + 17;
+  std::vector<s16> samples(cCount);
+  for(usize i = 0; i < cCount; ++i) {
+    f64 amplitude = 32767.0 * f64(i) / f64(cCount);
+    samples[i] = s16(amplitude * std::sin(f64(i) * 0.07));
+  }
+  std::vector<u8> encoded;
+  encode(samples.data(), cCount, encoded);
+  usize blockCount = encoded.size() / cBlockSize;
+  checks.expect(blockCount == 6 && encoded.size() % cBlockSize == 0, "encodes into whole blocks");
+  std::vector<s16> decoded(blockCount * cBlockSamples);
+  for(usize block = 0; block < blockCount; ++block) {
+    decodeBlock(encoded.data() + block * cBlockSize, decoded.data() + block * cBlockSamples);
+  }
+  // the step adapts at the start of the sound, after that it keeps up
+  s32 worst = 0;
+  for(usize i = 64; i < cCount; ++i) {
+    worst = std::max(worst, std::abs(s32(decoded[i]) - s32(samples[i])));
+  }
+  checks.expect(worst < 2048, "decodes close to the original");
+  bool starts = true;
+  for(usize block = 0; block < blockCount; ++block) {
+    usize first = block * cBlockSamples;
+    starts = starts && decoded[first] == samples[std::min(first, cCount - 1)];
+  }
+  checks.expect(starts, "blocks start on their exact first sample");
+  return checks.finish();
+}
+
+} // namespace sbs::adpcm
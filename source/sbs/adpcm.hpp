@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+adpcm.hpp
+---------
+IMA-ADPCM, the compressed format sound effects are kept in
+*/
+
+#include <vector>
+#include <nwge/common/def.h>
+
+namespace sbs::adpcm {
+
+/* Mono IMA-ADPCM in WAV's block layout: each block starts with its first
+   sample and step index, followed by 4-bit codes, low nibble first. Blocks
+   carry their own decoder state, so any block decodes on its own. */
+static constexpr usize cBlockSize = 256;
+static constexpr usize cHeaderSize = 4;
+static constexpr usize cBlockSamples = (cBlockSize - cHeaderSize) * 2 + 1;
+
+/* blocks decodeBlocks decodes at once, one per SIMD lane */
+static constexpr usize cLanes = 4;
+
+/* Encodes mono 16-bit samples into whole blocks. The last block is padded
+   with its last sample. */
+void encode(const s16 *samples, usize count, std::vector<u8> &out);
+
+/* Decodes one block into cBlockSamples samples. */
+void decodeBlock(const u8 *block, s16 *out);
+
+/* Decodes cLanes consecutive blocks into cLanes * cBlockSamples samples,
+   stepping through them side by side. */
+void decodeBlocks(const u8 *blocks, s16 *out);
+
+/* Checks that decodeBlocks() matches decodeBlock() exactly, and that encoded
+   sound decodes close to the original. For the sbs.check console command. */
+bool check();
+
+} // namespace sbs::adpcm
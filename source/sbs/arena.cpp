@@ -0,0 +1,53 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace sbs {
+
+void *Arena::alloc(usize size, usize align) {
+  usize start = mOffset + (-mOffset & (align - 1));
+  if(mBlocks.empty() || start + size > mBlocks.back().size) {
+    // oversized allocations get a block of their own
+    usize blockSize = std::max(cBlockSize, size + align);
+    mBlocks.push_back({std::make_unique<std::byte[]>(blockSize), blockSize});
+    auto address = reinterpret_cast<uintptr_t>(mBlocks.back().data.get());
+    start = -address & (align - 1);
+  }
+  mOffset = start + size;
+  ++mAllocations;
+  mUsed += size;
+  return mBlocks.back().data.get() + start;
+}
+
+void Arena::reset() {
+  if(mBlocks.size() > 1) {
+    mBlocks.erase(mBlocks.begin() + 1, mBlocks.end());
+  }
+  mOffset = 0;
+  mAllocations = 0;
+  mUsed = 0;
+}
+
+static thread_local Arena *gLoadArena = nullptr;
+static thread_local s32 gLoadDepth = 0;
+
+Arena *loadArena() {
+  return gLoadArena;
+}
+
+LoadScope::LoadScope() {
+  if(gLoadDepth++ == 0) {
+    // one arena per thread, kept for the thread's lifetime
+    static thread_local Arena sArena;
+    gLoadArena = &sArena;
+  }
+}
+
+LoadScope::~LoadScope() {
+  if(--gLoadDepth == 0) {
+    gLoadArena->reset();
+    gLoadArena = nullptr;
+  }
+}
+
+} // namespace sbs
@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+arena.hpp
+---------
+Bump allocation for scratch memory used while a loader runs
+*/
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* Hands out memory from large blocks and frees it all at once in reset(), so a
+   loader's many short-lived allocations cost a pointer bump each. */
+class Arena {
+public:
+  static constexpr usize cBlockSize = usize(32) * 1024;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena(Arena&&) = delete;
+  Arena &operator=(const Arena&) = delete;
+  Arena &operator=(Arena&&) = delete;
+  ~Arena() = default;
+
+  void *alloc(usize size, usize align);
+
+  /* Frees everything allocated so far. The first block is kept for the next
+     load. */
+  void reset();
+
+  /* allocations and bytes handed out since the last reset */
+  [[nodiscard]] inline usize allocations() const {
+    return mAllocations;
+  }
+
+  [[nodiscard]] inline usize used() const {
+    return mUsed;
+  }
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    usize size;
+  };
+
+  std::vector<Block> mBlocks;
+  /* offset of the free space in the last block */
+  usize mOffset = 0;
+  usize mAllocations = 0;
+  usize mUsed = 0;
+};
+
+/* The arena of the load running on this thread, or null if no LoadScope is
+   open on it. */
+Arena *loadArena();
+
+/* Marks a load in progress on the calling thread. LoadVectors and LoadStrings
+   made while a scope is open allocate from the thread's arena, which is reset
+   once the outermost scope closes, so they must not outlive the scope. Made
+   outside of a scope, they use the heap. */
+class LoadScope {
+public:
+  LoadScope();
+  LoadScope(const LoadScope&) = delete;
+  LoadScope(LoadScope&&) = delete;
+  LoadScope &operator=(const LoadScope&) = delete;
+  LoadScope &operator=(LoadScope&&) = delete;
+  ~LoadScope();
+};
+
+template<typename T>
+class LoadAllocator {
+public:
+  using value_type = T;
+
+  LoadAllocator()
+    : mArena(loadArena())
+  {}
+
+  template<typename U>
+  LoadAllocator(const LoadAllocator<U> &other)
+    : mArena(other.mArena)
+  {}
+
+  T *allocate(usize count) {
+    if(mArena == nullptr) {
+      return std::allocator<T>{}.allocate(count);
+    }
+    return static_cast<T*>(mArena->alloc(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *ptr, usize count) {
+    // arena memory is only freed by the reset
+    if(mArena == nullptr) {
+      std::allocator<T>{}.deallocate(ptr, count);
+    }
+  }
+
+  template<typename U>
+  bool operator==(const LoadAllocator<U> &other) const {
+    return mArena == other.mArena;
+  }
+
+private:
+  template<typename U>
+  friend class LoadAllocator;
+
+  Arena *mArena;
+};
+
+template<typename T>
+using LoadVector = std::vector<T, LoadAllocator<T>>;
+
+using LoadString = std::basic_string<char, std::char_traits<char>, LoadAllocator<char>>;
+
+} // namespace sbs
@@ -0,0 +1,42 @@
+#include "bench.hpp"
+#include <cstdlib>
+#include <new>
+
+/* the innermost AllocationCounter of the thread, if any */
+static thread_local u64 *gCounter = nullptr;
+
+#ifdef DEBUG
+
+void *operator new(usize size) {
+  if(gCounter != nullptr) {
+    ++*gCounter;
+  }
+  if(void *ptr = std::malloc(size != 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] usize size) noexcept {
+  std::free(ptr);
+}
+
+#endif
+
+namespace sbs {
+
+AllocationCounter::AllocationCounter()
+  : mOuter(gCounter)
+{
+  gCounter = &mCount;
+}
+
+AllocationCounter::~AllocationCounter() {
+  gCounter = mOuter;
+}
+
+} // namespace sbs
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+bench.hpp
+---------
+Helpers for the console benchmark commands
+*/
+
+#include <chrono>
+#include <nwge/common/def.h>
+#include <nwge/console.hpp>
+
+namespace sbs {
+
+/* Counts the heap allocations made on the calling thread while it is alive.
+   Only debug builds count them, through their operator new; elsewhere the
+   count stays 0. Counters may be nested, only the innermost one counts. */
+class AllocationCounter {
+public:
+#ifdef DEBUG
+  static constexpr bool cSupported = true;
+#else
+  static constexpr bool cSupported = false;
+#endif
+
+  AllocationCounter();
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter(AllocationCounter&&) = delete;
+  AllocationCounter &operator=(const AllocationCounter&) = delete;
+  AllocationCounter &operator=(AllocationCounter&&) = delete;
+  ~AllocationCounter();
+
+  [[nodiscard]] inline u64 count() const {
+    return mCount;
+  }
+
+private:
+  u64 mCount = 0;
+  u64 *mOuter;
+};
+
+struct BenchResult {
+  f64 micros = 0;      // per iteration
+  f64 allocations = 0; // heap allocations per iteration, debug builds only
+};
+
+/* Runs `fn` `iterations` times. Returns false as soon as `fn` does. */
+template<typename Fn>
+bool bench(usize iterations, BenchResult &out, Fn &&fn) {
+  using Clock = std::chrono::steady_clock;
+  AllocationCounter allocations;
+  auto start = Clock::now();
+  for(usize i = 0; i < iterations; ++i) {
+    if(!fn()) {
+      return false;
+    }
+  }
+  auto time = std::chrono::duration<f64, std::micro>(Clock::now() - start);
+  out.micros = time.count() / f64(iterations);
+  out.allocations = f64(allocations.count()) / f64(iterations);
+  return true;
+}
+
+inline void printBench(const char *label, const BenchResult &result) {
+  nwge::console::print("  {:<28} {:8.2f}us {:8.1f} allocations", label,
+    result.micros, result.allocations);
+}
+
+} // namespace sbs
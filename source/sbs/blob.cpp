@@ -0,0 +1,164 @@
+#include "blob.hpp"
+#include "check.hpp"
+#include "data.hpp"
+#include "Pak.hpp"
+#include <array>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <nwge/console.hpp>
+
+using namespace nwge;
+
+namespace sbs::blob {
+
+static constexpr std::array<u32, 256> cCrcTable = []{
+  std::array<u32, 256> table{};
+  for(u32 i = 0; i < 256; ++i) {
+    u32 crc = i;
+    for(s32 bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+    }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+u32 crc32(const void *data, usize size, u32 previous) {
+  const auto *bytes = static_cast<const u8*>(data);
+  u32 crc = previous ^ 0xFFFFFFFFu;
+  for(usize i = 0; i < size; ++i) {
+    crc = cCrcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+std::optional<View> View::open(StringView bytes, Kind kind, usize sourceSize,
+  StringView source)
+{
+  if(bytes.size() < sizeof(Header)) {
+    return {};
+  }
+  View view;
+  std::memcpy(&view.mHeader, bytes.begin(), sizeof(Header));
+  const auto &header = view.mHeader;
+  if(std::memcmp(header.magic, cMagic, sizeof(cMagic)) != 0
+  || header.version != cVersion
+  || header.kind != kind
+  || header.sourceSize != sourceSize
+  || header.payloadSize != bytes.size() - sizeof(Header)) {
+    return {};
+  }
+  view.mPayload = bytes.begin() + sizeof(Header);
+  if(crc32(view.mPayload, header.payloadSize) != header.payloadCrc) {
+    return {};
+  }
+  // an edit that keeps the size would slip past the size check alone
+  if(crc32(source.begin(), source.size()) != header.sourceCrc) {
+    return {};
+  }
+  return view;
+}
+
+StringView View::string(Str str) const {
+  if(str.offset > mHeader.payloadSize || str.size > mHeader.payloadSize - str.offset) {
+    return {};
+  }
+  return {mPayload + str.offset, str.size};
+}
+
+bool CompiledFile::openMapped(StringView source, StringView blobName) {
+  const auto &pak = Pak::shared();
+  auto sourceEntry = pak.find({source.begin(), source.size()});
+  if(!sourceEntry.has_value()) {
+    return false;
+  }
+  if(auto blobEntry = pak.find({blobName.begin(), blobName.size()})) {
+    view = View::open(*blobEntry, kind, sourceEntry->size(), *sourceEntry);
+  }
+  if(!view.has_value()) {
+    mapped = *sourceEntry;
+  }
+  return true;
+}
+
+bool CompiledFile::BlobLoader::load(data::RW &rw) {
+  // a missing or unreadable blob is not an error, the source is used instead
+  if(!readAll(rw, file->bytes)) {
+    file->bytes = {};
+  }
+  return true;
+}
+
+bool CompiledFile::SourceLoader::load(data::RW &rw) {
+  s64 sourceSize = rw.size();
+  Array<char> source;
+  if(!readAll(rw, source)) {
+    return false;
+  }
+  if(sourceSize >= 0) {
+    file->view = View::open(viewOf(file->bytes), file->kind, usize(sourceSize),
+      viewOf(source));
+  }
+  if(!file->view.has_value()) {
+    console::note("Compiled data file is missing or stale, parsing the JSON source.");
+    file->bytes = std::move(source);
+  }
+  if(file->onLoaded) {
+    return file->onLoaded();
+  }
+  return true;
+}
+
+bool check() {
+  Checks checks{"SBSB blobs"};
+  checks.expect(crc32("123456789", 9) == 0xCBF43926u, "CRC32 of the check string");
+  checks.expect(crc32("6789", 4, crc32("12345", 5)) == 0xCBF43926u, "continued CRC32");
+
+  // a Reviews blob with one review
+  std::string_view source = R"({"reviews": ["Good"]})";
+  std::string payload(sizeof(Str), '\0');
+  Str review{sizeof(Str), 4};
+  std::memcpy(payload.data(), &review, sizeof(Str));
+  payload += "Good";
+  Header header{};
+  std::memcpy(header.magic, cMagic, sizeof(cMagic));
+  header.version = cVersion;
+  header.kind = Reviews;
+  header.sourceSize = u32(source.size());
+  header.sourceCrc = crc32(source.data(), source.size());
+  header.payloadSize = u32(payload.size());
+  header.payloadCrc = crc32(payload.data(), payload.size());
+  header.count = 1;
+  std::string bytes(reinterpret_cast<const char*>(&header), sizeof(Header));
+  bytes += payload;
+
+  auto open = [&source](const std::string &blob, Kind kind = Reviews) {
+    return View::open({blob.data(), blob.size()}, kind, source.size(),
+      {source.data(), source.size()});
+  };
+  auto view = open(bytes);
+  if(checks.expect(view.has_value() && view->count() == 1, "opens the blob")) {
+    auto text = view->string(view->record<Str>(0));
+    checks.expect(std::string_view{text.begin(), text.size()} == "Good", "reads the string back");
+  }
+  checks.expect(!open(bytes, Config).has_value(), "rejects the wrong kind");
+  checks.expect(!open(bytes.substr(0, bytes.size() - 1)).has_value(), "rejects a truncated blob");
+
+  bool allCaught = true;
+  for(usize i = sizeof(Header); i < bytes.size(); ++i) {
+    std::string damaged = bytes;
+    damaged[i] = char(damaged[i] ^ 0x20);
+    allCaught = allCaught && !open(damaged).has_value();
+  }
+  checks.expect(allCaught, "rejects every damaged payload byte");
+
+  std::string otherSource{source};
+  otherSource.replace(otherSource.find("Good"), 4, "Food");
+  checks.expect(!View::open({bytes.data(), bytes.size()}, Reviews, otherSource.size(),
+    {otherSource.data(), otherSource.size()}).has_value(),
+    "rejects a blob of a source edited to the same size");
+  return checks.finish();
+}
+
+} // namespace sbs::blob
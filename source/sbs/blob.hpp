@@ -0,0 +1,174 @@
+#pragma once
+
+/*
+blob.hpp
+--------
+Compiled data files
+
+The bundle step (see source/bndl/plug.py) compiles the JSON data files into
+flat little-endian blobs: a header, a table of fixed-size records and the string
+data the records point into. The layouts below must be kept in sync with the
+plugin. Bump cVersion whenever they change.
+*/
+
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <nwge/common/array.hpp>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+#include <nwge/data/rw.hpp>
+
+namespace sbs::blob {
+
+static constexpr u16 cVersion = 1;
+static constexpr char cMagic[4] = {'S', 'B', 'S', 'B'};
+
+enum Kind: u16 {
+  Config = 1,
+  Reviews = 2,
+  Warnings = 3,
+};
+
+struct Header {
+  char magic[4];
+  u16 version;
+  u16 kind;
+  u32 sourceSize;  // size of the bundle entry of the JSON file it came from
+  u32 sourceCrc;   // CRC32 of that JSON file
+  u32 payloadSize; // everything after the header
+  u32 payloadCrc;  // CRC32 of the payload
+  u32 count;       // number of records in the table
+  u32 reserved;
+};
+static_assert(sizeof(Header) == 32);
+
+/* string in the payload, offset is relative to the start of the payload */
+struct Str {
+  u32 offset;
+  u32 size;
+};
+static_assert(sizeof(Str) == 8);
+
+/* Config: one ConfigRecord followed by `count` StoreItemRecords */
+struct ConfigRecord {
+  Str xDotCom;
+  Str discord;
+  f32 lubeBase, lubeUpgrade;
+  s32 lubeMaxTier;
+  f32 gravityBase, gravityUpgrade, gravityThreshold;
+  s32 gravityMaxTier;
+  f32 oxyRegenFast, oxyRegenSlow, oxyDrain, oxyMin, oxyCooldown;
+  f32 toiletXPos, toiletYPos, toiletSize;
+  f32 shitterXPos, shitterYPos, shitterWidth, shitterHeight;
+  f32 brickXPos, brickStartY, brickEndY, brickFallSpeed, brickSize;
+  f32 waterMinX, waterMaxX, waterMinY, waterMaxY, waterWidth, waterHeight,
+      waterScissorX, waterScissorY, waterScissorW, waterScissorH;
+};
+static_assert(sizeof(ConfigRecord) == 152);
+
+struct StoreItemRecord {
+  s16 kind;
+  s16 argument;
+  s16 price;
+  s16 icon;
+  s32 prestige;
+  Str name;
+  Str desc;
+};
+static_assert(sizeof(StoreItemRecord) == 28);
+
+/* Reviews and Warnings: `count` Strs. Reviews are stored already formatted. */
+
+/* CRC32 as zlib computes it. Pass the CRC of the data before `data` as
+   `previous` to continue it. */
+u32 crc32(const void *data, usize size, u32 previous = 0);
+
+/* Read-only view of a validated blob. */
+class View {
+public:
+  /* Checks the header and the payload checksum. Returns nothing if the blob is
+     damaged, of the wrong kind or version, or was not compiled from `source`,
+     whose bundle entry is `sourceSize` bytes. */
+  static std::optional<View> open(nwge::StringView bytes, Kind kind, usize sourceSize,
+    nwge::StringView source);
+
+  [[nodiscard]] inline u32 count() const {
+    return mHeader.count;
+  }
+
+  /* Copies out the record at `offset` bytes into the payload. */
+  template<typename T>
+  [[nodiscard]] T record(usize offset) const {
+    T out;
+    std::memcpy(&out, mPayload + offset, sizeof(T));
+    return out;
+  }
+
+  /* View into the blob's string data, valid as long as the blob's bytes are. */
+  [[nodiscard]] nwge::StringView string(Str str) const;
+
+  /* Checks that `count` records of type T fit at `offset`. */
+  template<typename T>
+  [[nodiscard]] bool fits(usize offset, usize count) const {
+    return offset <= mHeader.payloadSize
+      && count <= (mHeader.payloadSize - offset) / sizeof(T);
+  }
+
+private:
+  Header mHeader{};
+  const char *mPayload = nullptr;
+
+  View() = default;
+};
+
+/* Loads a JSON data file, or the blob compiled from it if that is up to date.
+   Try openMapped() first. Otherwise enqueue `blobLoader` before
+   `sourceLoader`: the source is always read to check the blob against, but
+   only parsed if the blob turns out to be missing or stale. */
+struct CompiledFile {
+  Kind kind;
+  nwge::Array<char> bytes;
+  /* JSON source in the pak, used instead of `bytes` */
+  nwge::StringView mapped;
+  /* set if the data is a valid blob rather than the JSON source */
+  std::optional<View> view;
+  /* called once `view` or text() holds the data to parse */
+  std::function<bool()> onLoaded;
+
+  CompiledFile(Kind kind)
+    : kind(kind)
+  {}
+
+  CompiledFile(const CompiledFile&) = delete;
+  CompiledFile(CompiledFile&&) = delete;
+  CompiledFile &operator=(const CompiledFile&) = delete;
+  CompiledFile &operator=(CompiledFile&&) = delete;
+  ~CompiledFile() = default;
+
+  /* Looks the file up in the pak. If it is there, sets `view` or `mapped` and
+     returns true; nothing needs to be read from the bundle then. Does not call
+     `onLoaded`. */
+  bool openMapped(nwge::StringView source, nwge::StringView blobName);
+
+  /* the JSON source, if `view` is not set */
+  [[nodiscard]] inline nwge::StringView text() const {
+    return mapped.size() != 0 ? mapped : nwge::StringView{bytes.begin(), bytes.size()};
+  }
+
+  struct BlobLoader {
+    CompiledFile *file;
+    bool load(nwge::data::RW &rw);
+  } blobLoader{this};
+
+  struct SourceLoader {
+    CompiledFile *file;
+    bool load(nwge::data::RW &rw);
+  } sourceLoader{this};
+};
+
+/* Checks crc32() against known values, and that View::open() reads a blob
+   back and rejects damaged ones. For the sbs.check console command. */
+bool check();
+
+} // namespace sbs::blob
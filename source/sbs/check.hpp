@@ -0,0 +1,44 @@
+#pragma once
+
+/*
+check.hpp
+---------
+Helpers for the sbs.check console command
+*/
+
+#include <nwge/common/def.h>
+#include <nwge/console.hpp>
+
+namespace sbs {
+
+/* Counts the expectations of one format's checks. Failed ones are printed as
+   they happen. */
+class Checks {
+public:
+  explicit Checks(const char *name)
+    : mName(name)
+  {}
+
+  /* Returns `ok`, so a check can stop after a failure it cannot go on from. */
+  bool expect(bool ok, const char *what) {
+    ++mCount;
+    if(!ok) {
+      ++mFailed;
+      nwge::console::error("{}: {}", mName, what);
+    }
+    return ok;
+  }
+
+  /* Prints the tally. Returns whether every expectation held. */
+  bool finish() const {
+    nwge::console::print("  {:<28} {}/{} passed", mName, mCount - mFailed, mCount);
+    return mFailed == 0;
+  }
+
+private:
+  const char *mName;
+  usize mCount = 0;
+  usize mFailed = 0;
+};
+
+} // namespace sbs
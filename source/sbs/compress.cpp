@@ -0,0 +1,569 @@
+#include "compress.hpp"
+#include "arena.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+
+using namespace nwge;
+
+namespace sbs::compress {
+
+bool isPacked(StringView bytes) {
+  return bytes.size() >= sizeof(Header)
+    && std::memcmp(bytes.begin(), cMagic, sizeof(cMagic)) == 0;
+}
+
+bool unpack(StringView packed, Array<char> &out) {
+  usize size;
+  if(!unpackedSize(packed, size)) {
+    return false;
+  }
+  out = Array<char>{size};
+  return unpackInto(packed, out.begin(), out.size());
+}
+
+bool unpackedSize(StringView packed, usize &size) {
+  if(!isPacked(packed)) {
+    return false;
+  }
+  Header header{};
+  std::memcpy(&header, packed.begin(), sizeof(Header));
+  if(header.flags != LZ4 && header.flags != (LZ4 | Delta16)) {
+    return false;
+  }
+  size = header.rawSize;
+  return true;
+}
+
+/* Undoes the Delta16 filter of `size` bytes from `planes` into `out`. */
+static void unfilterDelta16(const u8 *planes, usize size, u8 *out) {
+  usize count = size / 2;
+  const u8 *low = planes;
+  const u8 *high = planes + count;
+  u16 value = 0;
+  for(usize i = 0; i < count; ++i) {
+    value = u16(value + (low[i] | (high[i] << 8)));
+    out[2 * i] = u8(value);
+    out[2 * i + 1] = u8(value >> 8);
+  }
+  if(size % 2 != 0) {
+    out[size - 1] = planes[size - 1];
+  }
+}
+
+bool unpackInto(StringView packed, char *out, usize size) {
+  Header header{};
+  std::memcpy(&header, packed.begin(), sizeof(Header));
+  const auto *src = reinterpret_cast<const u8*>(packed.begin() + sizeof(Header));
+  usize srcSize = packed.size() - sizeof(Header);
+  if((header.flags & Delta16) == 0) {
+    return lz4Decode(src, srcSize, reinterpret_cast<u8*>(out), size);
+  }
+  LoadScope scope;
+  LoadVector<u8> planes(size);
+  if(!lz4Decode(src, srcSize, planes.data(), size)) {
+    return false;
+  }
+  unfilterDelta16(planes.data(), size, reinterpret_cast<u8*>(out));
+  return true;
+}
+
+/* Reads an LZ4 length continuation: bytes are added until one is not 255. */
+static bool readLength(const u8 *&src, const u8 *srcEnd, usize &length) {
+  u8 byte;
+  do {
+    if(src == srcEnd) {
+      return false;
+    }
+    byte = *src++;
+    length += byte;
+  } while(byte == 255);
+  return true;
+}
+
+bool lz4Decode(const u8 *src, usize srcSize, u8 *dst, usize dstSize) {
+  const u8 *srcEnd = src + srcSize;
+  u8 *dstBegin = dst;
+  u8 *dstEnd = dst + dstSize;
+  while(src != srcEnd) {
+    u8 token = *src++;
+
+    usize literals = token >> 4;
+    if(literals == 15 && !readLength(src, srcEnd, literals)) {
+      return false;
+    }
+    if(literals > usize(srcEnd - src) || literals > usize(dstEnd - dst)) {
+      return false;
+    }
+    std::memcpy(dst, src, literals);
+    src += literals;
+    dst += literals;
+
+    // the last sequence has no match
+    if(src == srcEnd) {
+      break;
+    }
+
+    if(srcEnd - src < 2) {
+      return false;
+    }
+    usize offset = usize(src[0]) | (usize(src[1]) << 8);
+    src += 2;
+    if(offset == 0 || offset > usize(dst - dstBegin)) {
+      return false;
+    }
+
+    usize length = token & 0xF;
+    if(length == 15 && !readLength(src, srcEnd, length)) {
+      return false;
+    }
+    length += 4;
+    if(length > usize(dstEnd - dst)) {
+      return false;
+    }
+    const u8 *match = dst - offset;
+    if(offset >= length) {
+      std::memcpy(dst, match, length);
+    } else {
+      // the match overlaps its own output, so copy byte by byte
+      for(usize i = 0; i < length; ++i) {
+        dst[i] = match[i];
+      }
+    }
+    dst += length;
+  }
+  return dst == dstEnd;
+}
+
+namespace {
+
+/* Reads the bits of a deflate stream, least significant bit first. Past the
+   end of the input it reads zeros, and remembers that it did. */
+class BitReader {
+public:
+  BitReader(const u8 *src, usize size)
+    : mSrc(src), mEnd(src + size)
+  {}
+
+  /* Peeks at the next `count` bits, at most 32. */
+  u32 peek(u32 count) {
+    refill();
+    return u32(mBits & ((u64(1) << count) - 1));
+  }
+
+  void consume(u32 count) {
+    mBits >>= count;
+    mCount -= count;
+  }
+
+  u32 read(u32 count) {
+    u32 bits = peek(count);
+    consume(count);
+    return bits;
+  }
+
+  /* Drops the bits up to the next byte boundary. */
+  void align() {
+    consume(mCount % 8);
+  }
+
+  /* Copies `size` bytes after align(). */
+  bool copy(u8 *dst, usize size) {
+    while(mCount != 0 && size != 0) {
+      *dst++ = u8(read(8));
+      --size;
+    }
+    if(size > usize(mEnd - mSrc)) {
+      return false;
+    }
+    std::memcpy(dst, mSrc, size);
+    mSrc += size;
+    return true;
+  }
+
+  /* whether more bits were consumed than the input holds */
+  [[nodiscard]] bool overrun() const {
+    return mPadding * 8 > mCount;
+  }
+
+private:
+  const u8 *mSrc;
+  const u8 *mEnd;
+  u64 mBits = 0;
+  u32 mCount = 0;
+  u32 mPadding = 0;
+
+  void refill() {
+    while(mCount <= 56) {
+      u64 byte = 0;
+      if(mSrc != mEnd) {
+        byte = *mSrc++;
+      } else {
+        ++mPadding;
+      }
+      mBits |= byte << mCount;
+      mCount += 8;
+    }
+  }
+};
+
+/* A canonical Huffman code. Codes of up to cFastBits bits are decoded with one
+   table lookup, longer ones bit by bit. */
+class Huffman {
+public:
+  static constexpr u32 cMaxBits = 15;
+  static constexpr u32 cFastBits = 10;
+
+  /* Builds the code from the code length of each symbol. Incomplete codes are
+     allowed, oversubscribed ones are not. */
+  bool build(const u8 *lengths, usize count) {
+    std::memset(mCounts, 0, sizeof(mCounts));
+    for(usize i = 0; i < count; ++i) {
+      ++mCounts[lengths[i]];
+    }
+    mCounts[0] = 0;
+    s32 left = 1;
+    for(u32 len = 1; len <= cMaxBits; ++len) {
+      left = left * 2 - mCounts[len];
+      if(left < 0) {
+        return false;
+      }
+    }
+
+    u16 offsets[cMaxBits + 1];
+    offsets[1] = 0;
+    for(u32 len = 1; len < cMaxBits; ++len) {
+      offsets[len + 1] = u16(offsets[len] + mCounts[len]);
+    }
+    for(usize i = 0; i < count; ++i) {
+      if(lengths[i] != 0) {
+        mSymbols[offsets[lengths[i]]++] = u16(i);
+      }
+    }
+
+    std::memset(mFast, 0, sizeof(mFast));
+    u32 code = 0;
+    usize index = 0;
+    for(u32 len = 1; len <= cFastBits; ++len) {
+      for(u32 i = 0; i < mCounts[len]; ++i, ++code, ++index) {
+        // codes are stored most significant bit first
+        u32 reversed = 0;
+        for(u32 bit = 0; bit < len; ++bit) {
+          reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+        }
+        u16 entry = u16((mSymbols[index] << 4) | len);
+        for(u32 fill = reversed; fill < (1u << cFastBits); fill += 1u << len) {
+          mFast[fill] = entry;
+        }
+      }
+      code <<= 1;
+    }
+    return true;
+  }
+
+  /* Returns the next symbol, or -1 if the bits are not a code. */
+  s32 decode(BitReader &bits) const {
+    u16 entry = mFast[bits.peek(cFastBits)];
+    if(entry != 0) {
+      bits.consume(entry & 0xF);
+      return entry >> 4;
+    }
+    s32 code = 0;
+    s32 first = 0;
+    s32 index = 0;
+    for(u32 len = 1; len <= cMaxBits; ++len) {
+      code |= s32(bits.read(1));
+      s32 count = mCounts[len];
+      if(code - count < first) {
+        return mSymbols[index + (code - first)];
+      }
+      index += count;
+      first = (first + count) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+
+private:
+  u16 mCounts[cMaxBits + 1];
+  u16 mSymbols[288];
+  u16 mFast[1 << cFastBits];
+};
+
+constexpr u16 cLengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr u8 cLengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr u16 cDistBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr u8 cDistExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/* order the code length code lengths of a dynamic block are stored in */
+constexpr u8 cCodeLengthOrder[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+} // namespace
+
+static bool inflateCodes(BitReader &bits, const Huffman &lit, const Huffman &dist,
+  u8 *dstBegin, u8 *&dst, u8 *dstEnd)
+{
+  for(;;) {
+    s32 symbol = lit.decode(bits);
+    if(symbol < 0 || bits.overrun()) {
+      return false;
+    }
+    if(symbol < 256) {
+      if(dst == dstEnd) {
+        return false;
+      }
+      *dst++ = u8(symbol);
+      continue;
+    }
+    if(symbol == 256) {
+      return true;
+    }
+    symbol -= 257;
+    if(symbol >= 29) {
+      return false;
+    }
+    usize length = cLengthBase[symbol] + bits.read(cLengthExtra[symbol]);
+    s32 distSymbol = dist.decode(bits);
+    if(distSymbol < 0 || distSymbol >= 30) {
+      return false;
+    }
+    usize offset = cDistBase[distSymbol] + bits.read(cDistExtra[distSymbol]);
+    if(offset > usize(dst - dstBegin) || length > usize(dstEnd - dst)) {
+      return false;
+    }
+    const u8 *match = dst - offset;
+    // matches may overlap their own output
+    for(usize i = 0; i < length; ++i) {
+      dst[i] = match[i];
+    }
+    dst += length;
+  }
+}
+
+static bool readDynamicCodes(BitReader &bits, Huffman &lit, Huffman &dist) {
+  u32 litCount = bits.read(5) + 257;
+  u32 distCount = bits.read(5) + 1;
+  u32 codeLengthCount = bits.read(4) + 4;
+  if(litCount > 286 || distCount > 30) {
+    return false;
+  }
+
+  u8 lengths[286 + 30]{};
+  for(u32 i = 0; i < codeLengthCount; ++i) {
+    lengths[cCodeLengthOrder[i]] = u8(bits.read(3));
+  }
+  Huffman codeLengths;
+  if(!codeLengths.build(lengths, 19)) {
+    return false;
+  }
+
+  std::memset(lengths, 0, sizeof(lengths));
+  u32 index = 0;
+  while(index < litCount + distCount) {
+    s32 symbol = codeLengths.decode(bits);
+    if(symbol < 0 || bits.overrun()) {
+      return false;
+    }
+    if(symbol < 16) {
+      lengths[index++] = u8(symbol);
+      continue;
+    }
+    u8 repeated = 0;
+    u32 repeat;
+    if(symbol == 16) {
+      if(index == 0) {
+        return false;
+      }
+      repeated = lengths[index - 1];
+      repeat = 3 + bits.read(2);
+    } else if(symbol == 17) {
+      repeat = 3 + bits.read(3);
+    } else {
+      repeat = 11 + bits.read(7);
+    }
+    if(index + repeat > litCount + distCount) {
+      return false;
+    }
+    std::memset(lengths + index, repeated, repeat);
+    index += repeat;
+  }
+  // a block without an end of block code could never end
+  if(lengths[256] == 0) {
+    return false;
+  }
+  return lit.build(lengths, litCount) && dist.build(lengths + litCount, distCount);
+}
+
+bool inflate(const u8 *src, usize srcSize, u8 *dst, usize dstSize) {
+  // zlib header: deflate with a window of at most 32 KiB, no preset dictionary
+  if(srcSize < 2 || (src[0] & 0x0F) != 8 || (src[0] >> 4) > 7
+  || (src[1] & 0x20) != 0 || ((u32(src[0]) << 8) | src[1]) % 31 != 0) {
+    return false;
+  }
+  BitReader bits{src + 2, srcSize - 2};
+  u8 *dstBegin = dst;
+  u8 *dstEnd = dst + dstSize;
+  bool last;
+  do {
+    last = bits.read(1) != 0;
+    u32 type = bits.read(2);
+    if(type == 0) {
+      bits.align();
+      u32 length = bits.read(16);
+      u32 inverted = bits.read(16);
+      if((length ^ 0xFFFF) != inverted || length > usize(dstEnd - dst)
+      || !bits.copy(dst, length)) {
+        return false;
+      }
+      dst += length;
+    } else if(type == 1) {
+      static const auto sFixed = []{
+        std::pair<Huffman, Huffman> codes;
+        u8 lengths[288];
+        std::memset(lengths, 8, 144);
+        std::memset(lengths + 144, 9, 112);
+        std::memset(lengths + 256, 7, 24);
+        std::memset(lengths + 280, 8, 8);
+        codes.first.build(lengths, 288);
+        std::memset(lengths, 5, 30);
+        codes.second.build(lengths, 30);
+        return codes;
+      }();
+      if(!inflateCodes(bits, sFixed.first, sFixed.second, dstBegin, dst, dstEnd)) {
+        return false;
+      }
+    } else if(type == 2) {
+      Huffman lit;
+      Huffman dist;
+      if(!readDynamicCodes(bits, lit, dist)
+      || !inflateCodes(bits, lit, dist, dstBegin, dst, dstEnd)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  } while(!last);
+  return !bits.overrun() && dst == dstEnd;
+}
+
+/* The bundle step's side of the format, only as much as check() needs: an
+   LZ4 block of nothing but literals, and the Delta16 filter. */
+static std::string literalBlock(std::string_view data) {
+  std::string out;
+  usize length = data.size();
+  out.push_back(char(std::min<usize>(length, 15) << 4));
+  if(length >= 15) {
+    usize rest = length - 15;
+    for(; rest >= 255; rest -= 255) {
+      out.push_back(char(255));
+    }
+    out.push_back(char(rest));
+  }
+  out += data;
+  return out;
+}
+
+static std::string filterDelta16(std::string_view data) {
+  usize count = data.size() / 2;
+  std::string planes(data.size(), '\0');
+  u16 previous = 0;
+  for(usize i = 0; i < count; ++i) {
+    auto value = u16(u8(data[2 * i]) | (u8(data[2 * i + 1]) << 8));
+    auto delta = u16(value - previous);
+    planes[i] = char(delta & 0xFF);
+    planes[count + i] = char(delta >> 8);
+    previous = value;
+  }
+  if(data.size() % 2 != 0) {
+    planes.back() = data.back();
+  }
+  return planes;
+}
+
+static std::string packed(u16 flags, usize rawSize, std::string_view block) {
+  Header header{};
+  std::memcpy(header.magic, cMagic, sizeof(cMagic));
+  header.flags = flags;
+  header.rawSize = u32(rawSize);
+  std::string out(reinterpret_cast<const char*>(&header), sizeof(Header));
+  out += block;
+  return out;
+}
+
+static bool unpacksTo(std::string_view entry, std::string_view expected) {
+  Array<char> out;
+  return unpack({entry.data(), entry.size()}, out)
+    && std::string_view{out.begin(), out.size()} == expected;
+}
+
+bool check() {
+  Checks checks{"SBSZ packed entries"};
+
+  // "abc", then a match three back which overlaps itself, then "xyz12"
+  static constexpr u8 cBlock[] = {
+    0x35, 'a', 'b', 'c', 3, 0,
+    0x50, 'x', 'y', 'z', '1', '2'};
+  std::string_view block{reinterpret_cast<const char*>(cBlock), sizeof(cBlock)};
+  std::string_view expected = "abcabcabcabcxyz12";
+  checks.expect(unpacksTo(packed(LZ4, expected.size(), block), expected),
+    "decodes an overlapping match");
+
+  // a run of 300 needs length continuation bytes
+  static constexpr u8 cRun[] = {0x1F, 'a', 1, 0, 255, 25, 0x00};
+  std::string_view run{reinterpret_cast<const char*>(cRun), sizeof(cRun)};
+  checks.expect(unpacksTo(packed(LZ4, 300, run), std::string(300, 'a')),
+    "decodes long lengths");
+
+  std::string text;
+  for(usize i = 0; i < 1000; ++i) {
+    text.push_back(char(i * 7 + i / 13));
+  }
+  checks.expect(unpacksTo(packed(LZ4, text.size(), literalBlock(text)), text),
+    "round-trips literals");
+  // odd-sized, so the last byte is not part of any word
+  std::string pcm = text.substr(0, 999);
+  checks.expect(unpacksTo(packed(LZ4 | Delta16, pcm.size(), literalBlock(filterDelta16(pcm))), pcm),
+    "round-trips Delta16");
+
+  auto entry = packed(LZ4, expected.size(), block);
+  bool allCaught = true;
+  for(usize size = sizeof(Header); size < entry.size(); ++size) {
+    allCaught = allCaught && !unpacksTo(entry.substr(0, size), expected);
+  }
+  checks.expect(allCaught, "rejects every truncation");
+  checks.expect(!unpacksTo(packed(LZ4, expected.size() + 1, block), expected),
+    "rejects a wrong size");
+  static constexpr u8 cFarMatch[] = {0x10, 'a', 2, 0, 0x00};
+  std::string_view farMatch{reinterpret_cast<const char*>(cFarMatch), sizeof(cFarMatch)};
+  checks.expect(!unpacksTo(packed(LZ4, 5, farMatch), "aaaaa"),
+    "rejects a match before the start");
+  checks.expect(!unpacksTo(packed(4, expected.size(), block), expected),
+    "rejects an unknown compression");
+
+  // a zlib stream with a single stored block
+  static constexpr u8 cStored[] = {
+    0x78, 0x01, 0x01, 5, 0, 0xFA, 0xFF, 'h', 'e', 'l', 'l', 'o', 0, 0, 0, 0};
+  u8 out[5];
+  checks.expect(inflate(cStored, sizeof(cStored), out, sizeof(out))
+    && std::memcmp(out, "hello", sizeof(out)) == 0, "inflates a stored block");
+  u8 damaged[sizeof(cStored)];
+  std::memcpy(damaged, cStored, sizeof(cStored));
+  damaged[5] = 0; // NLEN no longer matches LEN
+  checks.expect(!inflate(damaged, sizeof(damaged), out, sizeof(out)),
+    "rejects a damaged stored block");
+  return checks.finish();
+}
+
+} // namespace sbs::compress
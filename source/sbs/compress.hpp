@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+compress.hpp
+------------
+Compressed bundle entries
+
+The bundle step (see source/bndl/plug.py) may store an entry packed: a header
+followed by the file compressed as a single LZ4 block. readAll() unpacks such
+entries transparently. Entries which the engine itself decodes (textures,
+fonts) are never packed, sounds are handed to it through loadUnpacked().
+
+16-bit PCM barely compresses with LZ4 as it is, so WAV files may be filtered
+first: every 16-bit word is replaced by its difference from the previous one,
+and the low and high bytes of those are stored as two separate planes.
+*/
+
+#include <nwge/common/array.hpp>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+
+namespace sbs::compress {
+
+static constexpr char cMagic[4] = {'S', 'B', 'S', 'Z'};
+
+enum Flags: u16 {
+  LZ4 = 1,
+  Delta16 = 2, // filtered as described above before compressing
+};
+
+struct Header {
+  char magic[4];
+  u16 flags;
+  u16 reserved;
+  u32 rawSize; // size of the entry once unpacked
+};
+static_assert(sizeof(Header) == 12);
+
+/* Whether `bytes` start with a packed entry header. */
+bool isPacked(nwge::StringView bytes);
+
+/* Unpacks a packed entry into `out`. Returns false if it is damaged or uses a
+   compression this build does not know. */
+bool unpack(nwge::StringView packed, nwge::Array<char> &out);
+
+/* Size of a packed entry once unpacked. Returns false if it is not packed
+   with a compression this build knows. */
+bool unpackedSize(nwge::StringView packed, usize &size);
+
+/* Unpacks into `out`, which must hold unpackedSize() bytes. */
+bool unpackInto(nwge::StringView packed, char *out, usize size);
+
+/* Decodes one LZ4 block, which must decode to exactly `dstSize` bytes. */
+bool lz4Decode(const u8 *src, usize srcSize, u8 *dst, usize dstSize);
+
+/* Decodes a zlib stream, as found in PNG files, which must decode to exactly
+   `dstSize` bytes. The Adler-32 checksum at its end is not checked. */
+bool inflate(const u8 *src, usize srcSize, u8 *dst, usize dstSize);
+
+/* Round-trips packed entries, plain and Delta16 filtered, and checks that
+   damaged ones are rejected. For the sbs.check console command. */
+bool check();
+
+} // namespace sbs::compress
@@ -1,938 +1,801 @@
 #include "config.hpp"
+#include "JsonReader.hpp"
+#include "arena.hpp"
+#include "bench.hpp"
+#include "data.hpp"
 #include <nwge/console.hpp>
 #include <nwge/dialog.hpp>
 #include <nwge/json.hpp>
 #include <SDL2/SDL_error.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
 
 using namespace nwge;
 
 namespace sbs {
 
-static bool loadSocials(Config &out, const json::Object &root);
-static bool loadLube(Config &out, const json::Object &root);
-static bool loadGravity(Config &out, const json::Object &root);
-static bool loadOxy(Config &out, const json::Object &root);
-static bool loadStore(Config &out, const json::Object &root);
-static bool loadToilet(Config &out, const json::Object &root);
-static bool loadBrick(Config &out, const json::Object &root);
-static bool loadWater(Config &out, const json::Object &root);
-static bool loadShitter(Config &out, const json::Object &root);
+static std::mutex gSharedConfigMutex;
+static ConfigPtr gSharedConfig;
 
-bool Config::load(data::RW &file) {
-  auto fileSize = file.size();
-  if(fileSize <= 0) {
-    dialog::error("Config", "Configuration file is invalid or empty.");
-    return false;
-  }
-
-  ScratchArray<char> raw{usize(fileSize)};
-  if(!file.read(raw.view())) {
-    dialog::error("Config",
-      "Could not read the configuration file.\n"
-      "{}",
-      SDL_GetError());
-    return false;
-  }
-
-  auto res = json::parse(raw.view());
-  if(res.error != json::OK) {
-    dialog::error("Config",
-      "Configuration file is not valid JSON.\n"
-      "{}",
-      json::errorMessage(res.error));
-    return false;
-  }
-
-  if(!res.value->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "Not an object.");
-    return false;
-  }
-  const auto &root = res.value->object();
-
-  if(!loadSocials(*this, root)) {
-    return false;
-  }
-
-  if(!loadLube(*this, root)) {
-    return false;
-  }
-
-  if(!loadGravity(*this, root)) {
-    return false;
-  }
-
-  if(!loadOxy(*this, root)) {
-    return false;
-  }
-
-  if(!loadStore(*this, root)) {
-    return false;
-  }
+ConfigPtr sharedConfig() {
+  std::lock_guard lock{gSharedConfigMutex};
+  return gSharedConfig;
+}
 
-  if(!loadToilet(*this, root)) {
-    return false;
-  }
+#ifdef DEBUG
+void replaceSharedConfig(ConfigPtr config) {
+  std::lock_guard lock{gSharedConfigMutex};
+  gSharedConfig = std::move(config);
+}
+#endif
 
-  if(!loadBrick(*this, root)) {
-    return false;
-  }
+static void logConfig(Config &config, ParseLog &log);
 
-  if(!loadWater(*this, root)) {
+bool ConfigSnapshot::parse(StringView raw, ParseLog &log) {
+  auto config = std::make_shared<Config>();
+  if(!config->parse(raw, log)) {
     return false;
   }
-
-  if(!loadShitter(*this, root)) {
-    return false;
+  logConfig(*config, log);
+  std::lock_guard lock{gSharedConfigMutex};
+  if(gSharedConfig == nullptr) {
+    gSharedConfig = std::move(config);
   }
-
-  console::note("Loaded config:");
-  console::print("  Lube:");
-  console::print("    Base: {}", lube.base);
-  console::print("    Upgrade: {}", lube.upgrade);
-  console::print("    Max Tier: {}", lube.maxTier);
-  console::print("  Gravity:");
-  console::print("    Base: {}", gravity.base);
-  console::print("    Upgrade: {}", gravity.upgrade);
-  console::print("    Threshold: {}", gravity.threshold);
-  console::print("    Max Tier: {}", gravity.maxTier);
-  console::print("  Toilet:");
-  console::print("    X: {}", toilet.xPos);
-  console::print("    Y: {}", toilet.yPos);
-  console::print("    Size: {}", toilet.size);
-  console::print("  Brick:");
-  console::print("    Start Y: {}", brick.startY);
-  console::print("    End Y: {}", brick.endY);
-  console::print("    Fall Speed: {}", brick.fallSpeed);
-  console::print("    Size: {}", brick.size);
-  console::print("  Water:");
-  console::print("    Min X: {}", water.minX);
-  console::print("    Max X: {}", water.maxX);
-  console::print("    Min Y: {}", water.minY);
-  console::print("    Max Y: {}", water.maxY);
-  console::print("    Width: {}", water.width);
-  console::print("    Height: {}", water.height);
-
   return true;
 }
 
-bool loadSocials(Config &out, const json::Object &root) {
-  const auto *socialsV = root.get("socials");
-  if(socialsV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `socials` key.");
+bool ConfigSnapshot::parseBlob(const blob::View &view, [[maybe_unused]] Array<char> &&bytes,
+  ParseLog &log)
+{
+  auto config = std::make_shared<Config>();
+  if(!config->parseBlob(view, log)) {
     return false;
   }
-  if(!socialsV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`socials` is not a object.");
-    return false;
+  std::lock_guard lock{gSharedConfigMutex};
+  if(gSharedConfig == nullptr) {
+    gSharedConfig = std::move(config);
   }
-  const auto &socialsObject = socialsV->object();
-
-  const auto *xDotComV = socialsObject.get("x.com");
-  if(xDotComV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `x.com` key in `socials` object.");
-    return false;
-  }
-  if(!xDotComV->isString()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`x.com` is not a string.");
-    return false;
-  }
-  out.socials.xDotCom = xDotComV->string();
-
-  const auto *discordV = socialsObject.get("discord");
-  if(discordV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `discord` key in `socials` object.");
-    return false;
-  }
-  if(!discordV->isString()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`discord` is not a string.");
-    return false;
-  }
-  out.socials.discord = discordV->string();
   return true;
 }
 
-bool loadLube(Config &out, const json::Object &root) {
-  const auto *lubeV = root.get("lube");
-  if(lubeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `lube` key.");
-    return false;
-  }
-  if(!lubeV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`lube` is not a object.");
-    return false;
-  }
-  const auto &lubeObject = lubeV->object();
-
-  const auto *baseV = lubeObject.get("base");
-  if(baseV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `base` in key in `lube` object.");
-    return false;
-  }
-  if(!baseV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`base` in `lube` object is not a number.");
-    return false;
-  }
-  out.lube.base = static_cast<f32>(baseV->number());
+bool Config::parseBlob(const blob::View &view, ParseLog &log) {
+  if(!view.fits<blob::ConfigRecord>(0, 1)
+  || !view.fits<blob::StoreItemRecord>(sizeof(blob::ConfigRecord), view.count())) {
+    log.fail("Config", String<>::formatted(
+      "Compiled configuration file is invalid.\n"
+      "Records are out of bounds."));
+    return false;
+  }
+
+  auto record = view.record<blob::ConfigRecord>(0);
+  socials.xDotCom = view.string(record.xDotCom);
+  socials.discord = view.string(record.discord);
+  lube = {record.lubeBase, record.lubeUpgrade, s16(record.lubeMaxTier)};
+  gravity = {
+    record.gravityBase, record.gravityUpgrade, record.gravityThreshold,
+    s16(record.gravityMaxTier)};
+  oxy = {
+    record.oxyRegenFast, record.oxyRegenSlow, record.oxyDrain, record.oxyMin,
+    record.oxyCooldown};
+  toilet = {record.toiletXPos, record.toiletYPos, record.toiletSize};
+  shitter = {
+    record.shitterXPos, record.shitterYPos, record.shitterWidth,
+    record.shitterHeight};
+  brick = {
+    record.brickXPos, record.brickStartY, record.brickEndY,
+    record.brickFallSpeed, record.brickSize};
+  water = {
+    record.waterMinX, record.waterMaxX, record.waterMinY, record.waterMaxY,
+    record.waterWidth, record.waterHeight,
+    record.waterScissorX, record.waterScissorY,
+    record.waterScissorW, record.waterScissorH};
+
+  LoadScope scope;
+  StringPool::Builder builder;
+  LoadVector<blob::Str> spans;
+  spans.reserve(usize(view.count()) * 2);
+  store = {view.count()};
+  for(usize i = 0; i < store.size(); ++i) {
+    auto itemRecord = view.record<blob::StoreItemRecord>(
+      sizeof(blob::ConfigRecord) + i * sizeof(blob::StoreItemRecord));
+    auto &item = store[i];
+    item.kind = StoreItem::Kind(itemRecord.kind);
+    item.argument = itemRecord.argument;
+    item.price = itemRecord.price;
+    item.icon = itemRecord.icon;
+    item.prestige = itemRecord.prestige;
+    spans.push_back(builder.add(view.string(itemRecord.name)));
+    spans.push_back(builder.add(view.string(itemRecord.desc)));
+  }
+  strings = builder.build();
+  for(usize i = 0; i < store.size(); ++i) {
+    store[i].name = strings.view(spans[i * 2]);
+    store[i].desc = strings.view(spans[i * 2 + 1]);
+  }
+
+  log.note(String<>::formatted("Loaded compiled config with {} store items.", store.size()));
+  return true;
+}
 
-  const auto *upgradeV = lubeObject.get("upgrade");
-  if(upgradeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `upgrade` in key in `lube` object.");
-    return false;
-  }
-  if(!upgradeV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`upgrade` in `lube` object is not a number.");
-    return false;
+namespace {
+
+enum class FieldType: u8 {
+  F32,
+  S16,
+  S32,
+  String,
+  Text, // string interned into Config::strings, see PendingItem
+  Tier, // store item kind, with the tier as its argument
+  Flag, // store item kind without an argument, the value is ignored
+};
+
+/* Fields are looked up by section and key together. Store item fields have
+   `store` as their section. */
+struct FieldKey {
+  std::string_view section;
+  std::string_view key;
+};
+
+/* A store item being parsed. Its text is only viewed once the pool is
+   built. */
+struct PendingItem {
+  StoreItem item;
+  blob::Str name{};
+  blob::Str desc{};
+};
+
+template<typename T>
+struct Field {
+  FieldKey name;
+  FieldType type;
+  void *(*locate)(T &target);
+  bool required;
+  StoreItem::Kind kind = StoreItem::None;
+};
+
+template<typename M>
+consteval FieldType fieldType() {
+  if constexpr(std::is_same_v<M, f32>) {
+    return FieldType::F32;
+  } else if constexpr(std::is_same_v<M, s16>) {
+    return FieldType::S16;
+  } else if constexpr(std::is_same_v<M, s32>) {
+    return FieldType::S32;
+  } else if constexpr(std::is_same_v<M, blob::Str>) {
+    return FieldType::Text;
+  } else {
+    static_assert(std::is_same_v<M, String<>>, "unsupported config field type");
+    return FieldType::String;
   }
-  out.lube.upgrade = static_cast<f32>(upgradeV->number());
+}
 
-  const auto *maxTierV = lubeObject.get("maxTier");
-  if(maxTierV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `maxTier` in key in `lube` object.");
-    return false;
-  }
-  if(!maxTierV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`maxTier` in `lube` object is not a number.");
-    return false;
-  }
-  out.lube.maxTier = static_cast<s16>(maxTierV->number());
+template<auto cSection, auto cMember>
+void *locateConfig(Config &config) {
+  return &(config.*cSection.*cMember);
+}
 
-  return true;
+template<auto cSection, auto cMember>
+consteval Field<Config> configField(std::string_view section, std::string_view key) {
+  using Member = std::remove_cvref_t<decltype(std::declval<Config&>().*cSection.*cMember)>;
+  return {{section, key}, fieldType<Member>(), &locateConfig<cSection, cMember>, true};
 }
 
-bool loadGravity(Config &out, const json::Object &root) {
-  const auto *gravityV = root.get("gravity");
-  if(gravityV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `gravity` key.");
-    return false;
-  }
-  if(!gravityV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`gravity` is not a object.");
-    return false;
-  }
-  const auto &gravityObject = gravityV->object();
+template<auto cMember>
+void *locateItem(PendingItem &pending) {
+  return &(pending.item.*cMember);
+}
 
-  const auto *baseV = gravityObject.get("base");
-  if(baseV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `base` in key in `gravity` object.");
-    return false;
-  }
-  if(!baseV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`base` in `gravity` object is not a number.");
-    return false;
-  }
-  out.gravity.base = static_cast<f32>(baseV->number());
+template<auto cMember>
+consteval Field<PendingItem> itemField(std::string_view key, bool required = true) {
+  using Member = std::remove_cvref_t<decltype(std::declval<StoreItem&>().*cMember)>;
+  return {{"store", key}, fieldType<Member>(), &locateItem<cMember>, required};
+}
 
-  const auto *upgradeV = gravityObject.get("upgrade");
-  if(upgradeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `upgrade` in key in `gravity` object.");
-    return false;
-  }
-  if(!upgradeV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`upgrade` in `gravity` object is not a number.");
-    return false;
-  }
-  out.gravity.upgrade = static_cast<f32>(upgradeV->number());
+template<auto cMember>
+void *locateText(PendingItem &pending) {
+  return &(pending.*cMember);
+}
 
-  const auto *thresholdV = gravityObject.get("threshold");
-  if(thresholdV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `threshold` in key in `gravity` object.");
-    return false;
-  }
-  if(!thresholdV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`threshold` in `gravity` object is not a number.");
-    return false;
-  }
-  out.gravity.threshold = static_cast<f32>(thresholdV->number());
+template<auto cMember>
+consteval Field<PendingItem> textField(std::string_view key) {
+  return {{"store", key}, FieldType::Text, &locateText<cMember>, true};
+}
 
-  const auto *maxTierV = gravityObject.get("maxTier");
-  if(maxTierV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `maxTier` in key in `gravity` object.");
-    return false;
-  }
-  if(!maxTierV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`maxTier` in `gravity` object is not a number.");
-    return false;
-  }
-  out.gravity.maxTier = static_cast<s16>(maxTierV->number());
+consteval Field<PendingItem> kindField(std::string_view key, FieldType type, StoreItem::Kind kind) {
+  return {{"store", key}, type, nullptr, false, kind};
+}
 
-  return true;
+constexpr std::array cConfigFields{
+  configField<&Config::socials, &Config::Socials::xDotCom>("socials", "x.com"),
+  configField<&Config::socials, &Config::Socials::discord>("socials", "discord"),
+  configField<&Config::lube, &Config::Lube::base>("lube", "base"),
+  configField<&Config::lube, &Config::Lube::upgrade>("lube", "upgrade"),
+  configField<&Config::lube, &Config::Lube::maxTier>("lube", "maxTier"),
+  configField<&Config::gravity, &Config::Gravity::base>("gravity", "base"),
+  configField<&Config::gravity, &Config::Gravity::upgrade>("gravity", "upgrade"),
+  configField<&Config::gravity, &Config::Gravity::threshold>("gravity", "threshold"),
+  configField<&Config::gravity, &Config::Gravity::maxTier>("gravity", "maxTier"),
+  configField<&Config::oxy, &Config::Oxy::regenFast>("oxy", "regenFast"),
+  configField<&Config::oxy, &Config::Oxy::regenSlow>("oxy", "regenSlow"),
+  configField<&Config::oxy, &Config::Oxy::drain>("oxy", "drain"),
+  configField<&Config::oxy, &Config::Oxy::min>("oxy", "min"),
+  configField<&Config::oxy, &Config::Oxy::cooldown>("oxy", "cooldown"),
+  configField<&Config::toilet, &Config::Toilet::xPos>("toilet", "xPos"),
+  configField<&Config::toilet, &Config::Toilet::yPos>("toilet", "yPos"),
+  configField<&Config::toilet, &Config::Toilet::size>("toilet", "size"),
+  configField<&Config::shitter, &Config::Shitter::xPos>("shitter", "xPos"),
+  configField<&Config::shitter, &Config::Shitter::yPos>("shitter", "yPos"),
+  configField<&Config::shitter, &Config::Shitter::width>("shitter", "width"),
+  configField<&Config::shitter, &Config::Shitter::height>("shitter", "height"),
+  configField<&Config::brick, &Config::Brick::xPos>("brick", "xPos"),
+  configField<&Config::brick, &Config::Brick::startY>("brick", "startY"),
+  configField<&Config::brick, &Config::Brick::endY>("brick", "endY"),
+  configField<&Config::brick, &Config::Brick::fallSpeed>("brick", "fallSpeed"),
+  configField<&Config::brick, &Config::Brick::size>("brick", "size"),
+  configField<&Config::water, &Config::Water::minX>("water", "minX"),
+  configField<&Config::water, &Config::Water::maxX>("water", "maxX"),
+  configField<&Config::water, &Config::Water::minY>("water", "minY"),
+  configField<&Config::water, &Config::Water::maxY>("water", "maxY"),
+  configField<&Config::water, &Config::Water::width>("water", "width"),
+  configField<&Config::water, &Config::Water::height>("water", "height"),
+  configField<&Config::water, &Config::Water::scissorX>("water", "scissorX"),
+  configField<&Config::water, &Config::Water::scissorY>("water", "scissorY"),
+  configField<&Config::water, &Config::Water::scissorW>("water", "scissorW"),
+  configField<&Config::water, &Config::Water::scissorH>("water", "scissorH"),
+};
+
+/* When an item has several kind keys, the one listed first wins. */
+constexpr std::array cItemFields{
+  textField<&PendingItem::name>("name"),
+  textField<&PendingItem::desc>("desc"),
+  itemField<&StoreItem::price>("price"),
+  itemField<&StoreItem::icon>("icon"),
+  itemField<&StoreItem::prestige>("prestige", false),
+  kindField("lubeTier", FieldType::Tier, StoreItem::Lube),
+  kindField("gravityTier", FieldType::Tier, StoreItem::Gravity),
+  kindField("oxyTier", FieldType::Tier, StoreItem::Oxy),
+  kindField("endGame", FieldType::Flag, StoreItem::EndGame),
+};
+
+/* bitmask of the fields seen so far */
+using SeenMask = u64;
+static_assert(cConfigFields.size() <= 64 && cItemFields.size() <= 64);
+
+constexpr u32 hashKey(FieldKey key, u32 seed) {
+  u32 hash = 2166136261u ^ seed;
+  for(char chr: key.section) {
+    hash = (hash ^ u8(chr)) * 16777619u;
+  }
+  hash = (hash ^ u8('.')) * 16777619u;
+  for(char chr: key.key) {
+    hash = (hash ^ u8(chr)) * 16777619u;
+  }
+  return hash;
 }
 
-bool loadOxy(Config &out, const json::Object &root) {
-  const auto *oxyV = root.get("oxy");
-  if(oxyV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `oxy` key.");
-    return false;
-  }
-  if(!oxyV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`oxy` is not a object.");
-    return false;
+/* Collision-free hash table over a fixed set of keys, built at compile time by
+   trying seeds until no two keys share a slot. */
+template<usize cCount>
+class PerfectHash {
+public:
+  static constexpr usize cMiss = cCount;
+
+  template<typename T>
+  consteval PerfectHash(const std::array<Field<T>, cCount> &fields) {
+    for(usize i = 0; i < cCount; ++i) {
+      mKeys[i] = fields[i].name;
+    }
+    for(u32 seed = 0; seed < cMaxSeed; ++seed) {
+      if(tryBuild(seed)) {
+        mSeed = seed;
+        return;
+      }
+    }
+    throw "no perfect hash seed found";
   }
-  const auto &oxyObject = oxyV->object();
 
-  const auto *regenFastV = oxyObject.get("regenFast");
-  if(regenFastV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `regenFast` in key in `oxy` object.");
-    return false;
-  }
-  if(!regenFastV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`regenFast` in `oxy` object is not a number.");
-    return false;
+  /* Index of the key, or cMiss. */
+  [[nodiscard]] constexpr usize find(FieldKey key) const {
+    u8 slot = mSlots[hashKey(key, mSeed) & (cSlots - 1)];
+    if(slot == cEmpty) {
+      return cMiss;
+    }
+    const auto &candidate = mKeys[slot];
+    if(candidate.section != key.section || candidate.key != key.key) {
+      return cMiss;
+    }
+    return slot;
   }
-  out.oxy.regenFast = static_cast<f32>(regenFastV->number());
 
-  const auto *regenSlowV = oxyObject.get("regenSlow");
-  if(regenSlowV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `regenSlow` in key in `oxy` object.");
-    return false;
-  }
-  if(!regenSlowV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`regenSlow` in `oxy` object is not a number.");
-    return false;
-  }
-  out.oxy.regenSlow = static_cast<f32>(regenSlowV->number());
+private:
+  static constexpr usize cSlots = std::bit_ceil(cCount * 4);
+  static constexpr u8 cEmpty = 0xFF;
+  static constexpr u32 cMaxSeed = 256;
+  static_assert(cCount < cEmpty);
 
-  const auto *drainV = oxyObject.get("drain");
-  if(drainV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `drain` in key in `oxy` object.");
-    return false;
-  }
-  if(!drainV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`drain` in `oxy` object is not a number.");
-    return false;
-  }
-  out.oxy.drain = static_cast<f32>(drainV->number());
+  std::array<FieldKey, cCount> mKeys{};
+  std::array<u8, cSlots> mSlots{};
+  u32 mSeed = 0;
 
-  const auto *minV = oxyObject.get("min");
-  if(minV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `min` in key in `oxy` object.");
-    return false;
-  }
-  if(!minV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`min` in `oxy` object is not a number.");
-    return false;
+  constexpr bool tryBuild(u32 seed) {
+    mSlots.fill(cEmpty);
+    for(usize i = 0; i < cCount; ++i) {
+      auto &slot = mSlots[hashKey(mKeys[i], seed) & (cSlots - 1)];
+      if(slot != cEmpty) {
+        return false;
+      }
+      slot = u8(i);
+    }
+    return true;
   }
-  out.oxy.min = static_cast<f32>(minV->number());
+};
 
-  const auto *cooldownV = oxyObject.get("cooldown");
-  if(cooldownV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `cooldown` in key in `oxy` object.");
-    return false;
-  }
-  if(!cooldownV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`cooldown` in `oxy` object is not a number.");
-    return false;
+constexpr PerfectHash cConfigHash{cConfigFields};
+constexpr PerfectHash cItemHash{cItemFields};
+
+constexpr JsonReader::Kind jsonKind(FieldType type) {
+  switch(type) {
+  case FieldType::String:
+  case FieldType::Text:
+    return JsonReader::String;
+  case FieldType::Flag:
+    return JsonReader::Invalid;
+  default:
+    return JsonReader::Number;
   }
-  out.oxy.cooldown = static_cast<f32>(cooldownV->number());
+}
 
-  return true;
+constexpr const char *typeName(FieldType type) {
+  return type == FieldType::String || type == FieldType::Text ? "a string" : "a number";
 }
 
-bool loadStore(Config &out, const json::Object &root) {
-  const auto *storeV = root.get("store");
-  if(storeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `store` key.");
-    return false;
-  }
-  if(!storeV->isArray()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`store` is not an array.");
-    return false;
-  }
-  const auto &storeArray = storeV->array();
+} // namespace
 
-  out.store = {storeArray.size()};
-  for(usize i = 0; i < out.store.size(); ++i) {
-    auto &item = out.store[i];
-    const auto &itemV = storeArray[i];
-    if(!itemV.isObject()) {
-      dialog::error("Config",
-        "Configuration file is invalid.\n"
-        "`store` element {} is not an object.",
-        i);
+static bool syntaxError(const JsonReader &reader, ParseLog &log) {
+  log.fail("Config", String<>::formatted(
+    "Configuration file is not valid JSON.\n"
+    "{} at byte {}",
+    reader.error(), reader.offset()));
+  return false;
+}
+
+/* Reads a value of the field's type into `target`. Text is added to
+   `strings`. */
+static bool readField(JsonReader &reader, FieldType type, void *target,
+  StringPool::Builder *strings = nullptr)
+{
+  f64 number;
+  StringView string;
+  switch(type) {
+  case FieldType::F32:
+    if(!reader.readNumber(number)) {
       return false;
     }
-    const auto &itemObject = itemV.object();
-
-    const auto *nameV = itemObject.get("name");
-    if(nameV == nullptr || !nameV->isString()) {
-      dialog::error("Config",
-        "Configuration file is invalid.\n"
-        "`name` of `store` element {} is not a string.",
-        i);
+    *static_cast<f32*>(target) = static_cast<f32>(number);
+    return true;
+  case FieldType::S16:
+  case FieldType::Tier:
+    if(!reader.readNumber(number)) {
       return false;
     }
-    item.name = nameV->string();
-
-    const auto *descV = itemObject.get("desc");
-    if(descV == nullptr || !descV->isString()) {
-      dialog::error("Config",
-        "Configuration file is invalid.\n"
-        "`desc` of `store` element {} is not a string.",
-        i);
+    *static_cast<s16*>(target) = static_cast<s16>(number);
+    return true;
+  case FieldType::S32:
+    if(!reader.readNumber(number)) {
       return false;
     }
-    item.desc = descV->string();
-
-    const auto *priceV = itemObject.get("price");
-    if(priceV == nullptr || !priceV->isNumber()) {
-      dialog::error("Config",
-        "Configuration file is invalid.\n"
-        "`price` of `store` element {} is not a Number.",
-        i);
+    *static_cast<s32*>(target) = static_cast<s32>(number);
+    return true;
+  case FieldType::String:
+    if(!reader.readString(string)) {
       return false;
     }
-    item.price = static_cast<s16>(priceV->number());
-
-    const auto *iconV = itemObject.get("icon");
-    if(iconV == nullptr || !iconV->isNumber()) {
-      dialog::error("Config",
-        "Configuration file is invalid.\n"
-        "`icon` of `store` element {} is not a Number.",
-        i);
+    *static_cast<String<>*>(target) = string;
+    return true;
+  case FieldType::Text:
+    if(!reader.readString(string)) {
       return false;
     }
-    item.icon = static_cast<s16>(iconV->number());
+    *static_cast<blob::Str*>(target) = strings->add(string);
+    return true;
+  case FieldType::Flag:
+    return reader.skipValue();
+  }
+  return false;
+}
 
-    const auto *prestigeV = itemObject.get("prestige");
-    if(prestigeV != nullptr && prestigeV->isNumber()) {
-      item.prestige = s32(prestigeV->number());
+/* the fields that belong to `section`, none if the loader does not know it */
+static SeenMask sectionMask(std::string_view section) {
+  SeenMask mask = 0;
+  for(usize i = 0; i < cConfigFields.size(); ++i) {
+    if(cConfigFields[i].name.section == section) {
+      mask |= SeenMask(1) << i;
     }
+  }
+  return mask;
+}
 
-    const auto *lubeTierV = itemObject.get("lubeTier");
-    if(lubeTierV != nullptr) {
-      item.kind = StoreItem::Lube;
-      if(!lubeTierV->isNumber()) {
-        dialog::error("Config",
-          "Configuration file is invalid.\n"
-          "`lubeTier` of `store` element {} is not a Number.",
-          i);
-        return false;
-      }
-      item.argument = static_cast<s16>(lubeTierV->number());
-      continue;
+/* `present` gets the fields of every section that was there, read or not, to
+   tell a missing section from a missing key. */
+static bool loadSection(Config &out, JsonReader &reader, std::string_view section,
+  SeenMask &seen, SeenMask &present, ParseLog &log)
+{
+  SeenMask mask = sectionMask(section);
+  if(reader.peek() != JsonReader::Object) {
+    if(mask != 0) {
+      log.fail("Config", String<>::formatted(
+        "Configuration file is invalid.\n"
+        "`{}` is not a object.",
+        section));
+      return false;
     }
-    const auto *gravityTierV = itemObject.get("gravityTier");
-    if(gravityTierV != nullptr) {
-      item.kind = StoreItem::Gravity;
-      if(!gravityTierV->isNumber()) {
-        dialog::error("Config",
-          "Configuration file is invalid.\n"
-          "`gravityTier` of `store` element {} is not a Number.",
-          i);
+    // not a section the loader knows about
+    return reader.skipValue();
+  }
+  present |= mask;
+  reader.beginObject();
+  StringView keyView;
+  while(reader.nextKey(keyView)) {
+    std::string_view key{keyView.begin(), keyView.size()};
+    usize idx = cConfigHash.find({section, key});
+    if(idx == cConfigHash.cMiss) {
+      if(!reader.skipValue()) {
         return false;
       }
-      item.argument = static_cast<s16>(gravityTierV->number());
       continue;
     }
-    const auto *oxyTierV = itemObject.get("oxyTier");
-    if(oxyTierV != nullptr) {
-      item.kind = StoreItem::Oxy;
-      if(!oxyTierV->isNumber()) {
-        dialog::error("Config",
-          "Configuration file is invalid.\n"
-          "`oxyTier` of `store` element {} is not a Number.",
-          i);
-        return false;
-      }
-      item.argument = static_cast<s16>(oxyTierV->number());
-      continue;
+    const auto &field = cConfigFields[idx];
+    if(reader.peek() != jsonKind(field.type)) {
+      log.fail("Config", String<>::formatted(
+        "Configuration file is invalid.\n"
+        "`{}` in `{}` object is not {}.",
+        field.name.key, field.name.section, typeName(field.type)));
+      return false;
     }
-    const auto *endGameV = itemObject.get("endGame");
-    if(endGameV != nullptr) {
-      item.kind = StoreItem::EndGame;
-      continue;
+    if(!readField(reader, field.type, field.locate(out))) {
+      return false;
     }
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`store` element {} does not define `lubeTier`, `gravityTier` or `endGame`.",
-      i);
-    return false;
+    seen |= SeenMask(1) << idx;
   }
-  return true;
+  return !reader.failed();
 }
 
-bool loadToilet(Config &out, const json::Object &root) {
-  const auto *toiletV = root.get("toilet");
-  if(toiletV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `toilet` key.");
-    return false;
-  }
-  if(!toiletV->isObject()) {
-    dialog::error("Config",
+static bool loadStoreItem(PendingItem &pending, JsonReader &reader, usize idx,
+  StringPool::Builder &strings, ParseLog &log)
+{
+  auto &item = pending.item;
+  if(reader.peek() != JsonReader::Object) {
+    log.fail("Config", String<>::formatted(
       "Configuration file is invalid.\n"
-      "`toilet` is not a object.");
+      "`store` element {} is not an object.",
+      idx));
     return false;
   }
-  const auto &toiletObject = toiletV->object();
+  reader.beginObject();
 
-  const auto *xPosV = toiletObject.get("xPos");
-  if(xPosV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `xPos` in key in `toilet` object.");
-    return false;
-  }
-  if(!xPosV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`xPos` in `toilet` object is not a number.");
-    return false;
-  }
-  out.toilet.xPos = static_cast<f32>(xPosV->number());
+  SeenMask seen = 0;
+  StringView keyView;
+  while(reader.nextKey(keyView)) {
+    std::string_view key{keyView.begin(), keyView.size()};
+    usize fieldIdx = cItemHash.find({"store", key});
+    if(fieldIdx == cItemHash.cMiss) {
+      if(!reader.skipValue()) {
+        return false;
+      }
+      continue;
+    }
+    const auto &field = cItemFields[fieldIdx];
+    if(!field.required && field.kind == StoreItem::None
+    && reader.peek() != jsonKind(field.type)) {
+      // optional fields of the wrong type (`prestige`) were always ignored
+      if(!reader.skipValue()) {
+        return false;
+      }
+      continue;
+    }
+    if(field.type != FieldType::Flag && reader.peek() != jsonKind(field.type)) {
+      log.fail("Config", String<>::formatted(
+        "Configuration file is invalid.\n"
+        "`{}` of `store` element {} is not {}.",
+        field.name.key, idx, typeName(field.type)));
+      return false;
+    }
 
-  const auto *yPosV = toiletObject.get("yPos");
-  if(yPosV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `yPos` in key in `toilet` object.");
-    return false;
+    if(field.kind == StoreItem::None) {
+      if(!readField(reader, field.type, field.locate(pending), &strings)) {
+        return false;
+      }
+    } else {
+      s16 argument = 0;
+      if(!readField(reader, field.type, &argument)) {
+        return false;
+      }
+      if(item.kind == StoreItem::None || field.kind < item.kind) {
+        item.kind = field.kind;
+        item.argument = argument;
+      }
+    }
+    seen |= SeenMask(1) << fieldIdx;
   }
-  if(!yPosV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`yPos` in `toilet` object is not a number.");
+  if(reader.failed()) {
     return false;
   }
-  out.toilet.yPos = static_cast<f32>(yPosV->number());
 
-  const auto *sizeV = toiletObject.get("size");
-  if(sizeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `size` in key in `toilet` object.");
-    return false;
+  for(usize i = 0; i < cItemFields.size(); ++i) {
+    const auto &field = cItemFields[i];
+    if(field.required && (seen & (SeenMask(1) << i)) == 0) {
+      log.fail("Config", String<>::formatted(
+        "Configuration file is invalid.\n"
+        "`{}` of `store` element {} is not {}.",
+        field.name.key, idx, typeName(field.type)));
+      return false;
+    }
   }
-  if(!sizeV->isNumber()) {
-    dialog::error("Config",
+  if(item.kind == StoreItem::None) {
+    log.fail("Config", String<>::formatted(
       "Configuration file is invalid.\n"
-      "`size` in `toilet` object is not a number.");
+      "`store` element {} does not define `lubeTier`, `gravityTier` or `endGame`.",
+      idx));
     return false;
   }
-  out.toilet.size = static_cast<f32>(sizeV->number());
-
   return true;
 }
 
-bool loadBrick(Config &out, const json::Object &root) {
-  const auto *brickV = root.get("brick");
-  if(brickV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `brick` key.");
-    return false;
-  }
-  if(!brickV->isObject()) {
-    dialog::error("Config",
+static bool loadStore(Config &out, JsonReader &reader, ParseLog &log) {
+  if(reader.peek() != JsonReader::Array) {
+    log.fail("Config", String<>::formatted(
       "Configuration file is invalid.\n"
-      "`brick` is not a object.");
+      "`store` is not an array."));
     return false;
   }
-  const auto &brickObject = brickV->object();
+  reader.beginArray();
 
-  const auto *xPosV = brickObject.get("xPos");
-  if(xPosV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `xPos` in key in `brick` object.");
-    return false;
-  }
-  if(!xPosV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`xPos` in `brick` object is not a number.");
-    return false;
-  }
-  out.brick.xPos = static_cast<f32>(xPosV->number());
-
-  const auto *startYV = brickObject.get("startY");
-  if(startYV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `startY` in key in `brick` object.");
-    return false;
-  }
-  if(!startYV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`startY` in `brick` object is not a number.");
-    return false;
-  }
-  out.brick.startY = static_cast<f32>(startYV->number());
-
-  const auto *endYV = brickObject.get("endY");
-  if(endYV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `endY` in key in `brick` object.");
-    return false;
-  }
-  if(!endYV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`endY` in `brick` object is not a number.");
-    return false;
-  }
-  out.brick.endY = static_cast<f32>(endYV->number());
-
-  const auto *fallSpeedV = brickObject.get("fallSpeed");
-  if(fallSpeedV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `fallSpeed` in key in `brick` object.");
-    return false;
+  LoadVector<PendingItem> items;
+  StringPool::Builder strings;
+  while(reader.nextElement()) {
+    if(!loadStoreItem(items.emplace_back(), reader, items.size() - 1, strings, log)) {
+      return false;
+    }
   }
-  if(!fallSpeedV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`fallSpeed` in `brick` object is not a number.");
+  if(reader.failed()) {
     return false;
   }
-  out.brick.fallSpeed = static_cast<f32>(fallSpeedV->number());
 
-  const auto *sizeV = brickObject.get("size");
-  if(sizeV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `size` in key in `brick` object.");
-    return false;
-  }
-  if(!sizeV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`size` in `brick` object is not a number.");
-    return false;
+  out.strings = strings.build();
+  out.store = {items.size()};
+  for(usize i = 0; i < items.size(); ++i) {
+    auto &item = out.store[i];
+    item = items[i].item;
+    item.name = out.strings.view(items[i].name);
+    item.desc = out.strings.view(items[i].desc);
   }
-  out.brick.size = static_cast<f32>(sizeV->number());
-
   return true;
 }
 
-bool loadWater(Config &out, const json::Object &root) {
-  const auto *waterV = root.get("water");
-  if(waterV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `water` key.");
-    return false;
-  }
-  if(!waterV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`water` is not a object.");
-    return false;
-  }
-  const auto &waterObject = waterV->object();
-
-  const auto *minXV = waterObject.get("minX");
-  if(minXV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `minX` in key in `water` object.");
-    return false;
-  }
-  if(!minXV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`minX` in `water` object is not a number.");
-    return false;
-  }
-  out.water.minX = static_cast<f32>(minXV->number());
-
-  const auto *maxXV = waterObject.get("maxX");
-  if(maxXV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `maxX` in key in `water` object.");
-    return false;
-  }
-  if(!maxXV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`maxX` in `water` object is not a number.");
-    return false;
-  }
-  out.water.maxX = static_cast<f32>(maxXV->number());
-
-  const auto *minYV = waterObject.get("minY");
-  if(minYV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `minY` in key in `water` object.");
-    return false;
-  }
-  if(!minYV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`minY` in `water` object is not a number.");
-    return false;
-  }
-  out.water.minY = static_cast<f32>(minYV->number());
-
-  const auto *maxYV = waterObject.get("maxY");
-  if(maxYV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `maxY` in key in `water` object.");
-    return false;
-  }
-  if(!maxYV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`maxY` in `water` object is not a number.");
-    return false;
-  }
-  out.water.maxY = static_cast<f32>(maxYV->number());
-
-  const auto *widthV = waterObject.get("width");
-  if(widthV == nullptr) {
+bool Config::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> raw;
+  if(!readAll(file, raw)) {
     dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `width` in key in `water` object.");
+      "Could not read the configuration file.\n"
+      "{}",
+      SDL_GetError());
     return false;
   }
-  if(!widthV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`width` in `water` object is not a number.");
+  if(raw.size() == 0) {
+    dialog::error("Config", "Configuration file is invalid or empty.");
     return false;
   }
-  out.water.width = static_cast<f32>(widthV->number());
 
-  const auto *heightV = waterObject.get("height");
-  if(heightV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `height` in key in `water` object.");
-    return false;
-  }
-  if(!heightV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`height` in `water` object is not a number.");
-    return false;
+  ParseLog log;
+  bool ok = parse({raw.data(), raw.size()}, log);
+  if(ok) {
+    logConfig(*this, log);
   }
-  out.water.height = static_cast<f32>(heightV->number());
+  log.report();
+  return ok;
+}
 
-  const auto *scissorXV = waterObject.get("scissorX");
-  if(scissorXV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `scissorX` in key in `water` object.");
-    return false;
-  }
-  if(!scissorXV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`scissorX` in `water` object is not a number.");
-    return false;
+static void logConfig(Config &config, ParseLog &log) {
+  log.note("Loaded config:"_sv);
+  for(const auto &field: cConfigFields) {
+    const void *value = field.locate(config);
+    switch(field.type) {
+    case FieldType::F32:
+      log.print(String<>::formatted("  {}.{}: {}", field.name.section, field.name.key, *static_cast<const f32*>(value)));
+      break;
+    case FieldType::S16:
+      log.print(String<>::formatted("  {}.{}: {}", field.name.section, field.name.key, *static_cast<const s16*>(value)));
+      break;
+    case FieldType::S32:
+      log.print(String<>::formatted("  {}.{}: {}", field.name.section, field.name.key, *static_cast<const s32*>(value)));
+      break;
+    case FieldType::String:
+      log.print(String<>::formatted("  {}.{}: {}", field.name.section, field.name.key, *static_cast<const String<>*>(value)));
+      break;
+    default:
+      break;
+    }
   }
-  out.water.scissorX = static_cast<f32>(scissorXV->number());
+  log.print(String<>::formatted("  store: {} items", config.store.size()));
+}
 
-  const auto *scissorYV = waterObject.get("scissorY");
-  if(scissorYV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `scissorY` in key in `water` object.");
-    return false;
-  }
-  if(!scissorYV->isNumber()) {
-    dialog::error("Config",
+bool Config::parse(StringView raw, ParseLog &log) {
+  JsonReader reader{raw};
+  if(reader.peek() != JsonReader::Object) {
+    if(reader.failed() || reader.peek() == JsonReader::Invalid) {
+      return syntaxError(reader, log);
+    }
+    log.fail("Config", String<>::formatted(
       "Configuration file is invalid.\n"
-      "`scissorY` in `water` object is not a number.");
+      "Not an object."));
     return false;
   }
-  out.water.scissorY = static_cast<f32>(scissorYV->number());
+  reader.beginObject();
 
-  const auto *scissorWV = waterObject.get("scissorW");
-  if(scissorWV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `scissorW` in key in `water` object.");
-    return false;
+  SeenMask seen = 0;
+  SeenMask present = 0;
+  bool hasStore = false;
+  StringView keyView;
+  while(reader.nextKey(keyView)) {
+    std::string_view key{keyView.begin(), keyView.size()};
+    if(key == "store") {
+      if(!loadStore(*this, reader, log)) {
+        return reader.failed() ? syntaxError(reader, log) : false;
+      }
+      hasStore = true;
+      continue;
+    }
+    // the key is only valid until the next read
+    LoadString section{key.begin(), key.end()};
+    if(!loadSection(*this, reader, section, seen, present, log)) {
+      return reader.failed() ? syntaxError(reader, log) : false;
+    }
   }
-  if(!scissorWV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`scissorW` in `water` object is not a number.");
-    return false;
+  if(!reader.finish()) {
+    return syntaxError(reader, log);
   }
-  out.water.scissorW = static_cast<f32>(scissorWV->number());
 
-  const auto *scissorHV = waterObject.get("scissorH");
-  if(scissorHV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `scissorH` in key in `water` object.");
-    return false;
+  for(usize i = 0; i < cConfigFields.size(); ++i) {
+    if((seen & (SeenMask(1) << i)) == 0) {
+      const auto &field = cConfigFields[i];
+      if((present & (SeenMask(1) << i)) == 0) {
+        log.fail("Config", String<>::formatted(
+          "Configuration file is invalid.\n"
+          "No `{}` key.",
+          field.name.section));
+        return false;
+      }
+      log.fail("Config", String<>::formatted(
+        "Configuration file is invalid.\n"
+        "No `{}` key in `{}` object.",
+        field.name.key, field.name.section));
+      return false;
+    }
   }
-  if(!scissorHV->isNumber()) {
-    dialog::error("Config",
+  if(!hasStore) {
+    log.fail("Config", String<>::formatted(
       "Configuration file is invalid.\n"
-      "`scissorH` in `water` object is not a number.");
+      "No `store` key."));
     return false;
   }
-  out.water.scissorH = static_cast<f32>(scissorHV->number());
 
   return true;
 }
 
-bool loadShitter(Config &out, const json::Object &root) {
-  const auto *shitterV = root.get("shitter");
-  if(shitterV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `shitter` key.");
-    return false;
-  }
-  if(!shitterV->isObject()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`shitter` is not a object.");
-    return false;
-  }
-  const auto &shitterObject = shitterV->object();
-
-  const auto *xPosV = shitterObject.get("xPos");
-  if(xPosV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `xPos` in key in `shitter` object.");
+/* The loader the one above replaced: parses the whole file into a json::Value
+   tree, then looks every field up in it and copies the store text into one
+   String<> each. Only kept to compare against in sbs.benchConfig. */
+static bool loadTree(Config &out, StringView raw) {
+  auto res = json::parse(raw);
+  if(res.error != json::OK || !res.value->isObject()) {
     return false;
   }
-  if(!xPosV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`xPos` in `shitter` object is not a number.");
-    return false;
-  }
-  out.shitter.xPos = static_cast<f32>(xPosV->number());
+  const auto &root = res.value->object();
 
-  const auto *yPosV = shitterObject.get("yPos");
-  if(yPosV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `yPos` in key in `shitter` object.");
-    return false;
-  }
-  if(!yPosV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`yPos` in `shitter` object is not a number.");
-    return false;
+  for(const auto &field: cConfigFields) {
+    const auto *sectionV = root.get({field.name.section.data(), field.name.section.size()});
+    if(sectionV == nullptr || !sectionV->isObject()) {
+      return false;
+    }
+    const auto *valueV = sectionV->object().get({field.name.key.data(), field.name.key.size()});
+    if(valueV == nullptr) {
+      return false;
+    }
+    void *target = field.locate(out);
+    if(field.type == FieldType::String) {
+      if(!valueV->isString()) {
+        return false;
+      }
+      *static_cast<String<>*>(target) = valueV->string();
+      continue;
+    }
+    if(!valueV->isNumber()) {
+      return false;
+    }
+    switch(field.type) {
+    case FieldType::F32:
+      *static_cast<f32*>(target) = static_cast<f32>(valueV->number());
+      break;
+    case FieldType::S16:
+      *static_cast<s16*>(target) = static_cast<s16>(valueV->number());
+      break;
+    case FieldType::S32:
+      *static_cast<s32*>(target) = static_cast<s32>(valueV->number());
+      break;
+    default:
+      break;
+    }
   }
-  out.shitter.yPos = static_cast<f32>(yPosV->number());
 
-  const auto *widthV = shitterObject.get("width");
-  if(widthV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `width` in key in `shitter` object.");
+  const auto *storeV = root.get("store");
+  if(storeV == nullptr || !storeV->isArray()) {
     return false;
   }
-  if(!widthV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`width` in `shitter` object is not a number.");
-    return false;
+  const auto &storeArray = storeV->array();
+  Array<String<>> text{storeArray.size() * 2};
+  for(usize i = 0; i < storeArray.size(); ++i) {
+    if(!storeArray[i].isObject()) {
+      return false;
+    }
+    const auto &itemObject = storeArray[i].object();
+    for(const auto &field: cItemFields) {
+      const auto *valueV = itemObject.get({field.name.key.data(), field.name.key.size()});
+      if(valueV == nullptr) {
+        if(field.required) {
+          return false;
+        }
+        continue;
+      }
+      if(field.type == FieldType::Text) {
+        if(!valueV->isString()) {
+          return false;
+        }
+        text[i * 2 + (field.name.key == "desc")] = valueV->string();
+      }
+    }
   }
-  out.shitter.width = static_cast<f32>(widthV->number());
+  return true;
+}
 
-  const auto *heightV = shitterObject.get("height");
-  if(heightV == nullptr) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "No `height` in key in `shitter` object.");
-    return false;
+void benchmarkConfig(StringView raw, usize iterations) {
+  iterations = std::max<usize>(iterations, 1);
+
+  BenchResult arena, heap, tree;
+  bool ok = bench(iterations, arena, [raw]{
+    LoadScope scope;
+    Config config;
+    ParseLog log;
+    return config.parse(raw, log);
+  });
+  ok = ok && bench(iterations, heap, [raw]{
+    Config config;
+    ParseLog log;
+    return config.parse(raw, log);
+  });
+  if(!ok) {
+    console::error("cfg.json did not load, not benchmarking");
+    return;
+  }
+  if(!bench(iterations, tree, [raw]{
+    Config config;
+    return loadTree(config, raw);
+  })) {
+    console::error("cfg.json did not load with the old loader, not benchmarking");
+    return;
+  }
+
+  console::print("cfg.json, {} bytes, {} iterations:", raw.size(), iterations);
+  printBench("single-pass loader, arena", arena);
+  printBench("single-pass loader, heap", heap);
+  printBench("old json::parse tree loader", tree);
+  if(!AllocationCounter::cSupported) {
+    console::print("  (allocations are only counted in debug builds)");
   }
-  if(!heightV->isNumber()) {
-    dialog::error("Config",
-      "Configuration file is invalid.\n"
-      "`height` in `shitter` object is not a number.");
-    return false;
-  }
-  out.shitter.height = static_cast<f32>(heightV->number());
-
-  return true;
 }
 
-} // namespace sbs
\ No newline at end of file
+} // namespace sbs
@@ -6,6 +6,10 @@ config.hpp
 The config
 */
 
+#include "StringPool.hpp"
+#include "blob.hpp"
+#include "data.hpp"
+#include <memory>
 #include <nwge/common/def.h>
 #include <nwge/common/array.hpp>
 #include <nwge/common/string.hpp>
@@ -26,8 +30,9 @@ struct StoreItem {
   s16 price = 1;
   s16 icon = 0;
   s32 prestige = 0; // minimum prestige level for item to be available
-  nwge::String<> name;
-  nwge::String<> desc;
+  // both point into Config::strings
+  nwge::StringView name;
+  nwge::StringView desc;
 };
 
 struct Config {
@@ -39,12 +44,16 @@ struct Config {
     f32 base;
     f32 upgrade;
     s16 maxTier;
+
+    bool operator==(const Lube&) const = default;
   } lube;
   struct Gravity {
     f32 base;
     f32 upgrade;
     f32 threshold;
     s16 maxTier;
+
+    bool operator==(const Gravity&) const = default;
   } gravity;
   struct Oxy {
     f32 regenFast;
@@ -52,17 +61,23 @@ struct Config {
     f32 drain;
     f32 min;
     f32 cooldown;
+
+    bool operator==(const Oxy&) const = default;
   } oxy;
   struct Toilet {
     f32 xPos;
     f32 yPos;
     f32 size;
+
+    bool operator==(const Toilet&) const = default;
   } toilet;
   struct Shitter {
     f32 xPos;
     f32 yPos;
     f32 width;
     f32 height;
+
+    bool operator==(const Shitter&) const = default;
   } shitter;
   struct Brick {
     f32 xPos;
@@ -70,6 +85,8 @@ struct Config {
     f32 endY;
     f32 fallSpeed;
     f32 size;
+
+    bool operator==(const Brick&) const = default;
   } brick;
   struct Water {
     f32 minX;
@@ -82,10 +99,40 @@ struct Config {
     f32 scissorY;
     f32 scissorW;
     f32 scissorH;
+
+    bool operator==(const Water&) const = default;
   } water;
   nwge::Array<StoreItem> store;
+  /* text of the store items */
+  StringPool strings;
 
   bool load(nwge::data::RW &file);
+  bool parse(nwge::StringView raw, ParseLog &log);
+  bool parseBlob(const blob::View &view, ParseLog &log);
 };
 
+using ConfigPtr = std::shared_ptr<const Config>;
+
+/* The config is parsed once per process and never changes afterwards, except
+   in debug builds when cfg.json is edited (see ConfigWatcher.hpp). Returns
+   null until cfg.json has been parsed. */
+ConfigPtr sharedConfig();
+
+#ifdef DEBUG
+/* Replaces the shared config. States holding the old one keep it. */
+void replaceSharedConfig(ConfigPtr config);
+#endif
+
+/* Loader which parses cfg.json into the shared config, see
+   CachedBundle::nqConfig. */
+struct ConfigSnapshot {
+  bool parse(nwge::StringView raw, ParseLog &log);
+  bool parseBlob(const blob::View &view, nwge::Array<char> &&bytes, ParseLog &log);
+};
+
+/* Times the config loader, with and without the load arena, against building
+   a json::parse tree of the same text, and prints the results to the
+   console. */
+void benchmarkConfig(nwge::StringView raw, usize iterations);
+
 } // namespace sbs
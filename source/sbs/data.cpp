@@ -0,0 +1,117 @@
+#include "data.hpp"
+#include "compress.hpp"
+#include <nwge/console.hpp>
+#include <nwge/dialog.hpp>
+#include <SDL2/SDL_error.h>
+#include <SDL2/SDL_rwops.h>
+
+using namespace nwge;
+
+namespace sbs {
+
+bool readAll(data::RW &file, Array<char> &out) {
+  s64 size = file.size();
+  if(size < 0) {
+    console::error("Could not determine file size: {}", SDL_GetError());
+    return false;
+  }
+  out = Array<char>{usize(size)};
+  if(size == 0) {
+    return true;
+  }
+  if(!file.read(out.view())) {
+    console::error("Could not read file: {}", SDL_GetError());
+    return false;
+  }
+  if(compress::isPacked(viewOf(out))) {
+    Array<char> raw;
+    if(!compress::unpack(viewOf(out), raw)) {
+      console::error("Could not unpack file: damaged or unknown compression");
+      return false;
+    }
+    out = std::move(raw);
+  }
+  return true;
+}
+
+bool readAll(data::RW &file, LoadVector<char> &out) {
+  s64 size = file.size();
+  if(size < 0) {
+    console::error("Could not determine file size: {}", SDL_GetError());
+    return false;
+  }
+  out.resize(usize(size));
+  if(size == 0) {
+    return true;
+  }
+  if(!file.read({out.data(), out.size()})) {
+    console::error("Could not read file: {}", SDL_GetError());
+    return false;
+  }
+  StringView packed{out.data(), out.size()};
+  usize rawSize;
+  if(compress::unpackedSize(packed, rawSize)) {
+    LoadVector<char> raw(rawSize);
+    if(!compress::unpackInto(packed, raw.data(), raw.size())) {
+      console::error("Could not unpack file: damaged or unknown compression");
+      return false;
+    }
+    out = std::move(raw);
+  } else if(compress::isPacked(packed)) {
+    console::error("Could not unpack file: damaged or unknown compression");
+    return false;
+  }
+  return true;
+}
+
+bool loadUnpacked(data::RW &file, const std::function<bool(data::RW&)> &load) {
+  Array<char> bytes;
+  if(!readAll(file, bytes)) {
+    return false;
+  }
+  data::RW unpacked{SDL_RWFromConstMem(bytes.begin(), int(bytes.size()))};
+  return load(unpacked);
+}
+
+void ParseLog::fail(const char *title, String<> &&message) {
+  if(mTitle == nullptr) {
+    mTitle = title;
+    mError = std::move(message);
+  }
+}
+
+void ParseLog::note(String<> &&line) {
+  mLines.push_back({Note, std::move(line)});
+}
+
+void ParseLog::print(String<> &&line) {
+  mLines.push_back({Print, std::move(line)});
+}
+
+void ParseLog::error(String<> &&line) {
+  mLines.push_back({Error, std::move(line)});
+}
+
+void ParseLog::report() {
+  for(const auto &line: mLines) {
+    switch(line.kind) {
+    case Print:
+      console::print("{}", line.text);
+      break;
+    case Note:
+      console::note("{}", line.text);
+      break;
+    case Error:
+      console::error("{}", line.text);
+      break;
+    }
+  }
+  mLines.clear();
+  if(mTitle != nullptr) {
+    dialog::error(mTitle, "{}", mError);
+    mTitle = nullptr;
+    mError = String<>{};
+  }
+}
+
+} // namespace sbs
@@ -0,0 +1,82 @@
+#pragma once
+
+/*
+data.hpp
+--------
+Helpers for custom data file loaders
+*/
+
+#include "arena.hpp"
+#include <functional>
+#include <vector>
+#include <nwge/common/array.hpp>
+#include <nwge/common/string.hpp>
+#include <nwge/data/rw.hpp>
+
+namespace sbs {
+
+/* Reads the entire file into `out`, unpacking it if the bundle step packed
+   it. */
+bool readAll(nwge::data::RW &file, nwge::Array<char> &out);
+
+/* Same, into the load arena if a LoadScope is open. */
+bool readAll(nwge::data::RW &file, LoadVector<char> &out);
+
+inline nwge::StringView viewOf(const nwge::Array<char> &bytes) {
+  return {bytes.begin(), bytes.size()};
+}
+
+/* Reads the entire file, unpacking it if needed, and calls `load` with it as
+   a file of its own. For the engine's loaders, which cannot unpack entries. */
+bool loadUnpacked(nwge::data::RW &file, const std::function<bool(nwge::data::RW&)> &load);
+
+/* Something the engine loads, enqueued through loadUnpacked(). */
+template<typename T>
+struct Unpacked {
+  T value;
+
+  bool load(nwge::data::RW &file) {
+    return loadUnpacked(file, [this](nwge::data::RW &unpacked){
+      return value.load(unpacked);
+    });
+  }
+};
+
+/* What parsing a data file has to say. Data files are parsed on worker
+   threads, which must not open dialogs or print, so the parser leaves its
+   messages here and report() shows them on the main thread. */
+class ParseLog {
+public:
+  /* Keeps `message` for an error dialog titled `title`. Only the first error
+     is kept. */
+  void fail(const char *title, nwge::String<> &&message);
+  void note(nwge::String<> &&line);
+  void print(nwge::String<> &&line);
+  /* Prints `line` as an error, without a dialog. */
+  void error(nwge::String<> &&line);
+
+  [[nodiscard]] inline bool failed() const {
+    return mTitle != nullptr;
+  }
+
+  /* Prints the lines, shows the error, then forgets all of it. */
+  void report();
+
+private:
+  enum Kind: u8 {
+    Print,
+    Note,
+    Error,
+  };
+
+  struct Line {
+    Kind kind;
+    nwge::String<> text;
+  };
+
+  const char *mTitle = nullptr;
+  nwge::String<> mError;
+  std::vector<Line> mLines;
+};
+
+} // namespace sbs
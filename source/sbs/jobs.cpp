@@ -0,0 +1,108 @@
+#include "jobs.hpp"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sbs::jobs {
+
+static thread_local bool gOnWorker = false;
+
+namespace {
+
+class Pool {
+public:
+  Pool() {
+    usize count = std::thread::hardware_concurrency();
+    // leave one core for the main thread
+    count = count > 2 ? count - 1 : 1;
+    mWorkers.reserve(count);
+    for(usize i = 0; i < count; ++i) {
+      mWorkers.emplace_back([this]{
+        work();
+      });
+    }
+  }
+
+  Pool(const Pool&) = delete;
+  Pool(Pool&&) = delete;
+  Pool &operator=(const Pool&) = delete;
+  Pool &operator=(Pool&&) = delete;
+
+  ~Pool() {
+    {
+      std::lock_guard lock{mMutex};
+      mStop = true;
+    }
+    mWake.notify_all();
+    for(auto &worker: mWorkers) {
+      worker.join();
+    }
+  }
+
+  std::shared_future<bool> submit(std::function<bool()> &&job) {
+    auto task = std::make_shared<std::packaged_task<bool()>>(std::move(job));
+    std::shared_future<bool> result = task->get_future().share();
+    {
+      std::lock_guard lock{mMutex};
+      mQueue.emplace_back([task]{
+        (*task)();
+      });
+    }
+    mWake.notify_one();
+    return result;
+  }
+
+  [[nodiscard]] usize size() const {
+    return mWorkers.size();
+  }
+
+private:
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::deque<std::function<void()>> mQueue;
+  std::vector<std::thread> mWorkers;
+  bool mStop = false;
+
+  void work() {
+    gOnWorker = true;
+    for(;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock lock{mMutex};
+        mWake.wait(lock, [this]{
+          return mStop || !mQueue.empty();
+        });
+        if(mStop && mQueue.empty()) {
+          return;
+        }
+        job = std::move(mQueue.front());
+        mQueue.pop_front();
+      }
+      job();
+    }
+  }
+};
+
+Pool &pool() {
+  static Pool sPool;
+  return sPool;
+}
+
+} // namespace
+
+std::shared_future<bool> submit(std::function<bool()> job) {
+  return pool().submit(std::move(job));
+}
+
+usize workerCount() {
+  return pool().size();
+}
+
+bool onWorker() {
+  return gOnWorker;
+}
+
+} // namespace sbs::jobs
@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+jobs.hpp
+--------
+Worker thread pool for background loading
+*/
+
+#include <functional>
+#include <future>
+#include <nwge/common/def.h>
+
+namespace sbs::jobs {
+
+/* Runs `job` on a worker thread. The returned future yields the job's result
+   once it is done. */
+std::shared_future<bool> submit(std::function<bool()> job);
+
+/* Number of worker threads in the pool */
+usize workerCount();
+
+/* whether the calling thread is one of the pool's workers */
+bool onWorker();
+
+} // namespace sbs::jobs
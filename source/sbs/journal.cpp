@@ -0,0 +1,68 @@
+#include "journal.hpp"
+#include "blob.hpp"
+#include <cstddef>
+
+using namespace nwge;
+
+namespace sbs::journal {
+
+static u32 checksum(const Record &record) {
+  return blob::crc32(&record, offsetof(Record, crc));
+}
+
+static void push(Record *out, usize &count, u32 &seq, Record::Kind kind, s32 value) {
+  Record record{};
+  record.seq = ++seq;
+  record.kind = kind;
+  record.value = value;
+  record.crc = checksum(record);
+  out[count++] = record;
+}
+
+usize diff(const SavefileV3 &from, const SavefileV3 &to, u32 &seq, Record *out) {
+  usize count = 0;
+  if(from.score != to.score) {
+    push(out, count, seq, Record::Score, to.score - from.score);
+  }
+  if(from.lubeTier != to.lubeTier) {
+    push(out, count, seq, Record::Lube, to.lubeTier);
+  }
+  if(from.gravityTier != to.gravityTier) {
+    push(out, count, seq, Record::Gravity, to.gravityTier);
+  }
+  if(from.oxyTier != to.oxyTier) {
+    push(out, count, seq, Record::Oxy, to.oxyTier);
+  }
+  if(from.prestige != to.prestige) {
+    push(out, count, seq, Record::Prestige, to.prestige);
+  }
+  return count;
+}
+
+bool valid(const Record &record) {
+  return record.kind != Record::None && record.crc == checksum(record);
+}
+
+void apply(SavefileV3 &save, const Record &record) {
+  switch(record.kind) {
+  case Record::Score:
+    save.score += record.value;
+    break;
+  case Record::Lube:
+    save.lubeTier = s16(record.value);
+    break;
+  case Record::Gravity:
+    save.gravityTier = s16(record.value);
+    break;
+  case Record::Oxy:
+    save.oxyTier = s16(record.value);
+    break;
+  case Record::Prestige:
+    save.prestige = s16(record.value);
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace sbs::journal
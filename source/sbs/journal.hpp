@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+journal.hpp
+-----------
+Append-only log of save changes
+
+Instead of rewriting the whole save for every brick, the save writer appends
+a fixed-size record per changed field. Every record has a sequence number and
+the snapshot (save.bin) remembers the last one folded into it, so records
+the snapshot already has are skipped when the journal is replayed.
+*/
+
+#include "save.hpp"
+#include <nwge/common/def.h>
+
+namespace sbs::journal {
+
+struct Record {
+  enum Kind: u8 {
+    None,
+    Score,    // score += value
+    Lube,     // lubeTier = value
+    Gravity,  // gravityTier = value
+    Oxy,      // oxyTier = value
+    Prestige, // prestige = value
+  };
+
+  u32 seq;
+  u8 kind;
+  u8 reserved[3];
+  s32 value;
+  u32 crc; // CRC32 of everything above
+};
+static_assert(sizeof(Record) == 16);
+
+/* most records one save can turn into, one per field */
+static constexpr usize cMaxRecords = 5;
+
+/* Writes the records that turn `from` into `to` to `out`, numbering them from
+   `seq` onwards. Returns how many were written. */
+usize diff(const SavefileV3 &from, const SavefileV3 &to, u32 &seq, Record *out);
+
+/* whether the record was written whole */
+bool valid(const Record &record);
+
+void apply(SavefileV3 &save, const Record &record);
+
+} // namespace sbs::journal
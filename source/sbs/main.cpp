@@ -1,12 +1,21 @@
 #include <nwge/engine.hpp>
 #include <nwge/cli/cli.h>
+#include "saves.hpp"
+#include "startup.hpp"
 #include "states.hpp"
 
 s32 main(s32 argc, CStr *argv) {
+  sbs::markLaunch();
   nwge::cli::parse(argc, argv);
 
+  if(nwge::cli::flag("fresh")) {
+    // start over instead of resuming the suspended game
+    sbs::saves::discardSnapshot();
+  }
+
   nwge::State *statePtr;
   if(nwge::cli::flag("game")) {
+    // resumes the suspended game if there is one
     statePtr = sbs::getShitState({});
   } else if(nwge::cli::flag("menu")) {
     statePtr = sbs::getMenuState({});
@@ -22,5 +31,6 @@ s32 main(s32 argc, CStr *argv) {
     .windowAspectRatio = {1, 1},
     .filterFonts = false,
   });
+  sbs::saves::shutdown();
   return 0;
 }
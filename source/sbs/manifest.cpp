@@ -0,0 +1,48 @@
+#include "manifest.hpp"
+
+using namespace nwge;
+
+namespace sbs {
+
+static const AssetManifest::Entry cMenuEntries[] = {
+  {AssetManifest::Animation, "sbs2024.gif"_sv},
+  {AssetManifest::Texture, "brick.png"_sv},
+  {AssetManifest::Font, "GrapeSoda.cfn"_sv},
+  {AssetManifest::Texture, "vignette.png"_sv},
+  {AssetManifest::Texture, "socials.png"_sv},
+  {AssetManifest::ConfigFile, "cfg.json"_sv, "cfg.bin"_sv},
+  {AssetManifest::ReviewsFile, "reviews.json"_sv, "reviews.bin"_sv},
+};
+
+static const AssetManifest::Entry cShitEntries[] = {
+  {AssetManifest::Texture, "bars.png"_sv},
+  {AssetManifest::Texture, "brick.png"_sv},
+  {AssetManifest::Font, "GrapeSoda.cfn"_sv},
+  {AssetManifest::Texture, "water.png"_sv},
+  {AssetManifest::Texture, "bg.png"_sv},
+  {AssetManifest::ConfigFile, "cfg.json"_sv, "cfg.bin"_sv},
+  {AssetManifest::Texture, "vignette.png"_sv},
+  {AssetManifest::Texture, "icons.png"_sv},
+  {AssetManifest::SoundEffect, "splash.wav"_sv},
+  {AssetManifest::SoundEffect, "buy.wav"_sv},
+  {AssetManifest::SoundEffect, "broke.wav"_sv},
+  {AssetManifest::SoundEffect, "pop.wav"_sv},
+  {AssetManifest::SoundEffect, "breath.wav"_sv},
+  {AssetManifest::Texture, "toilet.png"_sv},
+  {AssetManifest::Texture, "toiletF.png"_sv},
+  {AssetManifest::Texture, "shitter.png"_sv},
+  {AssetManifest::Texture, "PR.JPG"_sv},
+};
+
+// the tabs load their own assets once they are opened
+static const AssetManifest::Entry cExtrasEntries[] = {
+  {AssetManifest::Font, "GrapeSoda.cfn"_sv},
+  {AssetManifest::Texture, "brick.png"_sv},
+};
+
+const AssetManifest
+  gMenuManifest{cMenuEntries},
+  gShitManifest{cShitEntries},
+  gExtrasManifest{cExtrasEntries};
+
+} // namespace sbs
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+manifest.hpp
+------------
+Lists of the assets each state loads, used to load them ahead of time
+*/
+
+#include <span>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+
+namespace sbs {
+
+struct AssetManifest {
+  enum Kind: u8 {
+    Texture     = 1 << 0,
+    Font        = 1 << 1,
+    Sound       = 1 << 2,
+    Animation   = 1 << 3,
+    ConfigFile  = 1 << 4,
+    ReviewsFile = 1 << 5,
+    SoundEffect = 1 << 6, // kept compressed, see Sfx.hpp
+  };
+
+  static constexpr u8
+    cEngine = Texture | Font | Sound | Animation | SoundEffect, // loaded by the bundle
+    cData = ConfigFile | ReviewsFile,                           // parsed on worker threads
+    cAll = cEngine | cData;
+
+  struct Entry {
+    Kind kind;
+    nwge::StringView name;
+    nwge::StringView compiled{}; // blob compiled from a data file
+  };
+
+  std::span<const Entry> entries;
+};
+
+extern const AssetManifest
+  gMenuManifest,
+  gShitManifest,
+  gExtrasManifest;
+
+} // namespace sbs
@@ -0,0 +1,52 @@
+#include "memory.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <nwge/console.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+static u64 gOverallPeak = 0;
+
+MemoryUsage memoryUsage() {
+  MemoryUsage usage{0, 0};
+  FILE *status = std::fopen("/proc/self/status", "r");
+  if(status == nullptr) {
+    return usage;
+  }
+  char line[256];
+  while(std::fgets(line, sizeof(line), status) != nullptr) {
+    unsigned long long kib = 0;
+    if(std::sscanf(line, "VmRSS: %llu kB", &kib) == 1) {
+      usage.current = u64(kib) * 1024;
+    } else if(std::sscanf(line, "VmHWM: %llu kB", &kib) == 1) {
+      usage.peak = u64(kib) * 1024;
+    }
+  }
+  std::fclose(status);
+  return usage;
+}
+
+void reportPeakMemory(const char *stage) {
+  auto usage = memoryUsage();
+  if(usage.peak == 0) {
+    return;
+  }
+  gOverallPeak = std::max(gOverallPeak, usage.peak);
+  console::note("Peak RSS {}: {:.1f} MiB, now {:.1f} MiB", stage,
+    f64(usage.peak) / (1024.0 * 1024.0), f64(usage.current) / (1024.0 * 1024.0));
+
+  // writing 5 resets the peak to the current size
+  if(FILE *clear = std::fopen("/proc/self/clear_refs", "w")) {
+    std::fputs("5", clear);
+    std::fclose(clear);
+  }
+}
+
+u64 overallPeakMemory() {
+  return gOverallPeak;
+}
+
+} // namespace sbs
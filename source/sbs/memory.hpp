@@ -0,0 +1,29 @@
+#pragma once
+
+/*
+memory.hpp
+----------
+Resident memory of the process, for comparing state transitions
+*/
+
+#include <nwge/common/def.h>
+
+namespace sbs {
+
+/* Resident set size in bytes, current and peak. Both are 0 if /proc is not
+   available. */
+struct MemoryUsage {
+  u64 current;
+  u64 peak;
+};
+
+MemoryUsage memoryUsage();
+
+/* Logs the peak resident set size since the last call, labelled `stage`, then
+   resets the peak so every stage is measured on its own. */
+void reportPeakMemory(const char *stage);
+
+/* highest peak any reportPeakMemory() call has seen */
+u64 overallPeakMemory();
+
+} // namespace sbs
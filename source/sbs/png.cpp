@@ -0,0 +1,309 @@
+#include "png.hpp"
+#include "compress.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+using namespace nwge;
+
+namespace sbs::png {
+
+static constexpr u8 cSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+namespace {
+
+enum ColorType: u8 {
+  Gray = 0,
+  RGB = 2,
+  Palette = 3,
+  GrayAlpha = 4,
+  RGBA = 6,
+};
+
+struct Info {
+  u32 width = 0;
+  u32 height = 0;
+  u8 depth = 0;
+  u8 colorType = 0;
+  u8 channels = 0;
+  std::array<u8, 256 * 4> palette{};
+  u32 paletteSize = 0;
+  /* the transparent color of gray and RGB images, if any */
+  bool keyed = false;
+  std::array<u16, 3> key{};
+};
+
+} // namespace
+
+static u32 readU32(const u8 *bytes) {
+  return (u32(bytes[0]) << 24) | (u32(bytes[1]) << 16) | (u32(bytes[2]) << 8) | bytes[3];
+}
+
+static u16 readU16(const u8 *bytes) {
+  return u16((bytes[0] << 8) | bytes[1]);
+}
+
+bool isPng(StringView file) {
+  return file.size() >= sizeof(cSignature)
+    && std::memcmp(file.begin(), cSignature, sizeof(cSignature)) == 0;
+}
+
+static bool readHeader(const u8 *data, u32 size, Info &info) {
+  if(size != 13) {
+    return false;
+  }
+  info.width = readU32(data);
+  info.height = readU32(data + 4);
+  info.depth = data[8];
+  info.colorType = data[9];
+  u8 compression = data[10];
+  u8 filter = data[11];
+  u8 interlace = data[12];
+  if(info.width == 0 || info.height == 0 || info.width > 16384 || info.height > 16384
+  || compression != 0 || filter != 0 || interlace != 0) {
+    return false;
+  }
+  switch(info.colorType) {
+  case Gray:
+    info.channels = 1;
+    return info.depth == 1 || info.depth == 2 || info.depth == 4 || info.depth == 8;
+  case Palette:
+    info.channels = 1;
+    return info.depth == 1 || info.depth == 2 || info.depth == 4 || info.depth == 8;
+  case RGB:
+    info.channels = 3;
+    return info.depth == 8;
+  case GrayAlpha:
+    info.channels = 2;
+    return info.depth == 8;
+  case RGBA:
+    info.channels = 4;
+    return info.depth == 8;
+  default:
+    return false;
+  }
+}
+
+static bool readPalette(const u8 *data, u32 size, Info &info) {
+  if(size % 3 != 0 || size / 3 > 256 || size == 0) {
+    return false;
+  }
+  info.paletteSize = size / 3;
+  for(u32 i = 0; i < info.paletteSize; ++i) {
+    info.palette[i * 4 + 0] = data[i * 3 + 0];
+    info.palette[i * 4 + 1] = data[i * 3 + 1];
+    info.palette[i * 4 + 2] = data[i * 3 + 2];
+    info.palette[i * 4 + 3] = 0xFF;
+  }
+  return true;
+}
+
+static bool readTransparency(const u8 *data, u32 size, Info &info) {
+  switch(info.colorType) {
+  case Palette:
+    if(size > info.paletteSize) {
+      return false;
+    }
+    for(u32 i = 0; i < size; ++i) {
+      info.palette[i * 4 + 3] = data[i];
+    }
+    return true;
+  case Gray:
+    if(size != 2) {
+      return false;
+    }
+    info.keyed = true;
+    info.key[0] = readU16(data);
+    return true;
+  case RGB:
+    if(size != 6) {
+      return false;
+    }
+    info.keyed = true;
+    for(usize i = 0; i < 3; ++i) {
+      info.key[i] = readU16(data + i * 2);
+    }
+    return true;
+  default:
+    // images with an alpha channel have no use for it
+    return false;
+  }
+}
+
+static u8 paeth(u8 left, u8 up, u8 upLeft) {
+  s32 estimate = s32(left) + up - upLeft;
+  s32 toLeft = std::abs(estimate - left);
+  s32 toUp = std::abs(estimate - up);
+  s32 toUpLeft = std::abs(estimate - upLeft);
+  if(toLeft <= toUp && toLeft <= toUpLeft) {
+    return left;
+  }
+  return toUp <= toUpLeft ? up : upLeft;
+}
+
+/* Undoes the filters in place. Each row starts with its filter type. */
+static bool unfilter(u8 *data, usize rowSize, u32 height, usize pixelSize) {
+  const u8 *prev = nullptr;
+  for(u32 y = 0; y < height; ++y) {
+    u8 filter = *data++;
+    u8 *row = data;
+    switch(filter) {
+    case 0:
+      break;
+    case 1:
+      for(usize x = pixelSize; x < rowSize; ++x) {
+        row[x] = u8(row[x] + row[x - pixelSize]);
+      }
+      break;
+    case 2:
+      if(prev != nullptr) {
+        for(usize x = 0; x < rowSize; ++x) {
+          row[x] = u8(row[x] + prev[x]);
+        }
+      }
+      break;
+    case 3:
+      for(usize x = 0; x < rowSize; ++x) {
+        u32 left = x >= pixelSize ? row[x - pixelSize] : 0;
+        u32 up = prev != nullptr ? prev[x] : 0;
+        row[x] = u8(row[x] + (left + up) / 2);
+      }
+      break;
+    case 4:
+      for(usize x = 0; x < rowSize; ++x) {
+        u8 left = x >= pixelSize ? row[x - pixelSize] : 0;
+        u8 up = prev != nullptr ? prev[x] : 0;
+        u8 upLeft = prev != nullptr && x >= pixelSize ? prev[x - pixelSize] : 0;
+        row[x] = u8(row[x] + paeth(left, up, upLeft));
+      }
+      break;
+    default:
+      return false;
+    }
+    prev = row;
+    data += rowSize;
+  }
+  return true;
+}
+
+/* Expands the unfiltered rows, each preceded by its filter type byte, to
+   RGBA. */
+static void expand(const u8 *data, usize rowSize, const Info &info, u8 *out) {
+  u32 sampleMax = (1u << info.depth) - 1;
+  for(u32 y = 0; y < info.height; ++y) {
+    const u8 *row = data + usize(y) * (rowSize + 1) + 1;
+    for(u32 x = 0; x < info.width; ++x, out += 4) {
+      switch(info.colorType) {
+      case Gray:
+      case Palette: {
+        u32 bit = x * info.depth;
+        u32 sample = (row[bit / 8] >> (8 - info.depth - bit % 8)) & sampleMax;
+        if(info.colorType == Palette) {
+          // indices past the palette are black, like in most decoders
+          if(sample < info.paletteSize) {
+            std::memcpy(out, &info.palette[sample * 4], 4);
+          } else {
+            out[0] = out[1] = out[2] = 0;
+            out[3] = 0xFF;
+          }
+          break;
+        }
+        auto gray = u8(sample * 255 / sampleMax);
+        out[0] = out[1] = out[2] = gray;
+        out[3] = info.keyed && sample == info.key[0] ? 0 : 0xFF;
+        break;
+      }
+      case RGB: {
+        const u8 *pixel = row + usize(x) * 3;
+        out[0] = pixel[0];
+        out[1] = pixel[1];
+        out[2] = pixel[2];
+        out[3] = info.keyed && pixel[0] == info.key[0] && pixel[1] == info.key[1]
+          && pixel[2] == info.key[2] ? 0 : 0xFF;
+        break;
+      }
+      case GrayAlpha: {
+        const u8 *pixel = row + usize(x) * 2;
+        out[0] = out[1] = out[2] = pixel[0];
+        out[3] = pixel[1];
+        break;
+      }
+      default:
+        std::memcpy(out, row + usize(x) * 4, 4);
+        break;
+      }
+    }
+  }
+}
+
+bool decode(StringView file, Image &out) {
+  if(!isPng(file)) {
+    return false;
+  }
+  const auto *bytes = reinterpret_cast<const u8*>(file.begin());
+  usize offset = sizeof(cSignature);
+  Info info;
+  bool sawHeader = false;
+  bool sawEnd = false;
+  std::vector<u8> compressed;
+  while(!sawEnd) {
+    if(file.size() - offset < 12) {
+      return false;
+    }
+    u32 size = readU32(bytes + offset);
+    const u8 *type = bytes + offset + 4;
+    const u8 *data = bytes + offset + 8;
+    if(size > file.size() - offset - 12) {
+      return false;
+    }
+    offset += usize(size) + 12;
+
+    if(std::memcmp(type, "IHDR", 4) == 0) {
+      if(sawHeader || !readHeader(data, size, info)) {
+        return false;
+      }
+      sawHeader = true;
+      continue;
+    }
+    if(!sawHeader) {
+      return false;
+    }
+    if(std::memcmp(type, "PLTE", 4) == 0) {
+      // RGB images may suggest a palette, which is of no use here
+      if(info.colorType == Palette && !readPalette(data, size, info)) {
+        return false;
+      }
+    } else if(std::memcmp(type, "tRNS", 4) == 0) {
+      if(!readTransparency(data, size, info)) {
+        return false;
+      }
+    } else if(std::memcmp(type, "IDAT", 4) == 0) {
+      compressed.insert(compressed.end(), data, data + size);
+    } else if(std::memcmp(type, "IEND", 4) == 0) {
+      sawEnd = true;
+    } else if((type[0] & 0x20) == 0) {
+      // an unknown critical chunk, which may change how to read the pixels
+      return false;
+    }
+  }
+  if(info.colorType == Palette && info.paletteSize == 0) {
+    return false;
+  }
+
+  usize rowSize = (usize(info.width) * info.channels * info.depth + 7) / 8;
+  usize pixelSize = std::max<usize>(info.channels * info.depth / 8, 1);
+  std::vector<u8> filtered((rowSize + 1) * info.height);
+  if(!compress::inflate(compressed.data(), compressed.size(), filtered.data(), filtered.size())
+  || !unfilter(filtered.data(), rowSize, info.height, pixelSize)) {
+    return false;
+  }
+
+  out.width = info.width;
+  out.height = info.height;
+  out.pixels.resize(usize(info.width) * info.height * 4);
+  expand(filtered.data(), rowSize, info, out.pixels.data());
+  return true;
+}
+
+} // namespace sbs::png
@@ -0,0 +1,32 @@
+#pragma once
+
+/*
+png.hpp
+-------
+PNG decoder for textures
+
+Lets textures be decoded on worker threads, instead of by the engine on the
+main thread. Only the kinds of PNG the game ships are handled; for anything
+else decode() returns false and the engine decodes the file as before.
+*/
+
+#include <vector>
+#include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
+
+namespace sbs::png {
+
+struct Image {
+  u32 width = 0;
+  u32 height = 0;
+  std::vector<u8> pixels; // RGBA rows, top to bottom
+};
+
+/* Whether `file` starts with the PNG signature. */
+bool isPng(nwge::StringView file);
+
+/* Decodes `file` into `out`. Returns false if it is damaged, interlaced, or
+   has 16-bit channels. Chunk CRCs are not checked. */
+bool decode(nwge::StringView file, Image &out);
+
+} // namespace sbs::png
@@ -0,0 +1,180 @@
+#include "reviews.hpp"
+#include "JsonReader.hpp"
+#include "arena.hpp"
+#include "bench.hpp"
+#include "data.hpp"
+#include <array>
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <nwge/console.hpp>
+#include <nwge/dialog.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+bool Reviews::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> data;
+  if(!readAll(file, data)) {
+    dialog::error("Error", "Could not load reviews: I/O error");
+    return false;
+  }
+  ParseLog log;
+  bool ok = parse({data.data(), data.size()}, log);
+  log.report();
+  if(!ok) {
+    return false;
+  }
+  console::note("Loaded {} reviews.", entries.size());
+  return true;
+}
+
+/* Makes `value` outlive the reader's next read. */
+static StringView hold(const JsonReader &reader, StringView value, LoadString &storage) {
+  if(reader.inText(value)) {
+    return value;
+  }
+  storage.assign(value.begin(), value.size());
+  return {storage.data(), storage.size()};
+}
+
+bool Reviews::parse(StringView raw, ParseLog &log) {
+  JsonReader reader{raw};
+  if(reader.peek() != JsonReader::Array) {
+    if(reader.failed() || reader.peek() == JsonReader::Invalid) {
+      log.fail("Error", String<>::formatted("Could not load reviews: Invalid JSON ({})",
+        reader.error()));
+      return false;
+    }
+    log.fail("Error", String<>::formatted("Could not load reviews: Not an array"));
+    return false;
+  }
+  reader.beginArray();
+
+  StringPool::Builder builder;
+  LoadVector<blob::Str> spans;
+  LoadString personStorage;
+  LoadString quoteStorage;
+  while(reader.nextElement()) {
+    usize idx = spans.size();
+    if(reader.peek() != JsonReader::Object) {
+      if(reader.failed()) {
+        break;
+      }
+      log.fail("Error", String<>::formatted("Could not load review {}: Not an object",
+        idx));
+      return false;
+    }
+    reader.beginObject();
+
+    StringView person;
+    StringView quote;
+    f64 rating = 0;
+    bool hasPerson = false;
+    bool hasQuote = false;
+    bool hasRating = false;
+    StringView keyView;
+    while(reader.nextKey(keyView)) {
+      std::string_view key{keyView.begin(), keyView.size()};
+      if(key == "person" && reader.peek() == JsonReader::String) {
+        hasPerson = reader.readString(person);
+        person = hold(reader, person, personStorage);
+      } else if(key == "quote" && reader.peek() == JsonReader::String) {
+        hasQuote = reader.readString(quote);
+        quote = hold(reader, quote, quoteStorage);
+      } else if(key == "rating" && reader.peek() == JsonReader::Number) {
+        hasRating = reader.readNumber(rating);
+      } else {
+        reader.skipValue();
+      }
+    }
+    if(reader.failed()) {
+      break;
+    }
+    if(!hasPerson || !hasQuote || !hasRating) {
+      log.fail("Error", String<>::formatted("Could not load review {}: Invalid `{}`",
+        idx, !hasPerson ? "person" : !hasQuote ? "quote" : "rating"));
+      return false;
+    }
+
+    // "<quote> <rating>/10"\n   ~ <person>
+    std::array<char, 32> ratingText{};
+    auto ratingEnd = std::to_chars(ratingText.begin(), ratingText.end(), rating).ptr;
+    builder.push('"');
+    builder.append(quote);
+    builder.push(' ');
+    builder.append({ratingText.begin(), usize(ratingEnd - ratingText.begin())});
+    builder.append("/10\"\n   ~ "_sv);
+    builder.append(person);
+    spans.push_back(builder.commit());
+  }
+  if(!reader.finish()) {
+    log.fail("Error", String<>::formatted("Could not load reviews: Invalid JSON ({})",
+      reader.error()));
+    return false;
+  }
+
+  // views are only taken now, the pool does not move anymore
+  strings = builder.build();
+  entries = {spans.size()};
+  for(usize i = 0; i < entries.size(); ++i) {
+    entries[i] = strings.view(spans[i]);
+  }
+  return true;
+}
+
+bool Reviews::parseBlob(const blob::View &view, [[maybe_unused]] Array<char> &&bytes,
+  ParseLog &log)
+{
+  if(!view.fits<blob::Str>(0, view.count())) {
+    log.fail("Error", String<>::formatted("Could not load reviews: Records are out of bounds"));
+    return false;
+  }
+  LoadScope scope;
+  StringPool::Builder builder;
+  LoadVector<blob::Str> spans;
+  spans.reserve(view.count());
+  for(usize i = 0; i < view.count(); ++i) {
+    spans.push_back(builder.add(view.string(view.record<blob::Str>(i * sizeof(blob::Str)))));
+  }
+  // the blob itself is dropped, only its strings are kept
+  strings = builder.build();
+  entries = {spans.size()};
+  for(usize i = 0; i < entries.size(); ++i) {
+    entries[i] = strings.view(spans[i]);
+  }
+  log.note(String<>::formatted("Loaded {} reviews.", entries.size()));
+  return true;
+}
+
+void benchmarkReviews(StringView raw, usize iterations) {
+  iterations = std::max<usize>(iterations, 1);
+
+  BenchResult arena, heap;
+  bool ok = bench(iterations, arena, [raw]{
+    LoadScope scope;
+    Reviews reviews;
+    ParseLog log;
+    return reviews.parse(raw, log);
+  });
+  ok = ok && bench(iterations, heap, [raw]{
+    Reviews reviews;
+    ParseLog log;
+    return reviews.parse(raw, log);
+  });
+  if(!ok) {
+    console::error("reviews.json did not load, not benchmarking");
+    return;
+  }
+
+  console::print("reviews.json, {} bytes, {} iterations:", raw.size(), iterations);
+  printBench("single-pass loader, arena", arena);
+  printBench("single-pass loader, heap", heap);
+  if(!AllocationCounter::cSupported) {
+    console::print("  (allocations are only counted in debug builds)");
+  }
+}
+
+} // namespace sbs
@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+reviews.hpp
+-----------
+Reviews shown in the main menu
+*/
+
+#include "StringPool.hpp"
+#include "blob.hpp"
+#include "data.hpp"
+#include <nwge/common/array.hpp>
+#include <nwge/common/string.hpp>
+#include <nwge/data/rw.hpp>
+
+namespace sbs {
+
+struct Reviews {
+  nwge::Array<nwge::StringView> entries;
+
+  /* the formatted reviews `entries` point into, repeated ones stored once */
+  StringPool strings;
+
+  bool load(nwge::data::RW &file);
+  bool parse(nwge::StringView raw, ParseLog &log);
+  bool parseBlob(const blob::View &view, nwge::Array<char> &&bytes, ParseLog &log);
+};
+
+/* Times the reviews loader with and without the load arena, and prints the
+   results to the console. */
+void benchmarkReviews(nwge::StringView raw, usize iterations);
+
+} // namespace sbs
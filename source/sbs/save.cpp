@@ -1,9 +1,20 @@
 #include "save.hpp"
+#include "JsonReader.hpp"
+#include "arena.hpp"
+#include "bench.hpp"
+#include "blob.hpp"
+#include "check.hpp"
+#include "data.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
 #include <SDL2/SDL_error.h>
-#include <nwge/common/array.hpp>
+#include <SDL2/SDL_rwops.h>
 #include <nwge/console.hpp>
 #include <nwge/json/builder.hpp>
-#include <nwge/json/Schema.hpp>
 
 using namespace nwge;
 
@@ -27,82 +38,351 @@ bool SavefileV1::load(data::RW &file) {
   return true;
 }
 
-bool SavefileV2::load(data::RW &file) {
-  s64 size = file.size();
-  if(size < 0) {
-    return true;
-  }
-  if(size == 0) {
-    return true;
+SavefileV2 SavefileV1::migrate() const {
+  SavefileV2 out;
+  out.loaded = true;
+  out.score = score;
+  out.lubeTier = lubeTier;
+  out.gravityTier = gravityTier;
+  out.prestige = prestige;
+  out.oxyTier = oxyTier;
+  return out;
+}
+
+/* Reads a number field into `out`, leaving it as it was if the value is not a
+   number. */
+template<typename T>
+static void readSaveField(JsonReader &reader, StringView key, T &out, ParseLog &log) {
+  f64 value;
+  if(reader.peek() != JsonReader::Number || !reader.readNumber(value)) {
+    log.error(String<>::formatted("Could not load save file: `{}` is not a number.", key));
+    reader.skipValue();
+    return;
   }
+  out = T(value);
+}
 
-  ScratchArray<char> raw{usize(size)};
-  if(!file.read(raw.view())) {
+bool SavefileV2::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> raw;
+  if(!readAll(file, raw)) {
     console::error("Could not load save file: {}", SDL_GetError());
     return true;
   }
+  ParseLog log;
+  bool parsed = parse({raw.data(), raw.size()}, log);
+  log.report();
+  return parsed;
+}
 
-  auto res = json::parse(raw.view());
-  if(res.error != json::OK) {
-    console::error("Could not load save file: {}", json::errorMessage(res.error));
+bool SavefileV2::parse(StringView raw, ParseLog &log) {
+  if(raw.size() == 0) {
     return true;
   }
 
-  auto root = json::Schema::object(*res.value);
-  if(!root.present()) {
-    console::error("Could not load save file: Not an object.");
+  JsonReader reader{raw};
+  if(!reader.beginObject()) {
+    log.error(String<>{"Could not load save file: Not an object."_sv});
     return true;
   }
 
-  auto maybeScore = root->expectNumberField("score"_sv);
-  if(maybeScore.present()) {
-    score = s32(*maybeScore);
+  // nothing is kept from a file that is not valid JSON, e.g. one written
+  // partially, but fields of the wrong type are only skipped
+  SavefileV2 read = *this;
+  StringView keyView;
+  while(reader.nextKey(keyView)) {
+    std::string_view key{keyView.begin(), keyView.size()};
+    if(key == "score") {
+      readSaveField(reader, keyView, read.score, log);
+    } else if(key == "lubeTier") {
+      readSaveField(reader, keyView, read.lubeTier, log);
+    } else if(key == "gravityTier") {
+      readSaveField(reader, keyView, read.gravityTier, log);
+    } else if(key == "prestige") {
+      readSaveField(reader, keyView, read.prestige, log);
+    } else if(key == "oxyTier") {
+      readSaveField(reader, keyView, read.oxyTier, log);
+    } else if(key == "journalSeq") {
+      readSaveField(reader, keyView, read.journalSeq, log);
+    } else {
+      reader.skipValue();
+    }
   }
-
-  auto maybeLubeTier = root->expectNumberField("lubeTier"_sv);
-  if(maybeLubeTier.present()) {
-    lubeTier = s16(*maybeLubeTier);
-  }
-
-  auto maybeGravityTier = root->expectNumberField("GravityTier"_sv);
-  if(maybeGravityTier.present()) {
-    gravityTier = s16(*maybeGravityTier);
-  }
-
-  auto maybePrestige = root->expectNumberField("prestige"_sv);
-  if(maybePrestige.present()) {
-    prestige = s16(*maybePrestige);
-  }
-
-  auto maybeOxyTier = root->expectNumberField("oxyTier"_sv);
-  if(maybeOxyTier.present()) {
-    oxyTier = s16(*maybeOxyTier);
+  if(!reader.finish()) {
+    log.error(String<>::formatted("Could not load save file: {}", reader.error()));
+    return true;
   }
-
+  *this = read;
+  loaded = true;
   return true;
 }
 
 bool SavefileV2::save(data::RW &file) const {
+  return file.write(encode().view());
+}
+
+String<> SavefileV2::encode() const {
   json::ObjectBuilder root;
   root.set("score"_sv, f64(score));
   root.set("lubeTier"_sv, f64(lubeTier));
   root.set("gravityTier"_sv, f64(gravityTier));
   root.set("prestige"_sv, f64(prestige));
   root.set("oxyTier"_sv, f64(oxyTier));
-  return file.write(json::encode(root.finish()).view());
+  auto encoded = json::encode(root.finish());
+  return String<>{encoded.view()};
 }
 
-bool Savefile::save(data::RW &file) {
+SavefileV3 SavefileV2::migrate() const {
+  SavefileV3 out;
+  out.loaded = true;
+  out.score = score;
+  out.lubeTier = lubeTier;
+  out.gravityTier = gravityTier;
+  out.prestige = prestige;
+  out.oxyTier = oxyTier;
+  out.journalSeq = journalSeq;
+  return out;
+}
+
+// records are written as they are laid out in memory
+static_assert(std::endian::native == std::endian::little,
+  "save files are little-endian, byte-swap them on this target");
+static_assert(offsetof(SavefileV3::Record, crc) + sizeof(u32) == sizeof(SavefileV3::Record));
+
+static u32 recordCrc(const SavefileV3::Record &record) {
+  return blob::crc32(&record, offsetof(SavefileV3::Record, crc));
+}
+
+bool SavefileV3::load(data::RW &file) {
+  LoadScope scope;
+  LoadVector<char> raw;
+  if(!readAll(file, raw)) {
+    console::error("Could not load save file: {}", SDL_GetError());
+    return false;
+  }
+  if(!read({raw.data(), raw.size()})) {
+    console::error("Could not load save file: Not a V3 save or damaged.");
+    return false;
+  }
+  return true;
+}
+
+bool SavefileV3::read(StringView raw) {
+  Record record{};
+  if(raw.size() < sizeof(Record)) {
+    return false;
+  }
+  std::memcpy(&record, raw.data(), sizeof(Record));
+  if(std::memcmp(record.magic, cMagic, sizeof(cMagic)) != 0
+  || record.version != cVersion
+  || record.size < sizeof(Record) || record.size > raw.size()) {
+    return false;
+  }
+  // the CRC is last, after any fields this build does not know about
+  usize checked = record.size - sizeof(u32);
+  u32 crc;
+  std::memcpy(&crc, raw.data() + checked, sizeof(crc));
+  if(crc != blob::crc32(raw.data(), checked)) {
+    return false;
+  }
+  loaded = true;
+  score = record.score;
+  lubeTier = record.lubeTier;
+  gravityTier = record.gravityTier;
+  prestige = record.prestige;
+  oxyTier = record.oxyTier;
+  journalSeq = record.journalSeq;
+  return true;
+}
+
+bool SavefileV3::read(const Record &record) {
+  return read({reinterpret_cast<const char*>(&record), sizeof(record)});
+}
+
+bool SavefileV3::save(data::RW &file) const {
+  Record record{};
+  write(record);
+  return file.write({reinterpret_cast<const char*>(&record), sizeof(record)});
+}
+
+void SavefileV3::write(Record &out) const {
+  out = {};
+  std::memcpy(out.magic, cMagic, sizeof(cMagic));
+  out.version = cVersion;
+  out.size = sizeof(Record);
+  out.score = score;
+  out.lubeTier = lubeTier;
+  out.gravityTier = gravityTier;
+  out.prestige = prestige;
+  out.oxyTier = oxyTier;
+  out.journalSeq = journalSeq;
+  out.crc = recordCrc(out);
+}
+
+void Savefile::migrate() {
   dirty = false;
+  if(v3.loaded) {
+    return;
+  }
   if(v1.loaded) {
-    v2.score = v1.score;
-    v2.lubeTier = v1.lubeTier;
-    v2.gravityTier = v1.gravityTier;
-    v2.prestige = v1.prestige;
-    v2.oxyTier = v1.oxyTier;
-    v1.loaded = false;
-  }
-  return v2.save(file);
+    v2 = v1.migrate();
+  }
+  if(v2.loaded) {
+    v3 = v2.migrate();
+  }
+}
+
+bool Savefile::save(data::RW &file) {
+  migrate();
+  return v3.save(file);
+}
+
+void benchmarkSave(usize iterations) {
+  iterations = std::max<usize>(iterations, 1);
+
+  SavefileV3 save;
+  save.score = 123456;
+  save.lubeTier = 7;
+  save.gravityTier = 5;
+  save.prestige = 2;
+  save.oxyTier = 3;
+  SavefileV2 json = {
+    .loaded = true,
+    .score = save.score,
+    .lubeTier = save.lubeTier,
+    .gravityTier = save.gravityTier,
+    .prestige = save.prestige,
+    .oxyTier = save.oxyTier,
+  };
+  auto encoded = json.encode();
+  SavefileV3::Record record{};
+  save.write(record);
+
+  BenchResult v2Load, v2Save, v3Load, v3Save;
+  bool ok = bench(iterations, v2Load, [&encoded]{
+    SavefileV2 out;
+    ParseLog log;
+    return out.parse(encoded.view(), log) && out.loaded;
+  });
+  ok = ok && bench(iterations, v2Save, [&json]{
+    return json.encode().size() != 0;
+  });
+  ok = ok && bench(iterations, v3Load, [&record]{
+    SavefileV3 out;
+    return out.read(record);
+  });
+  ok = ok && bench(iterations, v3Save, [&save]{
+    SavefileV3::Record out;
+    save.write(out);
+    return out.crc != 0;
+  });
+  if(!ok) {
+    console::error("a save did not round-trip, not benchmarking");
+    return;
+  }
+
+  console::print("save, V2 {} bytes, V3 {} bytes, {} iterations:",
+    encoded.size(), sizeof(SavefileV3::Record), iterations);
+  printBench("V2 JSON load", v2Load);
+  printBench("V2 JSON save", v2Save);
+  printBench("V3 binary load", v3Load);
+  printBench("V3 binary save", v3Save);
+  if(!AllocationCounter::cSupported) {
+    console::print("  (allocations are only counted in debug builds)");
+  }
+}
+
+static bool sameProgress(const SavefileV3 &lhs, const SavefileV3 &rhs) {
+  return lhs.score == rhs.score && lhs.lubeTier == rhs.lubeTier
+    && lhs.gravityTier == rhs.gravityTier && lhs.prestige == rhs.prestige
+    && lhs.oxyTier == rhs.oxyTier && lhs.journalSeq == rhs.journalSeq;
+}
+
+bool checkSave() {
+  Checks checks{"saves V1, V2, V3"};
+  SavefileV3 expected;
+  expected.score = 123456;
+  expected.lubeTier = 7;
+  expected.gravityTier = 5;
+  expected.prestige = 2;
+  expected.oxyTier = 3;
+
+  // V1 is the fields one after another, oxyTier was added last
+  std::string v1Bytes;
+  auto append = [&v1Bytes](const auto &value) {
+    v1Bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  };
+  append(expected.score);
+  append(expected.lubeTier);
+  append(expected.gravityTier);
+  append(expected.prestige);
+  append(expected.oxyTier);
+  Savefile save;
+  {
+    data::RW file{SDL_RWFromConstMem(v1Bytes.data(), int(v1Bytes.size()))};
+    checks.expect(save.v1.load(file), "loads a V1 save");
+  }
+  save.dirty = true;
+  save.migrate();
+  checks.expect(save.v3.loaded && sameProgress(save.v3, expected) && !save.dirty,
+    "migrates V1 to V2 to V3");
+  SavefileV1 beforeOxy;
+  {
+    data::RW file{SDL_RWFromConstMem(v1Bytes.data(), int(v1Bytes.size() - sizeof(s16)))};
+    checks.expect(beforeOxy.load(file) && beforeOxy.oxyTier == 0 && beforeOxy.prestige == 2,
+      "loads a V1 save from before oxyTier");
+  }
+
+  auto encoded = save.v2.encode();
+  SavefileV2 parsed;
+  ParseLog log;
+  checks.expect(parsed.parse(encoded.view(), log) && parsed.loaded && !log.failed(),
+    "parses an encoded V2 save");
+  checks.expect(sameProgress(parsed.migrate(), expected), "round-trips V2");
+  std::string_view partial = R"({"score": 5, "lubeTier": "x", "prestige": 1})";
+  SavefileV2 kept;
+  kept.parse({partial.data(), partial.size()}, log);
+  checks.expect(kept.loaded && kept.score == 5 && kept.lubeTier == 0 && kept.prestige == 1,
+    "keeps the readable fields of a damaged V2 save");
+  std::string_view torn = R"({"score": 5, "prestige": )";
+  SavefileV2 dropped;
+  dropped.parse({torn.data(), torn.size()}, log);
+  checks.expect(!dropped.loaded && dropped.score == 0, "drops a V2 save that is cut short");
+  // the errors about lubeTier and the cut are expected, so they are not reported
+  log = ParseLog{};
+
+  expected.journalSeq = 77;
+  SavefileV3::Record record{};
+  expected.write(record);
+  SavefileV3 read;
+  checks.expect(read.read(record) && read.loaded && sameProgress(read, expected),
+    "round-trips V3");
+
+  std::string bytes(reinterpret_cast<const char*>(&record), sizeof(record));
+  bool allCaught = true;
+  for(usize i = 0; i < bytes.size(); ++i) {
+    std::string damaged = bytes;
+    damaged[i] = char(damaged[i] ^ 0x20);
+    SavefileV3 out;
+    allCaught = allCaught && !out.read({damaged.data(), damaged.size()}) && !out.loaded;
+  }
+  checks.expect(allCaught, "rejects every damaged V3 byte");
+  SavefileV3 untouched;
+  untouched.score = 9;
+  checks.expect(!untouched.read({bytes.data(), bytes.size() - 1}) && untouched.score == 9,
+    "leaves the save alone on a truncated V3 file");
+
+  // a later build appending a field before the CRC
+  std::string longer = bytes.substr(0, offsetof(SavefileV3::Record, crc));
+  longer.append("\x01\x02\x03\x04", 4);
+  auto size = u16(longer.size() + sizeof(u32));
+  std::memcpy(longer.data() + offsetof(SavefileV3::Record, size), &size, sizeof(size));
+  u32 crc = blob::crc32(longer.data(), longer.size());
+  longer.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+  SavefileV3 newer;
+  checks.expect(newer.read({longer.data(), longer.size()}) && sameProgress(newer, expected),
+    "reads a V3 save with fields from a later build");
+  return checks.finish();
 }
 
 } // namespace sbs
@@ -7,10 +7,15 @@ Savefile definitions
 */
 
 #include <nwge/common/def.h>
+#include <nwge/common/string.hpp>
 #include <nwge/data/rw.hpp>
 
 namespace sbs {
 
+class ParseLog;
+struct SavefileV2;
+struct SavefileV3;
+
 /* old save file format from before 1.4 */
 struct SavefileV1 {
   bool loaded = false;
@@ -21,26 +26,88 @@ struct SavefileV1 {
   s16 oxyTier = 0;
 
   bool load(nwge::data::RW &file);
+  [[nodiscard]] SavefileV2 migrate() const;
 };
 
-/* new save file format from 1.4 onwards */
+/* JSON save file format from 1.4 onwards */
 struct SavefileV2 {
+  bool loaded = false;
   s32 score = 0;
   s16 lubeTier = 0;
   s16 gravityTier = 0;
   s16 prestige = 0;
   s16 oxyTier = 0;
+  /* last journal record folded into this save (see journal.hpp), only
+     written while save.json was the journal's snapshot */
+  u32 journalSeq = 0;
 
   bool load(nwge::data::RW &file);
+  /* Safe off the main thread, what went wrong is left in `log`. */
+  bool parse(nwge::StringView raw, ParseLog &log);
   bool save(nwge::data::RW &file) const;
+  nwge::String<> encode() const;
+  [[nodiscard]] SavefileV3 migrate() const;
+};
+
+/* binary save file format from 1.6 onwards */
+struct SavefileV3 {
+  static constexpr char cMagic[4] = {'S', 'B', 'S', 'S'};
+  static constexpr u16 cVersion = 3;
+
+  /* the whole file, little-endian (save.cpp only builds for little-endian
+     targets) */
+  struct Record {
+    char magic[4];
+    u16 version;
+    u16 size;    // of the whole file. Fields added later go before `crc`,
+                 // which always comes last, and older builds skip them.
+    s32 score;
+    s16 lubeTier;
+    s16 gravityTier;
+    s16 prestige;
+    s16 oxyTier;
+    u32 journalSeq;
+    u32 crc;     // CRC32 of everything above
+  };
+  static_assert(sizeof(Record) == 28);
+
+  bool loaded = false;
+  s32 score = 0;
+  s16 lubeTier = 0;
+  s16 gravityTier = 0;
+  s16 prestige = 0;
+  s16 oxyTier = 0;
+  /* last journal record folded into this save (see journal.hpp) */
+  u32 journalSeq = 0;
+
+  /* Leaves the save as it was and returns false if the file is damaged. */
+  bool load(nwge::data::RW &file);
+  /* Like load(), but from a file in memory, without printing anything. Also
+     reads files from later builds that appended fields. */
+  bool read(nwge::StringView raw);
+  bool read(const Record &record);
+  bool save(nwge::data::RW &file) const;
+  void write(Record &out) const;
 };
 
 struct Savefile {
   bool dirty = false;
   SavefileV1 v1;
   SavefileV2 v2;
+  SavefileV3 v3;
 
+  /* Brings the oldest save that was loaded up to V3 one version at a time,
+     unless a V3 save was loaded, and clears the dirty flag like saving does.
+     v1.loaded is left set so the old file can be deleted afterwards. */
+  void migrate();
   bool save(nwge::data::RW &file);
 };
 
+/* Times loading and saving V2 against V3. */
+void benchmarkSave(usize iterations);
+
+/* Round-trips every save format, migrates V1 to V2 to V3, and checks that
+   damaged V3 saves are rejected. For the sbs.check console command. */
+bool checkSave();
+
 } // namespace sbs
@@ -0,0 +1,1351 @@
+#include "saves.hpp"
+#include "blob.hpp"
+#include "check.hpp"
+#include "data.hpp"
+#include "journal.hpp"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <SDL2/SDL_filesystem.h>
+#include <nwge/console.hpp>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace nwge;
+
+namespace sbs::saves {
+
+static constexpr const char
+  *cOrgName = "nwge-games",
+  *cAppName = "sbs2024",
+  *cFileName = "save",
+  *cSaveExt = ".bin",
+  *cJournalExt = ".journal",
+  /* the snapshot from before V3, migrated when there is no save.bin yet */
+  *cLegacyName = "save.json",
+  *cSnapshotName = "suspend",
+  *cIndexName = "slots.bin";
+
+static constexpr char cSnapshotMagic[4] = {'S', 'B', 'S', 'R'};
+static constexpr u16 cSnapshotVersion = 2;
+static constexpr char cIndexMagic[4] = {'S', 'B', 'S', 'I'};
+static constexpr u16 cIndexVersion = 1;
+
+/* the journal is folded into save.bin once it grows past this */
+static constexpr usize cCompactSize = usize(16) * 1024;
+/* how long to wait before appending again after an append failed */
+static constexpr auto cRetryDelay = std::chrono::seconds(1);
+
+/* how openFile() opens a file */
+enum class Open {
+  Read,
+  Replace, // created or emptied, for writing
+  Journal, // created if missing, for reading and appending
+};
+
+/* The file operations saving needs, over file descriptors. The C runtime on
+   Windows has them too, under other names, so they are wrapped here. On
+   failure errno says why. */
+
+#ifdef _WIN32
+
+static int openFile(const std::string &path, Open mode) {
+  int flags = _O_BINARY | _O_NOINHERIT;
+  switch(mode) {
+  case Open::Read:
+    flags |= _O_RDONLY;
+    break;
+  case Open::Replace:
+    flags |= _O_WRONLY | _O_CREAT | _O_TRUNC;
+    break;
+  case Open::Journal:
+    flags |= _O_RDWR | _O_CREAT | _O_APPEND;
+    break;
+  }
+  return ::_open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+}
+
+static s64 readSome(int fd, void *data, usize size) {
+  return ::_read(fd, data, unsigned(std::min<usize>(size, 1 << 30)));
+}
+
+static s64 writeSome(int fd, const void *data, usize size) {
+  return ::_write(fd, data, unsigned(std::min<usize>(size, 1 << 30)));
+}
+
+static bool closeFile(int fd) {
+  return ::_close(fd) == 0;
+}
+
+static bool syncFile(int fd) {
+  return ::_commit(fd) == 0;
+}
+
+static bool syncData(int fd) {
+  return syncFile(fd);
+}
+
+static bool truncateFile(int fd, usize size) {
+  errno_t error = ::_chsize_s(fd, __int64(size));
+  if(error != 0) {
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+static bool removeFile(const std::string &path) {
+  return ::_unlink(path.c_str()) == 0;
+}
+
+/* Renames `from` over `to`. The rename is written through, so there is no
+   directory to sync afterwards. */
+static bool renameFile(const std::string &from, const std::string &to) {
+  if(MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    return true;
+  }
+  switch(GetLastError()) {
+  case ERROR_FILE_NOT_FOUND:
+  case ERROR_PATH_NOT_FOUND:
+    errno = ENOENT;
+    break;
+  case ERROR_ACCESS_DENIED:
+  case ERROR_SHARING_VIOLATION:
+    errno = EACCES;
+    break;
+  default:
+    errno = EIO;
+    break;
+  }
+  return false;
+}
+
+static bool syncDir(const std::string &) {
+  return true;
+}
+
+#else
+
+static int openFile(const std::string &path, Open mode) {
+  int flags = O_CLOEXEC;
+  switch(mode) {
+  case Open::Read:
+    flags |= O_RDONLY;
+    break;
+  case Open::Replace:
+    flags |= O_WRONLY | O_CREAT | O_TRUNC;
+    break;
+  case Open::Journal:
+    flags |= O_RDWR | O_CREAT | O_APPEND;
+    break;
+  }
+  return ::open(path.c_str(), flags, 0644);
+}
+
+static s64 readSome(int fd, void *data, usize size) {
+  return ::read(fd, data, size);
+}
+
+static s64 writeSome(int fd, const void *data, usize size) {
+  return ::write(fd, data, size);
+}
+
+static bool closeFile(int fd) {
+  return ::close(fd) == 0;
+}
+
+static bool syncFile(int fd) {
+  return fsync(fd) == 0;
+}
+
+/* Syncs the contents of `fd`. Where the system can, its metadata is left to
+   be synced later. */
+static bool syncData(int fd) {
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+  return fdatasync(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+static bool truncateFile(int fd, usize size) {
+  return ftruncate(fd, off_t(size)) == 0;
+}
+
+static bool removeFile(const std::string &path) {
+  return ::unlink(path.c_str()) == 0;
+}
+
+static bool renameFile(const std::string &from, const std::string &to) {
+  return ::rename(from.c_str(), to.c_str()) == 0;
+}
+
+/* Makes the last rename in the directory of `path` durable. */
+static bool syncDir(const std::string &path) {
+  std::string dir = path.substr(0, path.find_last_of('/') + 1);
+  int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if(fd < 0) {
+    return false;
+  }
+  bool synced = fsync(fd) == 0;
+  int error = errno;
+  ::close(fd);
+  errno = error;
+  return synced;
+}
+
+#endif
+
+static bool readFile(int fd, std::string &out) {
+  char buf[4096];
+  for(;;) {
+    s64 count = readSome(fd, buf, sizeof(buf));
+    if(count < 0 && errno == EINTR) {
+      continue;
+    }
+    if(count < 0) {
+      return false;
+    }
+    if(count == 0) {
+      return true;
+    }
+    out.append(buf, usize(count));
+  }
+}
+
+static bool writeFile(int fd, const char *data, usize size) {
+  while(size > 0) {
+    s64 count = writeSome(fd, data, size);
+    if(count < 0 && errno == EINTR) {
+      continue;
+    }
+    if(count < 0) {
+      return false;
+    }
+    data += count;
+    size -= usize(count);
+  }
+  return true;
+}
+
+/* Writes `data` next to `path` and renames it over, so a crash mid-write
+   leaves the previous file intact. */
+static bool replaceFile(const std::string &path, StringView data) {
+  std::string temp = path + ".tmp";
+  int fd = openFile(temp, Open::Replace);
+  if(fd < 0) {
+    return false;
+  }
+  bool written = writeFile(fd, data.begin(), data.size()) && syncFile(fd);
+  int error = errno;
+  if(!closeFile(fd) || !written) {
+    if(!written) {
+      errno = error;
+    }
+    return false;
+  }
+  return renameFile(temp, path) && syncDir(path);
+}
+
+/* Reads exactly one `T` from the start of `path`, with a single read. */
+template<typename T>
+static bool readRecord(const std::string &path, T &out) {
+  int fd = openFile(path, Open::Read);
+  if(fd < 0) {
+    return false;
+  }
+  s64 count = readSome(fd, &out, sizeof(T));
+  closeFile(fd);
+  return count == s64(sizeof(T));
+}
+
+/* Reads a save.bin with a single read, into a buffer with room for the
+   fields later builds may append. */
+static bool readSave(int fd, SavefileV3 &out) {
+  std::array<char, 256> raw;
+  static_assert(sizeof(raw) >= sizeof(SavefileV3::Record));
+  s64 count = readSome(fd, raw.data(), raw.size());
+  return count > 0 && out.read({raw.data(), usize(count)});
+}
+
+template<typename T>
+static bool writeRecord(const std::string &path, const T &record) {
+  return replaceFile(path, {reinterpret_cast<const char*>(&record), sizeof(T)});
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using journal::Record;
+
+/* Something the writer thread ran into, printed on the main thread by
+   report(). */
+struct Message {
+  std::string text;
+  bool error = false;
+  int code = 0; // errno, if there is one
+};
+
+/* all of suspend.bin */
+struct SnapshotRecord {
+  char magic[4];
+  u16 version;
+  u16 size;
+  Snapshot snapshot;
+  u32 crc; // CRC32 of everything above
+};
+static_assert(sizeof(SnapshotRecord) == 68);
+
+/* all of slots.bin */
+struct IndexRecord {
+  char magic[4];
+  u16 version;
+  u8 current;
+  u8 count;
+  SlotInfo slots[cSlotCount];
+  u32 reserved;
+  u32 crc; // CRC32 of everything above
+};
+static_assert(sizeof(IndexRecord) == 64);
+
+template<typename T>
+u32 recordCrc(const T &record) {
+  return blob::crc32(&record, offsetof(T, crc));
+}
+
+struct Slot {
+  std::string path;
+  /* a copy of save.bin, written before it */
+  std::string backupPath;
+  std::string journalPath;
+  std::string snapshotPath;
+  /* only the first slot has one */
+  std::string legacyPath;
+
+  /* whether the writer thread should replay it */
+  bool wanted = false;
+  bool replayed = false;
+  bool haveSave = false;
+  /* the save as the game sees it, including records not written yet */
+  SavefileV3 latest;
+  u32 seq = 0;
+  std::vector<Record> queue;
+  /* the last append failed, the queue is retried at retryAt */
+  bool appendFailed = false;
+  Clock::time_point retryAt;
+  bool unsynced = false;
+  Clock::time_point syncDeadline;
+
+  /* whether the writer thread should read suspend.bin */
+  bool snapshotWanted = false;
+  bool snapshotRead = false;
+  bool haveSnapshot = false;
+  Snapshot snapshot{};
+  bool snapshotPending = false;
+  bool snapshotDiscarded = false;
+
+  // only touched by the writer thread
+  int journal = -1;
+  usize journalSize = 0;
+  /* the save as of the last record written to the journal */
+  SavefileV3 written;
+  /* whether save.json was migrated and can go once save.bin is written */
+  bool legacy = false;
+  /* save.bin could not be read and is still there, so it is never replaced */
+  bool keepSave = false;
+};
+
+} // namespace
+
+const std::string &userDir() {
+  static const std::string sDir = []{
+    std::string path;
+    char *dir = SDL_GetPrefPath(cOrgName, cAppName);
+    if(dir != nullptr) {
+      path = dir;
+      SDL_free(dir);
+    }
+    return path;
+  }();
+  return sDir;
+}
+
+namespace {
+
+class Writer {
+public:
+  /* `dir` ends with a separator, or is empty for the working directory. */
+  explicit Writer(std::string dir)
+    : mDir(std::move(dir))
+  {
+    for(usize i = 0; i < cSlotCount; ++i) {
+      auto &slot = mSlots[i];
+      // the first slot keeps the names from before there were slots
+      std::string number = i == 0 ? std::string{} : std::to_string(i + 1);
+      slot.path = mDir + cFileName + number + cSaveExt;
+      slot.backupPath = slot.path + ".bak";
+      slot.journalPath = mDir + cFileName + number + cJournalExt;
+      slot.snapshotPath = mDir + cSnapshotName + number + cSaveExt;
+      if(i == 0) {
+        slot.legacyPath = mDir + cLegacyName;
+      }
+    }
+    mIndexPath = mDir + cIndexName;
+    mThread = std::thread([this]{
+      work();
+    });
+  }
+
+  Writer(const Writer&) = delete;
+  Writer(Writer&&) = delete;
+  Writer &operator=(const Writer&) = delete;
+  Writer &operator=(Writer&&) = delete;
+
+  ~Writer() {
+    // nothing is printed this late, shutdown() should have been called
+    stop();
+  }
+
+  void shutdown() {
+    stop();
+    report();
+    if(mRequests != 0) {
+      console::note("Journaled {} records for {} save requests in {} writes, {} syncs and {} compactions.",
+        mRecords, mRequests, mAppends, mSyncs, mCompactions);
+    }
+  }
+
+  void report() {
+    std::vector<Message> messages;
+    ParseLog legacyLog;
+    {
+      std::lock_guard lock{mMessageMutex};
+      messages.swap(mMessages);
+      legacyLog = std::move(mLegacyLog);
+      mLegacyLog = ParseLog{};
+    }
+    legacyLog.report();
+    for(const auto &message: messages) {
+      if(message.code != 0) {
+        console::error("{}: {}", message.text, std::strerror(message.code));
+      } else if(message.error) {
+        console::error("{}", message.text);
+      } else {
+        console::note("{}", message.text);
+      }
+    }
+  }
+
+  SlotIndex slots() {
+    std::unique_lock lock{mMutex};
+    waitIndex(lock);
+    if(mIndexMissing) {
+      waitReplayed(lock, mSlots[0]);
+    }
+    return mIndex;
+  }
+
+  usize currentSlot() {
+    std::unique_lock lock{mMutex};
+    waitIndex(lock);
+    return mCurrent;
+  }
+
+  void selectSlot(usize slot) {
+    {
+      std::unique_lock lock{mMutex};
+      waitIndex(lock);
+      if(slot >= cSlotCount || slot == mCurrent) {
+        return;
+      }
+      mCurrent = slot;
+      mSlots[slot].wanted = true;
+      mSlots[slot].snapshotWanted = true;
+      markIndexDirty();
+    }
+    mWake.notify_one();
+  }
+
+  bool migrationPending() {
+    std::unique_lock lock{mMutex};
+    waitIndex(lock);
+    if(!mIndexMissing) {
+      return false;
+    }
+    auto &slot = mSlots[0];
+    waitReplayed(lock, slot);
+    return !slot.haveSave;
+  }
+
+  bool load(SavefileV3 &out) {
+    std::unique_lock lock{mMutex};
+    auto &slot = current(lock);
+    waitReplayed(lock, slot);
+    if(slot.haveSave) {
+      out = slot.latest;
+      out.loaded = true;
+    }
+    return slot.haveSave;
+  }
+
+  void nq(const SavefileV3 &save) {
+    {
+      std::unique_lock lock{mMutex};
+      auto &slot = current(lock);
+      waitReplayed(lock, slot);
+      ++mRequests;
+      std::array<Record, journal::cMaxRecords> records{};
+      usize count = journal::diff(slot.latest, save, slot.seq, records.data());
+      slot.latest = save;
+      slot.haveSave = true;
+      if(count == 0) {
+        return;
+      }
+      slot.queue.insert(slot.queue.end(), records.begin(), records.begin() + count);
+      mIndex[mCurrent] = info(save);
+      markIndexDirty();
+    }
+    mWake.notify_one();
+  }
+
+  void flush() {
+    {
+      std::lock_guard lock{mMutex};
+      mFlushing = true;
+    }
+    mWake.notify_one();
+  }
+
+  void suspend(const Snapshot &snapshot) {
+    {
+      std::unique_lock lock{mMutex};
+      auto &slot = current(lock);
+      slot.snapshot = snapshot;
+      slot.snapshotRead = true;
+      slot.haveSnapshot = true;
+      slot.snapshotPending = true;
+      slot.snapshotDiscarded = false;
+    }
+    mWake.notify_one();
+  }
+
+  bool resume(Snapshot &out, const SavefileV3 &save) {
+    std::unique_lock lock{mMutex};
+    auto &slot = current(lock);
+    if(!slot.snapshotRead) {
+      // usually read ahead already, see work()
+      slot.snapshotWanted = true;
+      mWake.notify_one();
+      mLoaded.wait(lock, [&slot]{
+        return slot.snapshotRead;
+      });
+    }
+    if(!slot.haveSnapshot) {
+      return false;
+    }
+    if(slot.snapshot.score != save.score
+    || slot.snapshot.tiers.lube != save.lubeTier
+    || slot.snapshot.tiers.gravity != save.gravityTier
+    || slot.snapshot.tiers.oxy != save.oxyTier) {
+      console::note("The suspended game is older than the save, not resuming it.");
+      return false;
+    }
+    out = slot.snapshot;
+    return true;
+  }
+
+  void discardSnapshot() {
+    {
+      std::unique_lock lock{mMutex};
+      auto &slot = current(lock);
+      slot.snapshotRead = true;
+      slot.haveSnapshot = false;
+      slot.snapshotPending = false;
+      slot.snapshotDiscarded = true;
+    }
+    mWake.notify_one();
+  }
+
+  void setWindow(f32 seconds) {
+    std::lock_guard lock{mMutex};
+    mWindow = seconds;
+  }
+
+  f32 window() {
+    std::lock_guard lock{mMutex};
+    return mWindow;
+  }
+
+private:
+  std::string mDir;
+  std::string mIndexPath;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mReplayed;
+  /* slots.bin or a suspend.bin has been read */
+  std::condition_variable mLoaded;
+  std::array<Slot, cSlotCount> mSlots;
+  bool mIndexRead = false;
+  /* there was no slots.bin, the first slot's entry is filled in once it is
+     replayed */
+  bool mIndexMissing = false;
+  usize mCurrent = 0;
+  SlotIndex mIndex{};
+  bool mIndexDirty = false;
+  Clock::time_point mIndexDeadline;
+  bool mFlushing = false;
+  bool mStop = false;
+  f32 mWindow = cDefaultWindow;
+  usize mRequests = 0;
+
+  // only touched by the writer thread
+  usize mRecords = 0;
+  usize mAppends = 0;
+  usize mSyncs = 0;
+  usize mCompactions = 0;
+
+  std::thread mThread;
+
+  std::mutex mMessageMutex;
+  std::vector<Message> mMessages;
+  /* what parsing the store's save.json had to say */
+  ParseLog mLegacyLog;
+
+  /* Writes everything that is queued and stops the writer thread. */
+  void stop() {
+    if(!mThread.joinable()) {
+      return;
+    }
+    {
+      std::lock_guard lock{mMutex};
+      mStop = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+    for(auto &slot: mSlots) {
+      if(slot.journal >= 0) {
+        closeFile(slot.journal);
+        slot.journal = -1;
+      }
+    }
+  }
+
+  /* Queues `text` and errno for report(). */
+  void fail(std::string text) {
+    int code = errno;
+    std::lock_guard lock{mMessageMutex};
+    mMessages.push_back({std::move(text), true, code});
+  }
+
+  void error(std::string text) {
+    std::lock_guard lock{mMessageMutex};
+    mMessages.push_back({std::move(text), true, 0});
+  }
+
+  void note(std::string text) {
+    std::lock_guard lock{mMessageMutex};
+    mMessages.push_back({std::move(text), false, 0});
+  }
+
+  [[nodiscard]] Clock::time_point windowEnd() const {
+    return Clock::now() + std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<f32>(mWindow));
+  }
+
+  static SlotInfo info(const SavefileV3 &save) {
+    return {
+      .lastPlayed = s64(std::time(nullptr)),
+      .score = save.score,
+      .prestige = save.prestige,
+      .used = 1,
+      .reserved = 0,
+    };
+  }
+
+  void markIndexDirty() {
+    if(!mIndexDirty) {
+      mIndexDirty = true;
+      mIndexDeadline = windowEnd();
+    }
+  }
+
+  Slot &current(std::unique_lock<std::mutex> &lock) {
+    waitIndex(lock);
+    return mSlots[mCurrent];
+  }
+
+  /* Waits for the writer thread to read slots.bin, the first thing it does. */
+  void waitIndex(std::unique_lock<std::mutex> &lock) {
+    mLoaded.wait(lock, [this]{
+      return mIndexRead;
+    });
+  }
+
+  /* Reads slots.bin, with the lock released around the read. Runs on the
+     writer thread, once. */
+  void readIndex(std::unique_lock<std::mutex> &lock) {
+    IndexRecord record{};
+    lock.unlock();
+    bool read = readRecord(mIndexPath, record)
+      && std::memcmp(record.magic, cIndexMagic, sizeof(cIndexMagic)) == 0
+      && record.version == cIndexVersion && record.count == cSlotCount
+      && record.crc == recordCrc(record);
+    lock.lock();
+    if(read) {
+      std::copy(std::begin(record.slots), std::end(record.slots), mIndex.begin());
+      mCurrent = record.current < cSlotCount ? record.current : 0;
+    } else {
+      // from before there were slots, only the first one can have been
+      // played, so it is replayed to fill in the index
+      mIndexMissing = true;
+      mSlots[0].wanted = true;
+    }
+    // the current slot is read ahead of the first load() and resume()
+    mSlots[mCurrent].wanted = true;
+    mSlots[mCurrent].snapshotWanted = true;
+    mIndexRead = true;
+    mLoaded.notify_all();
+  }
+
+  /* Has the writer thread replay `slot` if it has not yet, and waits for it. */
+  void waitReplayed(std::unique_lock<std::mutex> &lock, Slot &slot) {
+    if(!slot.replayed) {
+      slot.wanted = true;
+      mWake.notify_one();
+      mReplayed.wait(lock, [&slot]{
+        return slot.replayed;
+      });
+    }
+  }
+
+  /* Reads save.bin, or the best copy of it that is left when it is missing
+     or damaged, and applies the journal records it does not have yet.
+     Runs on the writer thread, once per slot. */
+  void replay(Slot &slot) {
+    SavefileV3 save;
+    int fd = openFile(slot.path, Open::Read);
+    if(fd >= 0) {
+      bool read = readSave(fd, save);
+      closeFile(fd);
+      if(read) {
+        slot.haveSave = true;
+      } else {
+        setAside(slot);
+      }
+    } else if(errno != ENOENT) {
+      fail("Could not open " + slot.path);
+      slot.keepSave = true;
+    }
+    if(!slot.haveSave) {
+      readBackup(slot, save);
+    }
+    if(!slot.haveSave && !slot.legacyPath.empty()) {
+      readLegacy(slot, save);
+    }
+
+    slot.journal = openFile(slot.journalPath, Open::Journal);
+    if(slot.journal < 0) {
+      fail("Could not open " + slot.journalPath);
+    } else {
+      u32 seq = save.journalSeq;
+      /* records are numbered without gaps, so one means the records between
+         the save and the journal are lost, and with them what the score
+         records add to */
+      bool gap = false;
+      auto take = [&](const Record &entry){
+        // left over from a compaction interrupted before the truncate
+        if(entry.seq <= save.journalSeq) {
+          return;
+        }
+        if(entry.seq != seq + 1 && !gap) {
+          gap = true;
+          error("Records " + std::to_string(seq + 1) + " to " + std::to_string(entry.seq - 1)
+            + " are missing from " + slot.journalPath + ", the score since could not be recovered.");
+        }
+        if(!gap || entry.kind != Record::Score) {
+          journal::apply(save, entry);
+        }
+        seq = entry.seq;
+        slot.haveSave = true;
+      };
+
+      // read a chunk of records at a time, into a buffer on the stack
+      std::array<Record, 256> chunk;
+      auto *bytes = reinterpret_cast<char*>(chunk.data());
+      usize filled = 0;
+      usize fileSize = 0;
+      usize size = 0;
+      bool torn = false;
+      for(;;) {
+        s64 count = readSome(slot.journal, bytes + filled, sizeof(chunk) - filled);
+        if(count < 0 && errno == EINTR) {
+          continue;
+        }
+        if(count <= 0) {
+          break;
+        }
+        filled += usize(count);
+        fileSize += usize(count);
+        usize whole = filled / sizeof(Record);
+        for(usize i = 0; i < whole && !torn; ++i) {
+          if(!journal::valid(chunk[i])) {
+            torn = true;
+            break;
+          }
+          take(chunk[i]);
+          size += sizeof(Record);
+        }
+        // a record split across reads
+        filled -= whole * sizeof(Record);
+        std::memmove(bytes, bytes + whole * sizeof(Record), filled);
+      }
+      if(size != fileSize) {
+        note("Dropping " + std::to_string(fileSize - size) + " bytes torn off the end of "
+          + slot.journalPath + ".");
+        if(!truncateFile(slot.journal, size)) {
+          fail("Could not truncate " + slot.journalPath);
+        }
+      }
+      save.journalSeq = seq;
+      slot.journalSize = size;
+    }
+
+    slot.seq = save.journalSeq;
+    slot.latest = save;
+    slot.written = save;
+  }
+
+  /* Moves a damaged save.bin out of the way, so compacting does not write over
+     what might still be recovered from it. */
+  void setAside(Slot &slot) {
+    std::string bad = slot.path + ".bad";
+    if(!renameFile(slot.path, bad)) {
+      fail(slot.path + " is damaged and could not be moved to " + bad);
+      slot.keepSave = true;
+      return;
+    }
+    error(slot.path + " is damaged, moved it to " + bad + ".");
+  }
+
+  /* Reads the copy of save.bin, for when save.bin is missing or damaged. */
+  void readBackup(Slot &slot, SavefileV3 &out) {
+    int fd = openFile(slot.backupPath, Open::Read);
+    if(fd < 0) {
+      return;
+    }
+    SavefileV3 backup;
+    bool read = readSave(fd, backup);
+    closeFile(fd);
+    if(!read) {
+      error(slot.backupPath + " is damaged too.");
+      return;
+    }
+    out = backup;
+    slot.haveSave = true;
+    note("Restored " + slot.path + " from " + slot.backupPath + ".");
+  }
+
+  void readLegacy(Slot &slot, SavefileV3 &out) {
+    int fd = openFile(slot.legacyPath, Open::Read);
+    if(fd < 0) {
+      return;
+    }
+    std::string raw;
+    SavefileV2 legacy;
+    ParseLog log;
+    if(readFile(fd, raw) && legacy.parse({raw.data(), raw.size()}, log) && legacy.loaded) {
+      out = legacy.migrate();
+      slot.haveSave = true;
+      slot.legacy = true;
+    }
+    closeFile(fd);
+    std::lock_guard lock{mMessageMutex};
+    mLegacyLog = std::move(log);
+  }
+
+  /* Reads suspend.bin, on the writer thread. */
+  bool readSnapshot(const Slot &slot, Snapshot &out) {
+    SnapshotRecord record{};
+    if(!readRecord(slot.snapshotPath, record)) {
+      return false;
+    }
+    if(std::memcmp(record.magic, cSnapshotMagic, sizeof(cSnapshotMagic)) != 0
+    || record.version != cSnapshotVersion || record.size != sizeof(record)
+    || record.crc != recordCrc(record)) {
+      note(slot.snapshotPath + " is damaged, not resuming.");
+      return false;
+    }
+    out = record.snapshot;
+    return true;
+  }
+
+  void work() {
+    std::unique_lock lock{mMutex};
+    readIndex(lock);
+    for(;;) {
+      if(step(lock)) {
+        continue;
+      }
+      mFlushing = false;
+      if(mStop) {
+        return;
+      }
+      if(auto deadline = nextDeadline()) {
+        mWake.wait_until(lock, *deadline);
+      } else {
+        mWake.wait(lock);
+      }
+    }
+  }
+
+  [[nodiscard]] std::optional<Clock::time_point> nextDeadline() const {
+    std::optional<Clock::time_point> next;
+    if(mIndexDirty) {
+      next = mIndexDeadline;
+    }
+    for(const auto &slot: mSlots) {
+      if(slot.unsynced && (!next || slot.syncDeadline < *next)) {
+        next = slot.syncDeadline;
+      }
+      if(slot.appendFailed && !slot.queue.empty() && (!next || slot.retryAt < *next)) {
+        next = slot.retryAt;
+      }
+    }
+    return next;
+  }
+
+  /* Does one piece of outstanding work, with the lock released around the
+     disk access. Returns false if there was none. */
+  bool step(std::unique_lock<std::mutex> &lock) {
+    for(auto &slot: mSlots) {
+      if(slot.wanted && !slot.replayed) {
+        lock.unlock();
+        replay(slot);
+        lock.lock();
+        slot.replayed = true;
+        if(&slot == &mSlots[0] && mIndexMissing && slot.haveSave) {
+          mIndex[0] = info(slot.latest);
+          markIndexDirty();
+        }
+        mReplayed.notify_all();
+        return true;
+      }
+    }
+    for(auto &slot: mSlots) {
+      if(slot.snapshotWanted && !slot.snapshotRead) {
+        slot.snapshotWanted = false;
+        Snapshot snapshot{};
+        lock.unlock();
+        bool read = readSnapshot(slot, snapshot);
+        lock.lock();
+        // unless suspend() or discardSnapshot() got there first
+        if(!slot.snapshotRead) {
+          slot.snapshotRead = true;
+          slot.haveSnapshot = read;
+          slot.snapshot = snapshot;
+        }
+        mLoaded.notify_all();
+        return true;
+      }
+    }
+
+    bool now = mStop || mFlushing;
+    for(auto &slot: mSlots) {
+      if(!slot.queue.empty() && (!slot.appendFailed || mStop || Clock::now() >= slot.retryAt)) {
+        std::vector<Record> batch;
+        batch.swap(slot.queue);
+        lock.unlock();
+        bool appended = append(slot, batch);
+        lock.lock();
+        if(!appended) {
+          if(mStop && slot.appendFailed) {
+            error("Could not append to " + slot.journalPath + " again, the last "
+              + std::to_string(batch.size()) + " changes are lost.");
+            slot.appendFailed = false;
+          } else {
+            // ahead of what was queued meanwhile, to keep the records in order
+            batch.insert(batch.end(), slot.queue.begin(), slot.queue.end());
+            slot.queue.swap(batch);
+            slot.appendFailed = true;
+            slot.retryAt = Clock::now() + cRetryDelay;
+          }
+          return true;
+        }
+        slot.appendFailed = false;
+        if(!slot.unsynced) {
+          slot.unsynced = true;
+          slot.syncDeadline = windowEnd();
+        }
+        return true;
+      }
+      if(slot.snapshotPending || slot.snapshotDiscarded) {
+        bool pending = slot.snapshotPending;
+        SnapshotRecord record{};
+        std::memcpy(record.magic, cSnapshotMagic, sizeof(cSnapshotMagic));
+        record.version = cSnapshotVersion;
+        record.size = sizeof(SnapshotRecord);
+        std::memcpy(&record.snapshot, &slot.snapshot, sizeof(Snapshot));
+        record.crc = recordCrc(record);
+        slot.snapshotPending = false;
+        slot.snapshotDiscarded = false;
+        lock.unlock();
+        if(pending) {
+          if(!writeRecord(slot.snapshotPath, record)) {
+            fail("Could not save to " + slot.snapshotPath);
+          }
+        } else if(!removeFile(slot.snapshotPath) && errno != ENOENT) {
+          fail("Could not delete " + slot.snapshotPath);
+        }
+        lock.lock();
+        return true;
+      }
+      if(slot.unsynced && (now || Clock::now() >= slot.syncDeadline)) {
+        slot.unsynced = false;
+        lock.unlock();
+        sync(slot);
+        lock.lock();
+        return true;
+      }
+    }
+    if(mIndexDirty && (now || Clock::now() >= mIndexDeadline)) {
+      IndexRecord record{};
+      std::memcpy(record.magic, cIndexMagic, sizeof(cIndexMagic));
+      record.version = cIndexVersion;
+      record.current = u8(mCurrent);
+      record.count = u8(cSlotCount);
+      std::copy(mIndex.begin(), mIndex.end(), std::begin(record.slots));
+      record.crc = recordCrc(record);
+      mIndexDirty = false;
+      lock.unlock();
+      if(!writeRecord(mIndexPath, record)) {
+        fail("Could not save to " + mIndexPath);
+      }
+      lock.lock();
+      return true;
+    }
+    return false;
+  }
+
+  /* Writes all of `batch` in one go. Returns false if it should be tried
+     again. A failed write is cut off the journal, so the next records are not
+     appended after a torn one and lost with it on replay. */
+  bool append(Slot &slot, const std::vector<Record> &batch) {
+    if(slot.journal < 0) {
+      return true;
+    }
+    usize size = batch.size() * sizeof(Record);
+    if(!writeFile(slot.journal, reinterpret_cast<const char*>(batch.data()), size)) {
+      fail("Could not append to " + slot.journalPath);
+      if(!truncateFile(slot.journal, slot.journalSize)) {
+        fail("Could not cut the torn record off " + slot.journalPath + ", not journaling any more");
+        closeFile(slot.journal);
+        slot.journal = -1;
+      }
+      return false;
+    }
+    for(const auto &record: batch) {
+      journal::apply(slot.written, record);
+      slot.written.journalSeq = record.seq;
+    }
+    slot.journalSize += size;
+    mRecords += batch.size();
+    ++mAppends;
+    return true;
+  }
+
+  void sync(Slot &slot) {
+    if(slot.journal < 0) {
+      return;
+    }
+    if(!syncData(slot.journal)) {
+      fail("Could not sync " + slot.journalPath);
+      return;
+    }
+    ++mSyncs;
+    if(slot.journalSize >= cCompactSize) {
+      compact(slot);
+    }
+  }
+
+  /* Writes everything journaled so far to the copy of save.bin, then to
+     save.bin, and empties the journal. A crash in between leaves records
+     save.bin already has, which replay() skips by their sequence number. */
+  void compact(Slot &slot) {
+    if(slot.keepSave) {
+      return;
+    }
+    SavefileV3::Record record{};
+    slot.written.write(record);
+    if(!writeRecord(slot.backupPath, record)) {
+      fail("Could not save to " + slot.backupPath);
+      return;
+    }
+    if(!writeRecord(slot.path, record)) {
+      fail("Could not save to " + slot.path);
+      return;
+    }
+    if(slot.legacy) {
+      removeFile(slot.legacyPath);
+      slot.legacy = false;
+    }
+    if(!truncateFile(slot.journal, 0)) {
+      fail("Could not truncate " + slot.journalPath);
+      return;
+    }
+    slot.journalSize = 0;
+    ++mCompactions;
+  }
+};
+
+Writer &writer() {
+  static Writer sWriter{userDir()};
+  return sWriter;
+}
+
+} // namespace
+
+SlotIndex slots() {
+  return writer().slots();
+}
+
+usize currentSlot() {
+  return writer().currentSlot();
+}
+
+void selectSlot(usize slot) {
+  writer().selectSlot(slot);
+}
+
+void load(Savefile &save) {
+  bool found = writer().load(save.v3);
+  if(currentSlot() != 0) {
+    // the saves from before there were slots belong to the first one
+    save.v1 = {};
+    save.v2 = {};
+  }
+  if(!found) {
+    save.migrate();
+  }
+}
+
+void nq(Savefile &save) {
+  save.migrate();
+  writer().nq(save.v3);
+}
+
+void flush() {
+  writer().flush();
+}
+
+bool migrationPending() {
+  return writer().migrationPending();
+}
+
+void prefetch() {
+  writer();
+}
+
+void report() {
+  writer().report();
+}
+
+void shutdown() {
+  writer().shutdown();
+}
+
+void suspend(const Snapshot &snapshot) {
+  writer().suspend(snapshot);
+}
+
+bool resume(Snapshot &out, const SavefileV3 &save) {
+  return writer().resume(out, save);
+}
+
+void discardSnapshot() {
+  writer().discardSnapshot();
+}
+
+void setWindow(f32 seconds) {
+  writer().setWindow(seconds < 0 ? 0 : seconds);
+}
+
+f32 window() {
+  return writer().window();
+}
+
+/* Flips a bit in the middle of `path`. */
+static void damage(const std::string &path) {
+  std::string raw;
+  int fd = openFile(path, Open::Read);
+  if(fd < 0 || !readFile(fd, raw) || raw.empty()) {
+    if(fd >= 0) {
+      closeFile(fd);
+    }
+    return;
+  }
+  closeFile(fd);
+  raw[raw.size() / 2] = char(raw[raw.size() / 2] ^ 0x20);
+  replaceFile(path, {raw.data(), raw.size()});
+}
+
+bool check() {
+  Checks checks{"save writer"};
+  // a directory of its own, so the player's saves are never touched
+  std::string dir = userDir() + "check/";
+  std::error_code error;
+  std::filesystem::remove_all(dir, error);
+  if(!checks.expect(std::filesystem::create_directories(dir, error), "creates a scratch directory")) {
+    return checks.finish();
+  }
+  std::string savePath = dir + cFileName + cSaveExt;
+  std::string backupPath = savePath + ".bak";
+  std::string journalPath = dir + cFileName + cJournalExt;
+
+  // compacted up to record 3, but interrupted before the journal was emptied
+  std::array<SavefileV3, 6> steps{};
+  steps[1].score = 40;
+  steps[2] = steps[1];
+  steps[2].lubeTier = 2;
+  steps[3] = steps[2];
+  steps[3].score = 100;
+  steps[4] = steps[3];
+  steps[4].score = 105;
+  steps[5] = steps[4];
+  steps[5].oxyTier = 1;
+  std::vector<Record> records;
+  u32 seq = 0;
+  for(usize i = 1; i < steps.size(); ++i) {
+    std::array<Record, journal::cMaxRecords> diff{};
+    usize count = journal::diff(steps[i - 1], steps[i], seq, diff.data());
+    records.insert(records.end(), diff.begin(), diff.begin() + count);
+  }
+  SavefileV3 compacted = steps[3];
+  compacted.journalSeq = 3;
+  SavefileV3::Record saveRecord{};
+  compacted.write(saveRecord);
+  std::string journalBytes(reinterpret_cast<const char*>(records.data()),
+    records.size() * sizeof(Record));
+  // and torn in the middle of a sixth record
+  journalBytes.append(sizeof(Record) / 2, '\x7F');
+  writeRecord(backupPath, saveRecord);
+  writeRecord(savePath, saveRecord);
+  replaceFile(journalPath, {journalBytes.data(), journalBytes.size()});
+
+  SavefileV3 loaded;
+  {
+    Writer writer{dir};
+    checks.expect(writer.load(loaded) && loaded.score == 105 && loaded.lubeTier == 2
+      && loaded.oxyTier == 1 && loaded.journalSeq == 5,
+      "replays only the records an interrupted compaction left out");
+    ++loaded.score;
+    writer.nq(loaded);
+  }
+  checks.expect(std::filesystem::file_size(journalPath, error) == 6 * sizeof(Record),
+    "drops the torn record and appends after the rest");
+  {
+    Writer writer{dir};
+    SavefileV3 again;
+    checks.expect(writer.load(again) && again.score == 106 && again.journalSeq == 6,
+      "numbers new records after the replayed ones");
+  }
+
+  Snapshot snapshot{};
+  snapshot.score = loaded.score;
+  snapshot.tiers = {loaded.lubeTier, loaded.gravityTier, loaded.oxyTier};
+  snapshot.timer = 12.5f;
+  snapshot.sim.brickFall = 0.25f;
+  {
+    Writer writer{dir};
+    writer.suspend(snapshot);
+  }
+  {
+    Writer writer{dir};
+    Snapshot resumed{};
+    checks.expect(writer.resume(resumed, loaded)
+      && std::memcmp(&resumed, &snapshot, sizeof(Snapshot)) == 0,
+      "round-trips the suspended game");
+    SavefileV3 newer = loaded;
+    ++newer.score;
+    checks.expect(!writer.resume(resumed, newer), "only resumes on top of its save");
+  }
+  damage(dir + cSnapshotName + cSaveExt);
+  {
+    Writer writer{dir};
+    Snapshot resumed{};
+    checks.expect(!writer.resume(resumed, loaded), "rejects a damaged suspended game");
+  }
+
+  {
+    Writer writer{dir};
+    writer.selectSlot(2);
+    SavefileV3 third;
+    third.score = 7;
+    writer.nq(third);
+  }
+  {
+    Writer writer{dir};
+    auto index = writer.slots();
+    checks.expect(writer.currentSlot() == 2 && index[2].used == 1 && index[2].score == 7
+      && index[0].score == 106 && index[1].used == 0,
+      "round-trips the slot index");
+  }
+  damage(dir + cIndexName);
+  {
+    Writer writer{dir};
+    checks.expect(writer.currentSlot() == 0, "falls back to the first slot on a damaged index");
+  }
+
+  damage(savePath);
+  {
+    Writer writer{dir};
+    SavefileV3 recovered;
+    checks.expect(writer.load(recovered) && recovered.score == 106,
+      "recovers a damaged save from its copy");
+  }
+  checks.expect(std::filesystem::exists(savePath + ".bad", error),
+    "moves a damaged save out of the way");
+
+  // as if the journal had been compacted up to record 3
+  std::string compactedJournal;
+  int fd = openFile(journalPath, Open::Read);
+  if(fd >= 0) {
+    readFile(fd, compactedJournal);
+    closeFile(fd);
+  }
+  compactedJournal.erase(0, 3 * sizeof(Record));
+  replaceFile(journalPath, {compactedJournal.data(), compactedJournal.size()});
+  damage(backupPath);
+  {
+    Writer writer{dir};
+    SavefileV3 recovered;
+    checks.expect(writer.load(recovered) && recovered.score == 0 && recovered.oxyTier == 1,
+      "does not add journaled score to a lost save");
+  }
+
+  std::filesystem::remove_all(dir, error);
+  return checks.finish();
+}
+
+} // namespace sbs::saves
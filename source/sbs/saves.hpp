@@ -0,0 +1,128 @@
+#pragma once
+
+/*
+saves.hpp
+---------
+Background writer for the save file
+
+Changes are appended to save.journal as they come in (see journal.hpp) and
+synced to disk in batches. Once the journal grows large enough it is folded
+into save.bin (a SavefileV3).
+
+There are several save slots, the first one using the file names above and
+the others save2.bin, save2.journal and so on. slots.bin holds a little
+metadata about every slot, so picking one does not need to read them all.
+Everything below works on the current slot.
+
+save.bin is written twice, to save.bin.bak first, so when one of them is
+damaged the other is still there.
+*/
+
+#include "Sim.hpp"
+#include "save.hpp"
+#include <array>
+#include <string>
+#include <nwge/common/def.h>
+
+namespace sbs::saves {
+
+static constexpr usize cSlotCount = 3;
+
+struct SlotInfo {
+  s64 lastPlayed; // seconds since the epoch
+  s32 score;
+  s16 prestige;
+  u8 used;
+  u8 reserved;
+};
+static_assert(sizeof(SlotInfo) == 16);
+
+using SlotIndex = std::array<SlotInfo, cSlotCount>;
+
+/* Metadata of every slot. Only reads slots.bin. */
+SlotIndex slots();
+
+usize currentSlot();
+
+/* Switches to `slot`. Changes queued for the previous slot are still written,
+   and its save stays in memory, so switching back does not read it again. */
+void selectSlot(usize slot);
+
+/* The directory the game keeps its files in, with a trailing separator.
+   Empty if SDL could not provide one, so paths are relative to the working
+   directory. Safe to call from any thread. */
+const std::string &userDir();
+
+/* how long appended changes may wait to be synced to disk, by default */
+static constexpr f32 cDefaultWindow = 5.0f;
+
+/* Whether the saves from before this service, the store's progress and
+   save.json files, may still have to be migrated into the first slot. Only
+   until there is a slots.bin or the first slot has a save. */
+bool migrationPending();
+
+/* Starts reading slots.bin and the current slot, including its suspend.bin,
+   on the writer thread, so the first load() and resume() do not have to wait
+   for the disk. Call it from preload(). */
+void prefetch();
+
+/* Reads the save written by this service into save.v3. The newest queued save
+   is used if there is one, so only the first call per slot waits on the
+   disk.
+   If there is no such save yet, the V1 or V2 save loaded into `save` through
+   the store is migrated instead. Those belong to the first slot and are
+   dropped in the others. */
+void load(Savefile &save);
+
+/* Queues the fields of `save` that changed since the last call to be
+   appended to the journal. Never blocks on the filesystem. */
+void nq(Savefile &save);
+
+/* Syncs whatever is queued right away instead of at the end of the window,
+   without waiting for it. Pending changes are also synced on exit. */
+void flush();
+
+/* Prints what went wrong in the background since the last call. Only call it
+   from the main thread. */
+void report();
+
+/* Writes and syncs everything queued, then stops the writer. Call it once,
+   right before exiting. */
+void shutdown();
+
+/* gameplay that was in flight when the game was left */
+struct Snapshot {
+  SimSnapshot sim;
+  SimTiers tiers; // the sim's rates were calculated for these
+  s16 reserved;
+  s32 score;
+  f32 timer;
+  u8 splash;
+  u8 reserved2[3];
+  u32 balance; // balanceCrc() of the config the sim ran with
+};
+static_assert(sizeof(Snapshot) == 56);
+
+/* Keeps `snapshot` to be resumed next time. It is written to suspend.bin in
+   the background, replacing the previous one. */
+void suspend(const Snapshot &snapshot);
+
+/* Takes the suspended snapshot into `out`, if it was taken with the score and
+   tiers of `save`. The snapshot is read on the writer thread, this only
+   waits for it the first time, if it was not read ahead. */
+bool resume(Snapshot &out, const SavefileV3 &save);
+
+/* Forgets the suspended snapshot, e.g. once the game was ended. */
+void discardSnapshot();
+
+/* Changes the window, in seconds. A window of 0 syncs every write. */
+void setWindow(f32 seconds);
+f32 window();
+
+/* Replays a journal left by an interrupted compaction and torn by a crash,
+   round-trips the suspend and slot records, and checks that damaged files
+   are caught. Runs in a scratch directory under userDir(). For the sbs.check
+   console command. */
+bool check();
+
+} // namespace sbs::saves
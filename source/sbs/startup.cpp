@@ -0,0 +1,35 @@
+#include "startup.hpp"
+#include "TextureCache.hpp"
+#include <chrono>
+#include <nwge/console.hpp>
+
+using namespace nwge;
+
+namespace sbs {
+
+using Clock = std::chrono::steady_clock;
+
+static Clock::time_point gLaunch;
+static bool gReported = false;
+
+void markLaunch() {
+  gLaunch = Clock::now();
+}
+
+void reportStartup() {
+  if(gReported) {
+    return;
+  }
+  gReported = true;
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - gLaunch);
+  const auto &cache = TextureCache::shared();
+  console::note("Startup took {:.2f} ms, {} textures from the texture cache, {} decoded{}",
+    f64(elapsed.count()) / 1000.0, cache.hits(), cache.misses(),
+    cache.valid() ? "" : " (no usable texture cache)");
+  if(cache.savedBytes() != 0) {
+    console::note("Downscaling textures to the window saved {} KiB",
+      cache.savedBytes() / 1024);
+  }
+}
+
+} // namespace sbs
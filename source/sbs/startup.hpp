@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+startup.hpp
+-----------
+Time from launch to the first state
+*/
+
+namespace sbs {
+
+/* Called first thing in main(). */
+void markLaunch();
+
+/* Prints the time since launch and where the textures loaded so far came from.
+   Only the first call prints, so every state main() can start with calls it
+   from init(). Compare a run with `--no-texcache` to see the cold start. */
+void reportStartup();
+
+} // namespace sbs
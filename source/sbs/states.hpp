@@ -7,6 +7,8 @@ Functions for different states of the game.
 #include "config.hpp"
 #include "Music.hpp"
 #include "save.hpp"
+#include "Sfx.hpp"
+#include <functional>
 #include <nwge/state.hpp>
 #include <nwge/render/Font.hpp>
 #include <nwge/render/Texture.hpp>
@@ -22,14 +24,18 @@ nwge::State *getEndState();
 
 struct StoreData {
   Savefile &save;
-  Config &config;
+  const Config &config;
 
-  nwge::audio::Source &source;
-  nwge::audio::Buffer &buySound;
-  nwge::audio::Buffer &brokeSound;
+  SfxVoice &voice;
+  const Sfx &buySound;
+  const Sfx &brokeSound;
 
   nwge::render::Font &font;
   nwge::render::Texture &icons;
+
+  /* Called before swapping to the end, after which none of the above may be
+     touched. */
+  std::function<void()> handOff;
 };
 
 nwge::SubState *getStoreSubState(StoreData data);